@@ -0,0 +1,53 @@
+// Shared declarations for the Barnes-Hut passes. The tree is a binary radix
+// tree over Morton sorted particles (Karras 2012): internal node i has children
+// that are either internal nodes or leaves, leaves are flagged with BH_LEAF_BIT
+// and index the sorted particle order.
+
+#define BH_INVALID 0xFFFFFFFFu
+#define BH_LEAF_BIT 0x80000000u
+
+struct BhNode
+{
+    vec4 bounds; // min.xy, max.xy
+    vec2 com;
+    float mass;
+    uint parent;
+    uint left;
+    uint right;
+    uint visits;
+    uint padding;
+};
+
+// Scene bounds as order preserving ints so they can be reduced with atomics
+layout(std430, set = 1, binding = 0) buffer SceneBounds
+{
+    ivec4 sceneBounds; // min.xy, max.xy
+};
+
+layout(std430, set = 1, binding = 1) buffer MortonKeys
+{
+    uint mortonKeys[ ];
+};
+
+layout(std430, set = 1, binding = 2) buffer SortedIndices
+{
+    uint sortedIndices[ ];
+};
+
+layout(std430, set = 1, binding = 3) coherent buffer Nodes
+{
+    BhNode nodes[ ];
+};
+
+layout(std430, set = 1, binding = 4) buffer LeafParents
+{
+    uint leafParents[ ];
+};
+
+layout(push_constant) uniform BarnesHutPush
+{
+    uint particleCount;
+    float openingAngle;
+} pc;
+
+#include "morton_common.glsl"
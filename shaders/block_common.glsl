@@ -0,0 +1,94 @@
+// Shared declarations for the block timestep passes of BlockTimestepSystem.
+// Every particle steps with dt * 2^level, level in [0, maxLevel]. All particles
+// drift every substep, only the ones whose step ends are kicked with new forces.
+// Velocities are kept half a step ahead of the positions (kick-drift-kick).
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    vec2 positions[ ];
+};
+
+// written in place by block_init.comp
+layout(std430, set = 0, binding = 1) buffer Velocities
+{
+    vec2 velocities[ ];
+};
+
+layout(std430, set = 0, binding = 2) buffer ColorValues
+{
+    float colorValues[ ];
+};
+
+layout(std430, set = 0, binding = 3) writeonly buffer PositionsNext
+{
+    vec2 positionsNext[ ];
+};
+
+layout(std430, set = 0, binding = 4) buffer VelocitiesNext
+{
+    vec2 velocitiesNext[ ];
+};
+
+layout(std430, set = 0, binding = 5) writeonly buffer ColorValuesNext
+{
+    float colorValuesNext[ ];
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer Accelerations
+{
+    vec2 accelerations[ ];
+};
+
+layout(std430, set = 0, binding = 7) buffer Levels
+{
+    uint levels[ ];
+};
+
+// The group counts double as VkDispatchIndirectCommands
+layout(std430, set = 0, binding = 8) buffer ActiveParticles
+{
+    uvec3 forceGroups;
+    uint activeCount;
+    uvec3 passGroups;
+    uint appendCounter;
+    uint activeIndices[ ];
+};
+
+layout(push_constant) uniform BlockPush
+{
+    float dt;
+    uint particleCount;
+    // substep index at the end of this substep (the start for block_init.comp), modulo 2^maxLevel
+    uint substep;
+    uint maxLevel;
+    float accuracy;
+    float softening;
+    uint forceLocalSizeX;
+} pc;
+
+// True if a particle on the given level ends its step at pc.substep
+bool isActive(uint level)
+{
+    return (pc.substep & ((1u << level) - 1u)) == 0u;
+}
+
+// Largest level with dt * 2^level <= sqrt(2 * accuracy * softening / |a|) that
+// is synchronised at pc.substep, so a particle never skips past its new step
+uint pickLevel(vec2 acceleration)
+{
+    float accelerationLength = length(acceleration);
+    uint level = pc.maxLevel;
+    if (accelerationLength > 0.0)
+    {
+        float maxDt = sqrt(2.0 * pc.accuracy * pc.softening / accelerationLength);
+        float steps = floor(log2(maxDt / pc.dt));
+        level = uint(clamp(steps, 0.0, float(pc.maxLevel)));
+    }
+    while (!isActive(level))
+        level--;
+    return level;
+}
+
+float levelDt(uint level)
+{
+    return pc.dt * float(1u << level);
+}
@@ -0,0 +1,28 @@
+// Helpers for dispatches over more work groups than one grid dimension allows.
+// PgsComputePipeline::compute spreads such dispatches over a 2D grid once the
+// group count would exceed maxComputeWorkGroupCount[0] (at least 65535, which
+// caps a 1D dispatch of 256 wide work groups at about 16.7M invocations), so
+// shaders index particles through these instead of gl_GlobalInvocationID.x.
+
+// Guaranteed minimum of maxComputeWorkGroupCount[0], used for dispatch arguments
+// written on the GPU, which does not know the device limit
+#define MAX_GROUP_COUNT_X 65535u
+
+uint linearWorkGroupIndex()
+{
+    return gl_WorkGroupID.x + gl_WorkGroupID.y * gl_NumWorkGroups.x;
+}
+
+uint linearInvocationIndex()
+{
+    return linearWorkGroupIndex() * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+}
+
+// Indirect dispatch arguments covering groupCount work groups, the same split
+// PgsComputePipeline::dispatchLinear makes on the host
+uvec3 splitGroupCount(uint groupCount)
+{
+    uint rows = (groupCount + MAX_GROUP_COUNT_X - 1) / MAX_GROUP_COUNT_X;
+    rows = max(rows, 1);
+    return uvec3((groupCount + rows - 1) / rows, rows, 1);
+}
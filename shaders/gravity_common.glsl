@@ -0,0 +1,97 @@
+// Shared declarations for the gravity compute kernels.
+// Included by every gravity compute shader so the particle layout and the
+// physics constants only live in one place.
+
+// Particle state is stored as a structure of arrays so the force loops only
+// stream the 8 byte positions. Every step reads the previous state and writes
+// the next one into a second set of buffers, see PgsModel::StateBuffers.
+layout(std430, binding = 0) readonly buffer Positions
+{
+    vec2 positions[ ];
+};
+
+// Written by force solvers that run as a separate pass before integrate.comp
+layout(std430, binding = 2) buffer Accelerations
+{
+    vec2 accelerations[ ];
+};
+
+layout(std430, binding = 3) writeonly buffer PositionsOut
+{
+    vec2 positionsOut[ ];
+};
+
+layout(std430, binding = 4) readonly buffer Velocities
+{
+    vec2 velocities[ ];
+};
+
+layout(std430, binding = 5) writeonly buffer VelocitiesOut
+{
+    vec2 velocitiesOut[ ];
+};
+
+// Scalar the vertex shader maps through a colormap, only read when drawing
+layout(std430, binding = 6) writeonly buffer ColorValuesOut
+{
+    float colorValuesOut[ ];
+};
+
+// Time derivative of the acceleration, only written by the all-pairs kernel
+// when it evaluates forces for the Hermite integrator
+layout(std430, binding = 7) writeonly buffer Jerks
+{
+    vec2 jerks[ ];
+};
+
+// Particles due a force evaluation this block timestep substep, compacted by
+// block_drift.comp and sized by block_dispatch.comp, see BlockTimestepSystem
+layout(std430, binding = 8) readonly buffer ActiveParticles
+{
+    uvec3 forceGroups;
+    uint activeCount;
+    uvec3 passGroups;
+    uint appendCounter;
+    uint activeIndices[ ];
+};
+
+// Live particle count, kept on the GPU so passes that add or remove particles
+// need no CPU round trip. The rest of the buffer holds the indirect draw and
+// dispatch arguments derived from it, see particle_count.comp.
+layout(std430, binding = 9) readonly buffer ParticleCount
+{
+    uint liveParticleCount;
+};
+
+// Mass of the particle in every slot, see PgsModel::getMassBuffer. Every solver
+// weights its sources by it.
+layout(std430, binding = 10) readonly buffer Masses
+{
+    float masses[ ];
+};
+
+// Specialized from PgsModel::GRAV_CONSTANT and PgsModel::DAMP by
+// PgsComputePipeline::gravityConstants(), the defaults match them
+layout(constant_id = 1) const float GRAV_CONSTANT = 0.000001;
+layout(constant_id = 2) const float damp = 0.0005;
+
+// Unroll factor of the all-pairs inner loops, picked by PgsKernelTuner
+layout(constant_id = 3) const uint UNROLL = 1;
+
+// What the all-pairs kernels do with the accelerations they sum up: integrate
+// them right away, or only store them (and the jerks) for IntegratorSystem. The
+// active mode stores them for the particles in activeIndices only, the accumulate
+// mode adds the sum over one chunk of sources to the accelerations.
+#define KERNEL_MODE_INTEGRATE 0
+#define KERNEL_MODE_ACCELERATIONS 1
+#define KERNEL_MODE_JERKS 2
+#define KERNEL_MODE_ACTIVE 3
+#define KERNEL_MODE_ACCUMULATE 4
+layout(constant_id = 4) const uint KERNEL_MODE = KERNEL_MODE_INTEGRATE;
+
+// Softened pull of a body of the given mass at offset delta, without GRAV_CONSTANT
+vec2 pairAcceleration(vec2 delta, float mass)
+{
+    float invDist = inversesqrt(dot(delta, delta) + damp);
+    return delta * (mass * invDist * invDist * invDist);
+}
@@ -0,0 +1,72 @@
+// Shared declarations for the integrator passes of IntegratorSystem.
+// A step goes from the state in bindings 0-1 to the one in bindings 2-4. Stages
+// that need forces at a trial state leave it in the next state's buffers, the
+// force solvers then read it through the other global descriptor set.
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    vec2 positions[ ];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Velocities
+{
+    vec2 velocities[ ];
+};
+
+layout(std430, set = 0, binding = 2) buffer PositionsNext
+{
+    vec2 positionsNext[ ];
+};
+
+layout(std430, set = 0, binding = 3) buffer VelocitiesNext
+{
+    vec2 velocitiesNext[ ];
+};
+
+layout(std430, set = 0, binding = 4) writeonly buffer ColorValuesNext
+{
+    float colorValuesNext[ ];
+};
+
+// Output of the last force evaluation
+layout(std430, set = 0, binding = 5) readonly buffer Accelerations
+{
+    vec2 accelerations[ ];
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer Jerks
+{
+    vec2 jerks[ ];
+};
+
+// Acceleration and jerk at the start of the step, kept from the end of the
+// previous one so single evaluation schemes don't evaluate forces twice
+layout(std430, set = 0, binding = 7) buffer SavedAccelerations
+{
+    vec2 savedAccelerations[ ];
+};
+
+layout(std430, set = 0, binding = 8) buffer SavedJerks
+{
+    vec2 savedJerks[ ];
+};
+
+// Weighted sum of the RK4 stage derivatives, position in xy and velocity in zw
+layout(std430, set = 0, binding = 9) buffer StageSums
+{
+    vec4 stageSums[ ];
+};
+
+// Live particle count of the model, merges shrink it below the slot count. The
+// passes are dispatched over it through the indirect arguments that follow it.
+layout(std430, set = 0, binding = 10) readonly buffer ParticleCount
+{
+    uint liveParticleCount;
+};
+
+layout(push_constant) uniform IntegratorPush
+{
+    float dt;
+    // slots of the model, an upper bound of liveParticleCount
+    uint particleCount;
+    uint stage;
+} pc;
@@ -0,0 +1,119 @@
+// Shared declarations for the MergeSystem passes. Live particles are bucketed
+// into a uniform cell list whose cells are at least one merge radius wide, so
+// every merge partner lies in the surrounding 3x3 cells. Each particle picks the
+// lowest slot within the merge radius as its target; particles that are their
+// own target absorb every particle targeting them, the rest survive unchanged.
+// Survivors are compacted into the next state, the particle ids and masses
+// travel along.
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    vec2 positions[ ];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Velocities
+{
+    vec2 velocities[ ];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer ColorValues
+{
+    float colorValues[ ];
+};
+
+layout(std430, set = 0, binding = 3) writeonly buffer PositionsNext
+{
+    vec2 positionsNext[ ];
+};
+
+layout(std430, set = 0, binding = 4) writeonly buffer VelocitiesNext
+{
+    vec2 velocitiesNext[ ];
+};
+
+layout(std430, set = 0, binding = 5) writeonly buffer ColorValuesNext
+{
+    float colorValuesNext[ ];
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer ParticleIds
+{
+    uint particleIds[ ];
+};
+
+layout(std430, set = 0, binding = 7) writeonly buffer ParticleIdsNext
+{
+    uint particleIdsNext[ ];
+};
+
+layout(std430, set = 0, binding = 8) readonly buffer Masses
+{
+    float masses[ ];
+};
+
+// scratch buffer the merged masses are compacted into, copied back by MergeSystem
+layout(std430, set = 0, binding = 9) writeonly buffer MassesNext
+{
+    float massesNext[ ];
+};
+
+// Cell id per slot, sorted together with cellIndices by the radix sort
+layout(std430, set = 0, binding = 10) buffer CellKeys
+{
+    uint cellKeys[ ];
+};
+
+layout(std430, set = 0, binding = 11) buffer CellIndices
+{
+    uint cellIndices[ ];
+};
+
+// [cellStart, cellEnd) range of every cell in the sorted order, empty cells are 0, 0
+layout(std430, set = 0, binding = 12) buffer CellStart
+{
+    uint cellStart[ ];
+};
+
+layout(std430, set = 0, binding = 13) buffer CellEnd
+{
+    uint cellEnd[ ];
+};
+
+// Lowest slot within the merge radius of every live slot, the slot itself if none is lower
+layout(std430, set = 0, binding = 14) buffer MergeTargets
+{
+    uint mergeTargets[ ];
+};
+
+// PgsModel::CountArgs
+layout(std430, set = 0, binding = 15) readonly buffer ParticleCount
+{
+    uint liveParticleCount;
+};
+
+// Survivors appended so far, the new live count once the gather pass is done
+layout(std430, set = 0, binding = 16) buffer MergedCount
+{
+    uint mergedCount;
+};
+
+layout(push_constant) uniform MergePush
+{
+    uint particleCount;
+    uint cellsPerAxis;
+    float domainHalfWidth;
+    float cellSize;
+    float mergeRadius;
+} pc;
+
+// Particles outside the domain are clamped into the border cells
+ivec2 cellOf(vec2 pos)
+{
+    ivec2 cell = ivec2(floor((pos + pc.domainHalfWidth) / pc.cellSize));
+    return clamp(cell, ivec2(0), ivec2(int(pc.cellsPerAxis) - 1));
+}
+
+// Key of the slots past the live count, one past the last cell so they sort to the end
+uint deadCellKey()
+{
+    return pc.cellsPerAxis * pc.cellsPerAxis;
+}
@@ -0,0 +1,65 @@
+// Morton ordering shared by the Barnes-Hut tree and the SpatialSortSystem, so both
+// quantize positions the same way. Bounds are kept as order preserving ints so they
+// can be reduced with atomics.
+
+int orderedInt(float value)
+{
+    int bits = floatBitsToInt(value);
+    return bits >= 0 ? bits : bits ^ 0x7FFFFFFF;
+}
+
+float orderedFloat(int bits)
+{
+    return intBitsToFloat(bits >= 0 ? bits : bits ^ 0x7FFFFFFF);
+}
+
+// Spreads the low 16 bits of v so there is a zero bit between each of them
+uint expandBits(uint v)
+{
+    v &= 0x0000FFFF;
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// 32 bit Morton key of position inside the square over the bounds, which hold
+// min.xy, max.xy as orderedInt
+uint mortonKey(vec2 position, ivec4 bounds)
+{
+    vec2 boundsMin = vec2(orderedFloat(bounds.x), orderedFloat(bounds.y));
+    vec2 boundsMax = vec2(orderedFloat(bounds.z), orderedFloat(bounds.w));
+    vec2 extent = boundsMax - boundsMin;
+    float size = max(max(extent.x, extent.y), 1e-20);
+
+    vec2 normalized = clamp((position - boundsMin) / size, 0.0, 1.0);
+    uvec2 quantized = uvec2(normalized * 65535.0);
+
+    return expandBits(quantized.x) | (expandBits(quantized.y) << 1);
+}
+
+#ifdef MORTON_BOUNDS_GROUP_SIZE
+shared vec4 localBounds[MORTON_BOUNDS_GROUP_SIZE];
+
+// Bounding box (min.xy, max.xy) of the live positions of the work group, complete
+// in every invocation. Must be reached by the whole work group, dispatched with
+// local_size_x = MORTON_BOUNDS_GROUP_SIZE.
+vec4 workGroupBounds(vec2 position, bool live)
+{
+    uint lid = gl_LocalInvocationID.x;
+    localBounds[lid] = live ? vec4(position, position) : vec4(1e30, 1e30, -1e30, -1e30);
+    barrier();
+
+    for (uint stride = MORTON_BOUNDS_GROUP_SIZE / 2; stride > 0; stride >>= 1)
+    {
+        if (lid < stride)
+        {
+            vec4 other = localBounds[lid + stride];
+            localBounds[lid] = vec4(min(localBounds[lid].xy, other.xy), max(localBounds[lid].zw, other.zw));
+        }
+        barrier();
+    }
+    return localBounds[0];
+}
+#endif
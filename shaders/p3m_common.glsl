@@ -0,0 +1,42 @@
+// Shared declarations for the P3M short range passes. Particles are bucketed
+// into a uniform cell list whose cells are at least one cutoff radius wide, so
+// every short range neighbour lies in the surrounding 3x3 cells.
+
+// Cell id per particle, sorted together with cellIndices by the radix sort
+layout(std430, set = 1, binding = 0) buffer CellKeys
+{
+    uint cellKeys[ ];
+};
+
+layout(std430, set = 1, binding = 1) buffer CellIndices
+{
+    uint cellIndices[ ];
+};
+
+// [cellStart, cellEnd) range of every cell in the sorted order, empty cells are 0, 0
+layout(std430, set = 1, binding = 2) buffer CellStart
+{
+    uint cellStart[ ];
+};
+
+layout(std430, set = 1, binding = 3) buffer CellEnd
+{
+    uint cellEnd[ ];
+};
+
+layout(push_constant) uniform P3MPush
+{
+    uint particleCount;
+    uint cellsPerAxis;
+    float domainHalfWidth;
+    float cellSize;
+    float splitRadius;
+    float cutoffRadius;
+} pc;
+
+// Particles outside the domain are clamped into the border cells
+ivec2 cellOf(vec2 pos)
+{
+    ivec2 cell = ivec2(floor((pos + pc.domainHalfWidth) / pc.cellSize));
+    return clamp(cell, ivec2(0), ivec2(int(pc.cellsPerAxis) - 1));
+}
@@ -1,8 +1,50 @@
 #version 450
 
-layout(location = 0) in vec2 position;
-layout(location = 1) in vec2 velocity;
-layout(location = 2) in vec4 color;
+// Vertex pulling: attributes are fetched from the particle state buffers by
+// gl_VertexIndex, so the compute passes can keep a structure of arrays layout
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+  vec2 positions[ ];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Velocities
+{
+  vec2 velocities[ ];
+};
+
+// acceleration magnitude of the last step, written by integrateParticle
+layout(std430, set = 0, binding = 2) readonly buffer ColorValues
+{
+  float colorValues[ ];
+};
+
+// must match ParticleSystem::Colormap, ParticleSystem::ColorSource and RenderPushConstants
+const uint COLOR_SOURCE_ACCELERATION = 0;
+const uint COLOR_SOURCE_SPEED = 1;
+
+layout(push_constant) uniform RenderPush
+{
+  uint colormap;
+  uint colorSource;
+  // value mapped to the middle of the colormap
+  float colorScale;
+} pc;
+
+// Five evenly spaced stops per colormap: classic, viridis, inferno, grayscale
+const int STOPS_PER_COLORMAP = 5;
+const vec3 COLORMAP_STOPS[4 * STOPS_PER_COLORMAP] = vec3[](
+  vec3(0.345, 0.020, 1.000), vec3(0.509, 0.265, 1.000), vec3(0.672, 0.510, 1.000), vec3(0.836, 0.755, 1.000), vec3(1.000, 1.000, 1.000),
+  vec3(0.267, 0.005, 0.329), vec3(0.229, 0.322, 0.546), vec3(0.128, 0.567, 0.551), vec3(0.369, 0.789, 0.383), vec3(0.993, 0.906, 0.144),
+  vec3(0.001, 0.000, 0.014), vec3(0.341, 0.062, 0.429), vec3(0.735, 0.216, 0.330), vec3(0.988, 0.645, 0.040), vec3(0.988, 0.998, 0.645),
+  vec3(0.000, 0.000, 0.000), vec3(0.250, 0.250, 0.250), vec3(0.500, 0.500, 0.500), vec3(0.750, 0.750, 0.750), vec3(1.000, 1.000, 1.000));
+
+vec3 lookupColormap(uint colormap, float t)
+{
+  float position = clamp(t, 0.0, 1.0) * float(STOPS_PER_COLORMAP - 1);
+  int stop = min(int(position), STOPS_PER_COLORMAP - 2);
+  int base = int(colormap) * STOPS_PER_COLORMAP;
+  return mix(COLORMAP_STOPS[base + stop], COLORMAP_STOPS[base + stop + 1], position - float(stop));
+}
 
 layout(location = 0) out vec4 fragColor;
 
@@ -13,7 +55,12 @@ out gl_PerVertex
 };
 
 void main() {
+  float value = pc.colorSource == COLOR_SOURCE_SPEED ? length(velocities[gl_VertexIndex])
+                                                    : colorValues[gl_VertexIndex];
+  // saturating map of [0, inf) to [0, 1), colorScale lands in the middle
+  float t = value / (value + pc.colorScale);
+
   gl_PointSize = 0.1;
-  fragColor = color;
-  gl_Position = vec4(position.xy, 0.0, 1.0);
+  fragColor = vec4(lookupColormap(pc.colormap, t), 1.0);
+  gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
 }
@@ -0,0 +1,72 @@
+// Shared declarations for the particle-mesh passes. Mass is deposited on a
+// gridSize x gridSize grid covering [-domainHalfWidth, domainHalfWidth]^2, which
+// is zero padded into an fftSize = 2 * gridSize complex grid so the periodic FFT
+// convolution equals the isolated (non periodic) one.
+
+// fixed point scale of the integer mass grid, atomics on floats are optional in Vulkan
+#define PM_DEPOSIT_SCALE 4096.0
+
+layout(std430, set = 1, binding = 0) buffer DensityGrid
+{
+    uint densityGrid[ ];
+};
+
+layout(std430, set = 1, binding = 1) buffer FftA
+{
+    vec2 fftA[ ];
+};
+
+layout(std430, set = 1, binding = 2) buffer FftB
+{
+    vec2 fftB[ ];
+};
+
+// FFT of the Green's function, computed once when the grid is created
+layout(std430, set = 1, binding = 3) buffer GreensFunction
+{
+    vec2 greensFunction[ ];
+};
+
+layout(push_constant) uniform ParticleMeshPush
+{
+    uint particleCount;
+    uint gridSize;
+    uint fftSize;
+    uint fftStage;     // butterfly span p of the current radix-2 pass
+    uint fftDirection; // 0: along rows, 1: along columns
+    float fftSign;     // -1 forward, +1 inverse
+    uint flip;         // 0: read A, write B. 1: the reverse
+    float domainHalfWidth;
+} pc;
+
+vec2 loadFft(uint index)
+{
+    return pc.flip == 0 ? fftA[index] : fftB[index];
+}
+
+void storeFft(uint index, vec2 value)
+{
+    if (pc.flip == 0)
+        fftB[index] = value;
+    else
+        fftA[index] = value;
+}
+
+float cellSize()
+{
+    return 2.0 * pc.domainHalfWidth / float(pc.gridSize);
+}
+
+// Cloud-in-cell: lower left grid node and the fractional offset towards the next node
+void cloudInCell(vec2 pos, out ivec2 node, out vec2 fraction)
+{
+    vec2 gridPos = (pos + pc.domainHalfWidth) / cellSize() - 0.5;
+    vec2 base = floor(gridPos);
+    node = ivec2(base);
+    fraction = gridPos - base;
+}
+
+bool insideGrid(ivec2 node)
+{
+    return all(greaterThanEqual(node, ivec2(0))) && all(lessThan(node, ivec2(pc.gridSize)));
+}
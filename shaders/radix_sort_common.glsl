@@ -0,0 +1,70 @@
+// Shared declarations for the key/value radix sort passes.
+// Each pass sorts by RADIX_BITS bits of the key, starting at pc.shift, and
+// ping-pongs between the primary and the alternate buffers.
+
+#define RADIX_BITS 4
+#define RADIX_SIZE 16
+#define RADIX_BLOCK_SIZE 256
+
+layout(std430, set = 0, binding = 0) buffer Keys
+{
+    uint keys[ ];
+};
+
+layout(std430, set = 0, binding = 1) buffer Values
+{
+    uint values[ ];
+};
+
+layout(std430, set = 0, binding = 2) buffer KeysAlt
+{
+    uint keysAlt[ ];
+};
+
+layout(std430, set = 0, binding = 3) buffer ValuesAlt
+{
+    uint valuesAlt[ ];
+};
+
+// Block counts per digit, stored digit major: histogram[digit * groupCount + block]
+layout(std430, set = 0, binding = 4) buffer Histogram
+{
+    uint histogram[ ];
+};
+
+layout(push_constant) uniform RadixSortPush
+{
+    uint count;
+    uint shift;
+    uint groupCount;
+    uint flip; // 0: read primary, write alternate. 1: the reverse
+} pc;
+
+uint loadKey(uint index)
+{
+    return pc.flip == 0 ? keys[index] : keysAlt[index];
+}
+
+uint loadValue(uint index)
+{
+    return pc.flip == 0 ? values[index] : valuesAlt[index];
+}
+
+void storeKeyValue(uint index, uint key, uint value)
+{
+    if (pc.flip == 0)
+    {
+        keysAlt[index] = key;
+        valuesAlt[index] = value;
+    }
+    else
+    {
+        keys[index] = key;
+        values[index] = value;
+    }
+}
+
+uint digitOf(uint key)
+{
+    return (key >> pc.shift) & (RADIX_SIZE - 1);
+}
@@ -0,0 +1,84 @@
+// Shared declarations for the SpatialSortSystem passes. Particles are reordered
+// by the Morton key of their position: the state in bindings 0-2 is gathered in
+// sorted order into the next state, the particle ids and masses travel along.
+// Slots past the live count sort to the end.
+layout(std430, set = 0, binding = 0) readonly buffer Positions
+{
+    vec2 positions[ ];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Velocities
+{
+    vec2 velocities[ ];
+};
+
+layout(std430, set = 0, binding = 2) readonly buffer ColorValues
+{
+    float colorValues[ ];
+};
+
+layout(std430, set = 0, binding = 3) writeonly buffer PositionsNext
+{
+    vec2 positionsNext[ ];
+};
+
+layout(std430, set = 0, binding = 4) writeonly buffer VelocitiesNext
+{
+    vec2 velocitiesNext[ ];
+};
+
+layout(std430, set = 0, binding = 5) writeonly buffer ColorValuesNext
+{
+    float colorValuesNext[ ];
+};
+
+layout(std430, set = 0, binding = 6) readonly buffer ParticleIds
+{
+    uint particleIds[ ];
+};
+
+layout(std430, set = 0, binding = 7) writeonly buffer ParticleIdsNext
+{
+    uint particleIdsNext[ ];
+};
+
+// Bounding box as order preserving ints so it can be reduced with atomics
+layout(std430, set = 0, binding = 8) buffer SortBounds
+{
+    ivec4 sortBounds; // min.xy, max.xy
+};
+
+// key and value buffers of the RadixSortSystem
+layout(std430, set = 0, binding = 9) buffer SortKeys
+{
+    uint sortKeys[ ];
+};
+
+layout(std430, set = 0, binding = 10) buffer SortIndices
+{
+    uint sortIndices[ ];
+};
+
+layout(std430, set = 0, binding = 11) readonly buffer Masses
+{
+    float masses[ ];
+};
+
+// scratch buffer the masses are gathered into, copied back by SpatialSortSystem
+layout(std430, set = 0, binding = 12) writeonly buffer MassesNext
+{
+    float massesNext[ ];
+};
+
+// PgsModel::CountArgs
+layout(std430, set = 0, binding = 13) readonly buffer ParticleCount
+{
+    uint liveParticleCount;
+};
+
+layout(push_constant) uniform SpatialSortPush
+{
+    uint particleCount;
+} pc;
+
+#include "morton_common.glsl"
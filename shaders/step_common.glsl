@@ -0,0 +1,41 @@
+// Per-step inputs of the shaders that integrate particles (particle.comp,
+// particle_tiled.comp, particle_restricted.comp and integrate.comp). Pushed by ParticleSystem, so a step
+// needs no uniform buffer update. Include after gravity_common.glsl.
+
+// must match StepPushConstants in particle_system.cpp
+layout(push_constant) uniform StepPush
+{
+    float frameTime;
+    // particles the host dispatched over, an upper bound of liveParticleCount
+    uint particleCount;
+    // sources the all-pairs kernels sum over, clamped to liveParticleCount. All of
+    // them unless ParticleSystem splits the sum into chunks, the massive bodies
+    // for particle_restricted.comp.
+    uint sourceBegin;
+    uint sourceEnd;
+} pc;
+
+// Adds one chunk's sum to the accelerations, the first chunk overwrites the last step's
+void accumulateAcceleration(uint index, vec2 acceleration)
+{
+    vec2 sum = pc.sourceBegin == 0 ? vec2(0.0, 0.0) : accelerations[index];
+    accelerations[index] = sum + acceleration;
+}
+
+// Semi-implicit Euler step of one particle with the accumulated acceleration
+void integrateParticle(uint index, vec2 acceleration)
+{
+    vec2 vVel = velocities[index];
+    vec2 vPos = positions[index];
+
+    // update this particle's velocity
+    vVel += acceleration * pc.frameTime;
+
+    // update this particles position
+    vPos += vVel * pc.frameTime;
+
+    // write back
+    positionsOut[index] = vPos;
+    velocitiesOut[index] = vVel;
+    colorValuesOut[index] = length(acceleration);
+}
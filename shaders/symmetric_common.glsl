@@ -0,0 +1,27 @@
+// Shared declarations for the symmetric all-pairs passes, see SymmetricForceSystem.
+// Particles are split into blocks of SYMMETRIC_TILE_SIZE. The pair pass of row
+// block I sums the pulls on its own particles from every column block J >= I and
+// stores the equal and opposite pulls on the particles of J, which the reduce pass
+// adds to their accelerations. Column blocks are processed in bands so the stored
+// reactions fit the reaction buffer.
+
+// must match SymmetricForceSystem::TILE_SIZE
+#define SYMMETRIC_TILE_SIZE 256u
+
+// One tile of reactions per (column block in the band, row block) pair
+layout(std430, set = 1, binding = 0) buffer Reactions
+{
+    vec2 reactions[ ];
+};
+
+layout(push_constant) uniform SymmetricPush
+{
+    uint blockCount;
+    uint bandBegin; // first column block of the band
+    uint bandEnd;   // one past the last column block of the band
+} pc;
+
+uint reactionTile(uint columnBlock, uint rowBlock)
+{
+    return ((columnBlock - pc.bandBegin) * pc.blockCount + rowBlock) * SYMMETRIC_TILE_SIZE;
+}
@@ -0,0 +1,91 @@
+#include "compute_backend.hpp"
+
+// std
+#include <cassert>
+
+namespace pgs
+{
+
+ComputeBackend::ComputeBackend(
+	PgsDevice &device,
+	ParticleSystem &particleSystem,
+	PgsModel &model,
+	const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets)
+	: m_pgsDevice{device},
+	  m_particleSystem{particleSystem},
+	  m_model{model},
+	  m_globalDescriptorSets{globalDescriptorSets}
+{
+	if (m_pgsDevice.properties.limits.timestampComputeAndGraphics == VK_TRUE)
+	{
+		for (auto &timer : m_timers)
+		{
+			timer = std::make_unique<PgsGpuTimer>(m_pgsDevice, 2);
+		}
+	}
+}
+
+void ComputeBackend::step(float stepTime, uint32_t stepCount)
+{
+	assert((m_pendingSteps == 0 || stepCount == 0 || stepTime == m_stepTime) &&
+		   "Steps of one present must share their step time");
+	if (stepCount > 0)
+	{
+		m_stepTime = stepTime;
+	}
+	m_pendingSteps += stepCount;
+
+	m_stats.steps += stepCount;
+	m_stats.simulatedTime += stepCount * stepTime;
+}
+
+void ComputeBackend::present(FrameInfo &frameInfo)
+{
+	collectTiming(frameInfo.frameIndex);
+
+	FrameInfo stepInfo = frameInfo;
+	stepInfo.frameTime = m_stepTime;
+
+	auto &timer = m_timers[frameInfo.frameIndex];
+	bool timed = timer && m_pendingSteps > 0;
+	if (timed)
+	{
+		timer->reset(frameInfo.commandBuffer);
+		timer->writeTimestamp(frameInfo.commandBuffer, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+	}
+	m_particleSystem.computeParticles(stepInfo, m_pendingSteps, m_globalDescriptorSets);
+	if (timed)
+	{
+		timer->writeTimestamp(frameInfo.commandBuffer, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		m_timedSteps[frameInfo.frameIndex] = m_pendingSteps;
+	}
+	m_pendingSteps = 0;
+}
+
+void ComputeBackend::collectTiming(int frameIndex)
+{
+	uint32_t steps = m_timedSteps[frameIndex];
+	m_timedSteps[frameIndex] = 0;
+	// the frame's fence was waited on, so its results are ready unless it was dropped
+	if (steps == 0 || !m_timers[frameIndex]->fetchResults(false))
+	{
+		return;
+	}
+	m_stats.timedSteps += steps;
+	m_stats.milliseconds += m_timers[frameIndex]->elapsedMilliseconds(0, 1);
+}
+
+std::vector<Particle> ComputeBackend::readState()
+{
+	vkDeviceWaitIdle(m_pgsDevice.device());
+	return m_model.readParticles();
+}
+
+void ComputeBackend::uploadState(const std::vector<Particle> &particles)
+{
+	vkDeviceWaitIdle(m_pgsDevice.device());
+	m_model.writeParticles(particles);
+	m_particleSystem.invalidateState();
+}
+
+} // namespace pgs
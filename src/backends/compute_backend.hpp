@@ -0,0 +1,62 @@
+#pragma once
+
+#include "simulation_backend.hpp"
+#include "simulation_presenter.hpp"
+#include "pgs_device.hpp"
+#include "pgs_gpu_timer.hpp"
+#include "pgs_swap_chain.hpp"
+#include "systems/particle_system.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+namespace pgs
+{
+// The compute shader simulation. step() only queues the steps, present() records them
+// as ParticleSystem::computeParticles into the frame's command buffer with whichever
+// solver and integrator the system is set to. The recorded steps are bracketed by
+// timestamp queries, one PgsGpuTimer per frame in flight, read back once the frame's
+// fence was waited on; devices without timestamps leave the steps untimed.
+class ComputeBackend : public SimulationBackend, public SimulationPresenter
+{
+  public:
+	// globalDescriptorSets is indexed by the state buffer a step reads, like
+	// ParticleSystem::computeParticles
+	ComputeBackend(PgsDevice &device,
+				   ParticleSystem &particleSystem,
+				   PgsModel &model,
+				   const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets);
+
+	Type getType() const override
+	{
+		return Type::Compute;
+	}
+	bool isDeviceTimed() const override
+	{
+		return true;
+	}
+
+	// steps queued before one present share its step time
+	void step(float stepTime, uint32_t stepCount) override;
+	void present(FrameInfo &frameInfo) override;
+	std::vector<Particle> readState() override;
+	void uploadState(const std::vector<Particle> &particles) override;
+
+  private:
+	// adds the steps timed in frameIndex's last use to the stats
+	void collectTiming(int frameIndex);
+
+	PgsDevice &m_pgsDevice;
+	ParticleSystem &m_particleSystem;
+	PgsModel &m_model;
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> m_globalDescriptorSets;
+
+	// queued by step, recorded by the next present
+	uint32_t m_pendingSteps = 0;
+	float m_stepTime = 0.0f;
+	// empty if the device has no timestamps, m_timedSteps waits for the frame's results
+	std::array<std::unique_ptr<PgsGpuTimer>, PgsSwapChain::MAX_FRAMES_IN_FLIGHT> m_timers;
+	std::array<uint32_t, PgsSwapChain::MAX_FRAMES_IN_FLIGHT> m_timedSteps{};
+};
+} // namespace pgs
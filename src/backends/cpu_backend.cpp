@@ -0,0 +1,46 @@
+#include "cpu_backend.hpp"
+
+// std
+#include <chrono>
+
+namespace pgs
+{
+
+CpuBackend::CpuBackend(const std::vector<Particle> &particles, uint32_t threadCount, bool pinThreads)
+	: m_simulation{std::make_unique<CpuSimulation>(particles, threadCount, pinThreads)}
+{
+}
+
+void CpuBackend::step(float stepTime, uint32_t stepCount)
+{
+	if (stepCount == 0)
+	{
+		return;
+	}
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < stepCount; i++)
+	{
+		m_simulation->step(stepTime);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stateVersion++;
+
+	m_stats.steps += stepCount;
+	m_stats.simulatedTime += stepCount * stepTime;
+	m_stats.timedSteps += stepCount;
+	m_stats.milliseconds += std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+std::vector<Particle> CpuBackend::readState()
+{
+	return m_simulation->getParticles();
+}
+
+void CpuBackend::uploadState(const std::vector<Particle> &particles)
+{
+	m_simulation->setParticles(particles);
+	m_stateVersion++;
+}
+
+} // namespace pgs
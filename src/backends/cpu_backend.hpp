@@ -0,0 +1,55 @@
+#pragma once
+
+#include "simulation_backend.hpp"
+#include "cpu/cpu_simulation.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+// Steps a CpuSimulation on the host. Needs no device, HeadlessApp runs it as is; the
+// frame loop draws its state through a CpuStateUpload.
+class CpuBackend : public SimulationBackend
+{
+  public:
+	// 0 threads uses every CPU the process may run on
+	explicit CpuBackend(const std::vector<Particle> &particles,
+						uint32_t threadCount = 0,
+						bool pinThreads = true);
+
+	CpuBackend(const CpuBackend &) = delete;
+	CpuBackend &operator=(const CpuBackend &) = delete;
+
+	Type getType() const override
+	{
+		return Type::Cpu;
+	}
+	bool isDeviceTimed() const override
+	{
+		return false;
+	}
+	// force solver, kernel and thread count
+	CpuSimulation &getSimulation()
+	{
+		return *m_simulation;
+	}
+	const CpuSimulation &getSimulation() const
+	{
+		return *m_simulation;
+	}
+	// bumped by every step and uploadState, so presenters can skip unchanged states
+	uint64_t getStateVersion() const
+	{
+		return m_stateVersion;
+	}
+
+	void step(float stepTime, uint32_t stepCount) override;
+	std::vector<Particle> readState() override;
+	void uploadState(const std::vector<Particle> &particles) override;
+
+  private:
+	std::unique_ptr<CpuSimulation> m_simulation;
+	uint64_t m_stateVersion = 0;
+};
+} // namespace pgs
@@ -0,0 +1,106 @@
+#include "cpu_state_upload.hpp"
+
+// std
+#include <cassert>
+
+namespace pgs
+{
+
+CpuStateUpload::CpuStateUpload(PgsDevice &device, PgsModel &model, const CpuBackend &backend)
+	: m_pgsDevice{device},
+	  m_model{model},
+	  m_backend{backend},
+	  m_presentedVersion{backend.getStateVersion()}
+{
+	createStagingBuffers();
+}
+
+void CpuStateUpload::createStagingBuffers()
+{
+	// sized for every slot, the live count never grows past it
+	VkDeviceSize slotSize = 2 * sizeof(glm::vec2) + sizeof(float);
+	for (auto &stagingBuffer : m_stagingBuffers)
+	{
+		stagingBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													slotSize,
+													m_model.getParticleCount(),
+													VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+													VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+														VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		stagingBuffer->map();
+	}
+}
+
+void CpuStateUpload::present(FrameInfo &frameInfo)
+{
+	// the model's buffers already hold this state
+	if (m_backend.getStateVersion() == m_presentedVersion)
+	{
+		return;
+	}
+	m_presentedVersion = m_backend.getStateVersion();
+
+	const CpuSimulation &simulation = m_backend.getSimulation();
+	uint32_t particleCount = simulation.getParticleCount();
+	assert(particleCount <= m_model.getParticleCount() && "More particles than model slots");
+	VkDeviceSize vec2Size = particleCount * sizeof(glm::vec2);
+	VkDeviceSize floatSize = particleCount * sizeof(float);
+	auto &stagingBuffer = *m_stagingBuffers[frameInfo.frameIndex];
+	auto *mapped = static_cast<char *>(stagingBuffer.getMappedMemory());
+	simulation.writeState(reinterpret_cast<glm::vec2 *>(mapped),
+						  reinterpret_cast<glm::vec2 *>(mapped + vec2Size),
+						  reinterpret_cast<float *>(mapped + 2 * vec2Size));
+
+	// earlier frames on the queue may still draw from the state being overwritten
+	VkMemoryBarrier beginBarrier{};
+	beginBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	beginBarrier.srcAccessMask = 0;
+	beginBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(frameInfo.commandBuffer,
+						 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 0,
+						 1,
+						 &beginBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	auto &state = m_model.getCurrentState();
+	VkBufferCopy positionRegion{0, 0, vec2Size};
+	VkBufferCopy velocityRegion{vec2Size, 0, vec2Size};
+	VkBufferCopy colorValueRegion{2 * vec2Size, 0, floatSize};
+	vkCmdCopyBuffer(frameInfo.commandBuffer,
+					stagingBuffer.getBuffer(),
+					state.positions->getBuffer(),
+					1,
+					&positionRegion);
+	vkCmdCopyBuffer(frameInfo.commandBuffer,
+					stagingBuffer.getBuffer(),
+					state.velocities->getBuffer(),
+					1,
+					&velocityRegion);
+	vkCmdCopyBuffer(frameInfo.commandBuffer,
+					stagingBuffer.getBuffer(),
+					state.colorValues->getBuffer(),
+					1,
+					&colorValueRegion);
+
+	VkMemoryBarrier endBarrier{};
+	endBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	endBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	endBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(frameInfo.commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+						 0,
+						 1,
+						 &endBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+} // namespace pgs
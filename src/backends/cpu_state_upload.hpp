@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cpu_backend.hpp"
+#include "simulation_presenter.hpp"
+#include "pgs_buffer.hpp"
+#include "pgs_device.hpp"
+#include "pgs_swap_chain.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+namespace pgs
+{
+// Presents a CpuBackend: uploads every new host state into the model's current state
+// buffers, so the renderer draws it like a compute step. The upload goes through one
+// host visible staging buffer per frame in flight, a frame's buffer is free again once
+// its fence was waited on.
+class CpuStateUpload : public SimulationPresenter
+{
+  public:
+	// the backend's particle count must stay within the model's
+	CpuStateUpload(PgsDevice &device, PgsModel &model, const CpuBackend &backend);
+
+	CpuStateUpload(const CpuStateUpload &) = delete;
+	CpuStateUpload &operator=(const CpuStateUpload &) = delete;
+
+	void present(FrameInfo &frameInfo) override;
+
+  private:
+	void createStagingBuffers();
+
+	PgsDevice &m_pgsDevice;
+	PgsModel &m_model;
+	const CpuBackend &m_backend;
+	// state version the model's buffers hold, see CpuBackend::getStateVersion
+	uint64_t m_presentedVersion;
+	// positions, velocities and color values of the model's particle slots, back to back
+	std::array<std::unique_ptr<PgsBuffer>, PgsSwapChain::MAX_FRAMES_IN_FLIGHT> m_stagingBuffers;
+};
+} // namespace pgs
@@ -0,0 +1,19 @@
+#include "simulation_backend.hpp"
+
+namespace pgs
+{
+
+const char *SimulationBackend::typeName(Type type)
+{
+	switch (type)
+	{
+	case Type::Compute:
+		return "compute";
+	case Type::Cpu:
+		return "cpu";
+	default:
+		return "unknown";
+	}
+}
+
+} // namespace pgs
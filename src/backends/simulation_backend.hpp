@@ -0,0 +1,67 @@
+#pragma once
+
+#include "pgs_particles.hpp"
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace pgs
+{
+// Physics engine behind GravSimApp's frame loop and HeadlessApp. Stepping needs no
+// device or command buffer; the frame loop pairs every backend with a
+// SimulationPresenter, which records whatever puts the stepped state into the model's
+// current state buffers, so drawing never depends on where the simulation ran.
+class SimulationBackend
+{
+  public:
+	enum class Type
+	{
+		Compute, // the compute shaders of ParticleSystem, see ComputeBackend
+		Cpu, // CpuSimulation on the host, see CpuBackend
+		Count
+	};
+	static const char *typeName(Type type);
+
+	// counted since the last resetStats
+	struct Stats
+	{
+		uint32_t steps;
+		double simulatedTime;
+		// steps covered by milliseconds. Device timings are read back once their frame
+		// finished, so they trail steps by the frames in flight.
+		uint32_t timedSteps;
+		// time the timed steps took where they ran: wall clock for host backends,
+		// timestamp queries for device backends, see isDeviceTimed
+		double milliseconds;
+	};
+
+	virtual ~SimulationBackend() = default;
+
+	virtual Type getType() const = 0;
+	// whether Stats::milliseconds is time on the device rather than on the host
+	virtual bool isDeviceTimed() const = 0;
+
+	// Advances the state by stepCount steps of stepTime. Host backends step right away,
+	// device backends queue the steps for their presenter to record.
+	virtual void step(float stepTime, uint32_t stepCount) = 0;
+	// Blocking, waits for the device if there is one: the live particles in creation
+	// order, particles merged away are missing
+	virtual std::vector<Particle> readState() = 0;
+	// Blocking, waits for the device if there is one: replaces the state, at most the
+	// model's particle count when drawn
+	virtual void uploadState(const std::vector<Particle> &particles) = 0;
+
+	const Stats &getStats() const
+	{
+		return m_stats;
+	}
+	void resetStats()
+	{
+		m_stats = Stats{};
+	}
+
+  protected:
+	Stats m_stats{};
+};
+} // namespace pgs
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "pgs_frame_info.hpp"
+
+namespace pgs
+{
+// Device side of a SimulationBackend in the frame loop: records into
+// frameInfo.commandBuffer whatever makes the state of the backend's last steps current
+// in the model's state buffers. Called once per frame after SimulationBackend::step and
+// before the frame draws; the state is current once that command buffer ran.
+class SimulationPresenter
+{
+  public:
+	virtual ~SimulationPresenter() = default;
+
+	virtual void present(FrameInfo &frameInfo) = 0;
+};
+} // namespace pgs
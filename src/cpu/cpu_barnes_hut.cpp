@@ -0,0 +1,417 @@
+#include "cpu_barnes_hut.hpp"
+
+// std
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <numeric>
+
+namespace pgs
+{
+
+namespace
+{
+
+// particles per task of the bounds and key passes
+constexpr uint32_t KEY_TILE = 4096;
+// subtrees per thread the serial top of the build splits into, more balance the
+// parallel part better at the cost of a deeper serial split
+constexpr uint32_t SUBTREES_PER_THREAD = 8;
+// target groups per traversal task, 256 particles like the all-pairs tiles
+constexpr uint32_t GROUPS_PER_TASK = 16;
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_BUCKETS = 1u << RADIX_BITS;
+
+// spreads the low 16 bits of v to the even bits
+uint32_t spreadBits(uint32_t v)
+{
+	v &= 0xFFFF;
+	v = (v | (v << 8)) & 0x00FF00FF;
+	v = (v | (v << 4)) & 0x0F0F0F0F;
+	v = (v | (v << 2)) & 0x33333333;
+	v = (v | (v << 1)) & 0x55555555;
+	return v;
+}
+
+} // namespace
+
+const std::vector<uint32_t> &CpuBarnesHut::sortByMortonKey(CpuThreadPool &threadPool,
+														   const float *x,
+														   const float *y,
+														   uint32_t particleCount)
+{
+	// bounding box, per tile then combined
+	uint32_t tileCount = (particleCount + KEY_TILE - 1) / KEY_TILE;
+	std::vector<std::array<float, 4>> tileBounds(tileCount);
+	threadPool.parallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+		uint32_t begin = tile * KEY_TILE;
+		uint32_t end = std::min(begin + KEY_TILE, particleCount);
+		std::array<float, 4> bounds{x[begin], y[begin], x[begin], y[begin]};
+		for (uint32_t i = begin + 1; i < end; i++)
+		{
+			bounds[0] = std::min(bounds[0], x[i]);
+			bounds[1] = std::min(bounds[1], y[i]);
+			bounds[2] = std::max(bounds[2], x[i]);
+			bounds[3] = std::max(bounds[3], y[i]);
+		}
+		tileBounds[tile] = bounds;
+	});
+
+	float minX = std::numeric_limits<float>::max();
+	float minY = std::numeric_limits<float>::max();
+	float maxX = std::numeric_limits<float>::lowest();
+	float maxY = std::numeric_limits<float>::lowest();
+	for (const auto &bounds : tileBounds)
+	{
+		minX = std::min(minX, bounds[0]);
+		minY = std::min(minY, bounds[1]);
+		maxX = std::max(maxX, bounds[2]);
+		maxY = std::max(maxY, bounds[3]);
+	}
+	// slightly larger than the box, so the largest coordinate quantizes inside the grid
+	float size = std::max(maxX - minX, maxY - minY) * 1.0001f;
+	m_rootX = minX;
+	m_rootY = minY;
+	m_rootSize = size > 0.0f ? size : 1.0f;
+
+	m_keys.resize(particleCount);
+	m_order.resize(particleCount);
+	float scale = static_cast<float>(1u << KEY_BITS) / m_rootSize;
+	threadPool.parallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+		uint32_t begin = tile * KEY_TILE;
+		uint32_t end = std::min(begin + KEY_TILE, particleCount);
+		const uint32_t maxCell = (1u << KEY_BITS) - 1;
+		for (uint32_t i = begin; i < end; i++)
+		{
+			uint32_t cellX = std::min(static_cast<uint32_t>((x[i] - m_rootX) * scale), maxCell);
+			uint32_t cellY = std::min(static_cast<uint32_t>((y[i] - m_rootY) * scale), maxCell);
+			m_keys[i] = spreadBits(cellX) | (spreadBits(cellY) << 1);
+			m_order[i] = i;
+		}
+	});
+
+	// least significant digit first radix sort, serial: at 8 bits a digit it is a few
+	// linear passes, cheap next to the walk
+	m_keyScratch.resize(particleCount);
+	m_orderScratch.resize(particleCount);
+	for (uint32_t shift = 0; shift < 2 * KEY_BITS; shift += RADIX_BITS)
+	{
+		std::array<uint32_t, RADIX_BUCKETS> offsets{};
+		for (uint32_t i = 0; i < particleCount; i++)
+		{
+			offsets[(m_keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+		}
+		uint32_t sum = 0;
+		for (auto &offset : offsets)
+		{
+			uint32_t count = offset;
+			offset = sum;
+			sum += count;
+		}
+		for (uint32_t i = 0; i < particleCount; i++)
+		{
+			uint32_t slot = offsets[(m_keys[i] >> shift) & (RADIX_BUCKETS - 1)]++;
+			m_keyScratch[slot] = m_keys[i];
+			m_orderScratch[slot] = m_order[i];
+		}
+		m_keys.swap(m_keyScratch);
+		m_order.swap(m_orderScratch);
+	}
+
+	return m_order;
+}
+
+void CpuBarnesHut::resizeScratch(uint32_t threadCount)
+{
+	if (m_scratch.size() != threadCount)
+	{
+		m_scratch.resize(threadCount);
+	}
+}
+
+bool CpuBarnesHut::isLeafRange(const Node &node, uint32_t level) const
+{
+	return node.end - node.begin <= m_leafSize || level >= KEY_BITS;
+}
+
+bool CpuBarnesHut::splitNode(Node &node, uint32_t level, WorkerScratch &scratch)
+{
+	if (isLeafRange(node, level))
+	{
+		return false;
+	}
+
+	// keys in the node share every digit above this level, so this level's digit is
+	// sorted and each quadrant is a contiguous range
+	uint32_t shift = 2 * (KEY_BITS - 1 - level);
+	std::array<uint32_t, 5> bounds;
+	bounds[0] = node.begin;
+	bounds[4] = node.end;
+	for (uint32_t digit = 1; digit < 4; digit++)
+	{
+		bounds[digit] = static_cast<uint32_t>(
+			std::partition_point(m_keys.begin() + bounds[digit - 1],
+								 m_keys.begin() + node.end,
+								 [&](uint32_t key) { return ((key >> shift) & 3) < digit; }) -
+			m_keys.begin());
+	}
+
+	uint32_t childCount = 0;
+	for (uint32_t digit = 0; digit < 4; digit++)
+	{
+		childCount += bounds[digit + 1] > bounds[digit];
+	}
+	node.children = scratch.arena.allocate<Node>(childCount);
+	node.childCount = childCount;
+	scratch.nodeCount += childCount;
+
+	// digit bit 0 is the x half, bit 1 the y half
+	float half = node.size * 0.5f;
+	Node *child = node.children;
+	for (uint32_t digit = 0; digit < 4; digit++)
+	{
+		if (bounds[digit + 1] == bounds[digit])
+		{
+			continue;
+		}
+		child->comX = 0.0f;
+		child->comY = 0.0f;
+		child->mass = 0.0f;
+		child->cellX = node.cellX + ((digit & 1) ? half : 0.0f);
+		child->cellY = node.cellY + ((digit & 2) ? half : 0.0f);
+		child->size = half;
+		child->begin = bounds[digit];
+		child->end = bounds[digit + 1];
+		child->children = nullptr;
+		child->childCount = 0;
+		child++;
+	}
+	return true;
+}
+
+void CpuBarnesHut::buildSubtree(Node &node,
+								uint32_t level,
+								const CpuParticleView &particles,
+								WorkerScratch &scratch)
+{
+	if (!splitNode(node, level, scratch))
+	{
+		summarizeLeaf(node, particles);
+		return;
+	}
+	for (uint32_t c = 0; c < node.childCount; c++)
+	{
+		buildSubtree(node.children[c], level + 1, particles, scratch);
+	}
+	summarizeChildren(node);
+}
+
+void CpuBarnesHut::summarizeLeaf(Node &node, const CpuParticleView &particles)
+{
+	float mass = 0.0f;
+	float weightedX = 0.0f;
+	float weightedY = 0.0f;
+	for (uint32_t i = node.begin; i < node.end; i++)
+	{
+		mass += particles.mass[i];
+		weightedX += particles.mass[i] * particles.x[i];
+		weightedY += particles.mass[i] * particles.y[i];
+	}
+	node.mass = mass;
+	// massless nodes pull nothing, the walk skips them
+	node.comX = mass > 0.0f ? weightedX / mass : node.cellX + node.size * 0.5f;
+	node.comY = mass > 0.0f ? weightedY / mass : node.cellY + node.size * 0.5f;
+}
+
+void CpuBarnesHut::summarizeChildren(Node &node)
+{
+	float mass = 0.0f;
+	float weightedX = 0.0f;
+	float weightedY = 0.0f;
+	for (uint32_t c = 0; c < node.childCount; c++)
+	{
+		const Node &child = node.children[c];
+		mass += child.mass;
+		weightedX += child.mass * child.comX;
+		weightedY += child.mass * child.comY;
+	}
+	node.mass = mass;
+	node.comX = mass > 0.0f ? weightedX / mass : node.cellX + node.size * 0.5f;
+	node.comY = mass > 0.0f ? weightedY / mass : node.cellY + node.size * 0.5f;
+}
+
+void CpuBarnesHut::build(CpuThreadPool &threadPool,
+						 const CpuParticleView &particles,
+						 uint32_t particleCount)
+{
+	uint32_t threadCount = threadPool.getThreadCount();
+	resizeScratch(threadCount);
+	for (auto &scratch : m_scratch)
+	{
+		scratch.arena.reset();
+		scratch.nodeCount = 0;
+	}
+	m_root = nullptr;
+	if (particleCount == 0)
+	{
+		return;
+	}
+
+	m_root = m_scratch[0].arena.allocate<Node>(1);
+	*m_root = Node{0.0f, 0.0f, 0.0f, m_rootX, m_rootY, m_rootSize, 0, particleCount, nullptr, 0};
+	m_scratch[0].nodeCount = 1;
+
+	// split the top levels breadth first on this thread until every worker gets a few
+	// subtrees, the split nodes are summarized once their subtrees are done
+	struct PendingNode
+	{
+		Node *node;
+		uint32_t level;
+	};
+	std::vector<PendingNode> frontier{{m_root, 0}};
+	std::vector<Node *> splitNodes;
+	while (frontier.size() < SUBTREES_PER_THREAD * threadCount)
+	{
+		std::vector<PendingNode> next;
+		bool split = false;
+		for (const auto &pending : frontier)
+		{
+			if (!splitNode(*pending.node, pending.level, m_scratch[0]))
+			{
+				next.push_back(pending);
+				continue;
+			}
+			split = true;
+			splitNodes.push_back(pending.node);
+			for (uint32_t c = 0; c < pending.node->childCount; c++)
+			{
+				next.push_back({&pending.node->children[c], pending.level + 1});
+			}
+		}
+		frontier.swap(next);
+		if (!split)
+		{
+			break;
+		}
+	}
+
+	threadPool.parallelFor(static_cast<uint32_t>(frontier.size()), [&](uint32_t i, uint32_t worker) {
+		buildSubtree(*frontier[i].node, frontier[i].level, particles, m_scratch[worker]);
+	});
+
+	// children were split after their parents, so summarize in reverse
+	for (auto it = splitNodes.rbegin(); it != splitNodes.rend(); ++it)
+	{
+		summarizeChildren(**it);
+	}
+}
+
+void CpuBarnesHut::computeAccelerations(CpuThreadPool &threadPool,
+										CpuForceKernelFunction kernel,
+										const CpuParticleView &particles,
+										uint32_t particleCount,
+										CpuForceConstants constants,
+										float *ax,
+										float *ay)
+{
+	if (m_root == nullptr)
+	{
+		return;
+	}
+	resizeScratch(threadPool.getThreadCount());
+
+	float openingAngleSqr = m_openingAngle * m_openingAngle;
+	uint32_t groupCount = (particleCount + CPU_PARTICLE_ALIGNMENT - 1) / CPU_PARTICLE_ALIGNMENT;
+	uint32_t taskCount = (groupCount + GROUPS_PER_TASK - 1) / GROUPS_PER_TASK;
+	threadPool.parallelFor(taskCount, [&](uint32_t task, uint32_t worker) {
+		WorkerScratch &scratch = m_scratch[worker];
+		uint32_t groupEnd = std::min((task + 1) * GROUPS_PER_TASK, groupCount);
+		for (uint32_t group = task * GROUPS_PER_TASK; group < groupEnd; group++)
+		{
+			uint32_t begin = group * CPU_PARTICLE_ALIGNMENT;
+			uint32_t end = std::min(begin + CPU_PARTICLE_ALIGNMENT, particleCount);
+			float minX = particles.x[begin];
+			float minY = particles.y[begin];
+			float maxX = minX;
+			float maxY = minY;
+			for (uint32_t i = begin + 1; i < end; i++)
+			{
+				minX = std::min(minX, particles.x[i]);
+				minY = std::min(minY, particles.y[i]);
+				maxX = std::max(maxX, particles.x[i]);
+				maxY = std::max(maxY, particles.y[i]);
+			}
+
+			scratch.listX.clear();
+			scratch.listY.clear();
+			scratch.listMass.clear();
+			scratch.stack.clear();
+			scratch.stack.push_back(m_root);
+			while (!scratch.stack.empty())
+			{
+				const Node *node = scratch.stack.back();
+				scratch.stack.pop_back();
+				if (node->mass == 0.0f)
+				{
+					continue;
+				}
+
+				// a cell overlapping the group is always opened, the group's own
+				// particles must never hide in a monopole
+				bool overlaps = maxX >= node->cellX && minX <= node->cellX + node->size &&
+								maxY >= node->cellY && minY <= node->cellY + node->size;
+				float dx = std::max(std::max(minX - node->comX, node->comX - maxX), 0.0f);
+				float dy = std::max(std::max(minY - node->comY, node->comY - maxY), 0.0f);
+				if (!overlaps && node->size * node->size < openingAngleSqr * (dx * dx + dy * dy))
+				{
+					scratch.listX.push_back(node->comX);
+					scratch.listY.push_back(node->comY);
+					scratch.listMass.push_back(node->mass);
+				}
+				else if (node->childCount == 0)
+				{
+					for (uint32_t i = node->begin; i < node->end; i++)
+					{
+						scratch.listX.push_back(particles.x[i]);
+						scratch.listY.push_back(particles.y[i]);
+						scratch.listMass.push_back(particles.mass[i]);
+					}
+				}
+				else
+				{
+					for (uint32_t c = 0; c < node->childCount; c++)
+					{
+						scratch.stack.push_back(&node->children[c]);
+					}
+				}
+			}
+
+			// the group is one vector wide at most, padding included
+			std::fill(ax + begin, ax + begin + CPU_PARTICLE_ALIGNMENT, 0.0f);
+			std::fill(ay + begin, ay + begin + CPU_PARTICLE_ALIGNMENT, 0.0f);
+			CpuParticleView sources{scratch.listX.data(), scratch.listY.data(), scratch.listMass.data()};
+			kernel(particles,
+				   begin,
+				   end,
+				   sources,
+				   0,
+				   static_cast<uint32_t>(scratch.listX.size()),
+				   constants,
+				   ax,
+				   ay);
+		}
+	});
+}
+
+uint32_t CpuBarnesHut::getNodeCount() const
+{
+	uint32_t nodeCount = 0;
+	for (const auto &scratch : m_scratch)
+	{
+		nodeCount += scratch.nodeCount;
+	}
+	return nodeCount;
+}
+
+} // namespace pgs
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "cpu_bump_arena.hpp"
+#include "cpu_force_kernels.hpp"
+#include "cpu_thread_pool.hpp"
+
+// std
+#include <vector>
+
+namespace pgs
+{
+// Barnes-Hut quadtree on the host, O(N log N) per step. A step runs four phases:
+// 1. sortByMortonKey: 16 bit per axis Morton keys over the bounding square, radix sorted.
+//    The caller reorders its particles into that order, so every node covers a contiguous
+//    range of them.
+// 2. build: the top levels are split serially until there are a few subtrees per thread,
+//    the subtrees are built in parallel by splitting key ranges 2 bits at a time, then the
+//    top levels are summarized. Nodes come from a bump arena per worker, reset every step.
+// 3. computeAccelerations: groups of CPU_PARTICLE_ALIGNMENT consecutive particles walk the
+//    tree together. A node is accepted when its width is below the opening angle times
+//    its center of mass's distance to the group's bounds, opened leaves contribute their
+//    particles. The accepted nodes and leaf particles form an interaction list that the
+//    SIMD force kernel sums for the whole group, and the walks run as work-stealing tasks.
+class CpuBarnesHut
+{
+  public:
+	static constexpr float DEFAULT_OPENING_ANGLE = 0.5f;
+	static constexpr uint32_t DEFAULT_LEAF_SIZE = 16;
+	// Morton key bits per axis, cells stop splitting below 2^-16 of the root width
+	static constexpr uint32_t KEY_BITS = 16;
+
+	struct Node
+	{
+		float comX;
+		float comY;
+		float mass;
+		// lower corner and width of the cell
+		float cellX;
+		float cellY;
+		float size;
+		// particles in Morton order
+		uint32_t begin;
+		uint32_t end;
+		// contiguous in the arena, none for leaves
+		Node *children;
+		uint32_t childCount;
+	};
+
+	void setOpeningAngle(float openingAngle)
+	{
+		m_openingAngle = openingAngle;
+	}
+	float getOpeningAngle() const
+	{
+		return m_openingAngle;
+	}
+	// largest particle count of a leaf, nodes with more are split
+	void setLeafSize(uint32_t leafSize)
+	{
+		m_leafSize = leafSize > 0 ? leafSize : 1;
+	}
+	uint32_t getLeafSize() const
+	{
+		return m_leafSize;
+	}
+
+	// order[i] is the current slot of the particle that belongs in slot i
+	const std::vector<uint32_t> &sortByMortonKey(CpuThreadPool &threadPool,
+												 const float *x,
+												 const float *y,
+												 uint32_t particleCount);
+	// over the particles reordered as sortByMortonKey returned
+	void build(CpuThreadPool &threadPool, const CpuParticleView &particles, uint32_t particleCount);
+	// overwrites ax and ay, padded like the particle arrays
+	void computeAccelerations(CpuThreadPool &threadPool,
+							  CpuForceKernelFunction kernel,
+							  const CpuParticleView &particles,
+							  uint32_t particleCount,
+							  CpuForceConstants constants,
+							  float *ax,
+							  float *ay);
+
+	// nodes of the last build
+	uint32_t getNodeCount() const;
+
+  private:
+	// per worker thread, reused across steps
+	struct WorkerScratch
+	{
+		CpuBumpArena arena;
+		uint32_t nodeCount = 0;
+		std::vector<const Node *> stack;
+		std::vector<float> listX;
+		std::vector<float> listY;
+		std::vector<float> listMass;
+	};
+
+	void resizeScratch(uint32_t threadCount);
+	bool isLeafRange(const Node &node, uint32_t level) const;
+	// allocates the non-empty quadrants of node, returns false for leaves
+	bool splitNode(Node &node, uint32_t level, WorkerScratch &scratch);
+	void buildSubtree(Node &node, uint32_t level, const CpuParticleView &particles, WorkerScratch &scratch);
+	static void summarizeLeaf(Node &node, const CpuParticleView &particles);
+	static void summarizeChildren(Node &node);
+
+	float m_openingAngle = DEFAULT_OPENING_ANGLE;
+	uint32_t m_leafSize = DEFAULT_LEAF_SIZE;
+
+	std::vector<uint32_t> m_keys;
+	std::vector<uint32_t> m_order;
+	std::vector<uint32_t> m_keyScratch;
+	std::vector<uint32_t> m_orderScratch;
+	std::vector<WorkerScratch> m_scratch;
+	Node *m_root = nullptr;
+	// square the keys quantize
+	float m_rootX = 0.0f;
+	float m_rootY = 0.0f;
+	float m_rootSize = 0.0f;
+};
+} // namespace pgs
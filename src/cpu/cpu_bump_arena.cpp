@@ -0,0 +1,32 @@
+#include "cpu_bump_arena.hpp"
+
+// std
+#include <cassert>
+
+namespace pgs
+{
+
+void *CpuBumpArena::allocateBytes(size_t bytes, size_t alignment)
+{
+	assert(bytes <= BLOCK_BYTES && "Arena allocation larger than a block");
+
+	// new[] storage is aligned for any fundamental type, so aligning offsets is enough
+	size_t offset = (m_offset + alignment - 1) / alignment * alignment;
+	if (m_blocks.empty() || offset + bytes > BLOCK_BYTES)
+	{
+		if (!m_blocks.empty())
+		{
+			m_blockIndex++;
+		}
+		if (m_blockIndex == m_blocks.size())
+		{
+			m_blocks.push_back(std::make_unique<unsigned char[]>(BLOCK_BYTES));
+		}
+		offset = 0;
+	}
+
+	m_offset = offset + bytes;
+	return m_blocks[m_blockIndex].get() + offset;
+}
+
+} // namespace pgs
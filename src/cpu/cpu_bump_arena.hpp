@@ -0,0 +1,49 @@
+#pragma once
+
+// std
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace pgs
+{
+// Bump allocator for objects rebuilt from scratch every step, such as the nodes of
+// CpuBarnesHut. Allocation advances an offset into fixed size blocks, reset() rewinds
+// it and keeps the blocks, so a step allocates no memory once the arena has grown to the
+// largest step so far. Nothing is destroyed, only use it for trivially destructible types.
+// Not thread safe, every thread allocates from its own arena.
+class CpuBumpArena
+{
+  public:
+	static constexpr size_t BLOCK_BYTES = 1 << 20;
+
+	CpuBumpArena() = default;
+	CpuBumpArena(CpuBumpArena &&) = default;
+	CpuBumpArena &operator=(CpuBumpArena &&) = default;
+
+	// uninitialized storage for count objects, at most BLOCK_BYTES in total
+	template <typename T>
+	T *allocate(size_t count)
+	{
+		return static_cast<T *>(allocateBytes(sizeof(T) * count, alignof(T)));
+	}
+
+	void reset()
+	{
+		m_blockIndex = 0;
+		m_offset = 0;
+	}
+
+	size_t getReservedBytes() const
+	{
+		return m_blocks.size() * BLOCK_BYTES;
+	}
+
+  private:
+	void *allocateBytes(size_t bytes, size_t alignment);
+
+	std::vector<std::unique_ptr<unsigned char[]>> m_blocks;
+	size_t m_blockIndex = 0;
+	size_t m_offset = 0;
+};
+} // namespace pgs
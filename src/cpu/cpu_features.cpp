@@ -0,0 +1,95 @@
+#include "cpu_features.hpp"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define PGS_CPUID_MSVC
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#define PGS_CPUID_GNU
+#endif
+
+// std
+#include <cstdint>
+
+namespace pgs
+{
+
+namespace
+{
+
+#if defined(PGS_CPUID_MSVC) || defined(PGS_CPUID_GNU)
+// registers eax, ebx, ecx, edx of cpuid leaf / subleaf, zero for unsupported leaves
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t registers[4])
+{
+#if defined(PGS_CPUID_MSVC)
+	int values[4];
+	__cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+	for (int i = 0; i < 4; i++)
+	{
+		registers[i] = static_cast<uint32_t>(values[i]);
+	}
+#else
+	if (!__get_cpuid_count(leaf, subleaf, &registers[0], &registers[1], &registers[2], &registers[3]))
+	{
+		registers[0] = registers[1] = registers[2] = registers[3] = 0;
+	}
+#endif
+}
+
+// extended control register 0, the register state the operating system saves
+uint64_t xgetbv0()
+{
+#if defined(PGS_CPUID_MSVC)
+	return _xgetbv(0);
+#else
+	uint32_t low;
+	uint32_t high;
+	__asm__ volatile("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return (static_cast<uint64_t>(high) << 32) | low;
+#endif
+}
+#endif
+
+CpuFeatures queryCpuFeatures()
+{
+	CpuFeatures features{false, false, false};
+#if defined(PGS_CPUID_MSVC) || defined(PGS_CPUID_GNU)
+	uint32_t registers[4];
+	cpuid(0, 0, registers);
+	uint32_t maxLeaf = registers[0];
+	if (maxLeaf < 7)
+	{
+		return features;
+	}
+
+	cpuid(1, 0, registers);
+	bool osxsave = registers[2] & (1u << 27);
+	bool fma = registers[2] & (1u << 12);
+	bool avx = registers[2] & (1u << 28);
+	if (!osxsave || !avx)
+	{
+		return features;
+	}
+
+	// SSE and AVX state (bits 1, 2), then opmask and the upper ZMM registers (bits 5 to 7)
+	uint64_t xcr0 = xgetbv0();
+	bool ymmSaved = (xcr0 & 0x6) == 0x6;
+	bool zmmSaved = (xcr0 & 0xE6) == 0xE6;
+
+	cpuid(7, 0, registers);
+	features.fma = ymmSaved && fma;
+	features.avx2 = ymmSaved && (registers[1] & (1u << 5));
+	features.avx512f = zmmSaved && (registers[1] & (1u << 16));
+#endif
+	return features;
+}
+
+} // namespace
+
+const CpuFeatures &hostCpuFeatures()
+{
+	static const CpuFeatures features = queryCpuFeatures();
+	return features;
+}
+
+} // namespace pgs
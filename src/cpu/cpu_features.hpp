@@ -0,0 +1,17 @@
+#pragma once
+
+namespace pgs
+{
+// Instruction set extensions of the host CPU the SIMD force kernels depend on. Each flag
+// also requires the operating system to save the matching register state, so a set flag
+// means the instructions can run, not only that the CPU knows them.
+struct CpuFeatures
+{
+	bool avx2;
+	bool fma;
+	bool avx512f;
+};
+
+// Queried once through cpuid, all false on CPUs other than x86
+const CpuFeatures &hostCpuFeatures();
+} // namespace pgs
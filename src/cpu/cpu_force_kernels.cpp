@@ -0,0 +1,97 @@
+#include "cpu_force_kernels.hpp"
+
+#include "cpu_features.hpp"
+
+// std
+#include <cmath>
+
+namespace pgs
+{
+
+void accumulateAccelerationsScalar(const CpuParticleView &targets,
+								   uint32_t targetBegin,
+								   uint32_t targetEnd,
+								   const CpuParticleView &sources,
+								   uint32_t sourceBegin,
+								   uint32_t sourceEnd,
+								   CpuForceConstants constants,
+								   float *ax,
+								   float *ay)
+{
+	for (uint32_t i = targetBegin; i < targetEnd; i++)
+	{
+		float xi = targets.x[i];
+		float yi = targets.y[i];
+		float sumX = 0.0f;
+		float sumY = 0.0f;
+		for (uint32_t j = sourceBegin; j < sourceEnd; j++)
+		{
+			float dx = sources.x[j] - xi;
+			float dy = sources.y[j] - yi;
+			float invDist = 1.0f / std::sqrt(dx * dx + dy * dy + constants.damp);
+			float scale = sources.mass[j] * invDist * invDist * invDist;
+			sumX += dx * scale;
+			sumY += dy * scale;
+		}
+		ax[i] += sumX * constants.gravConstant;
+		ay[i] += sumY * constants.gravConstant;
+	}
+}
+
+const char *cpuForceKernelName(CpuForceKernel kernel)
+{
+	switch (kernel)
+	{
+	case CpuForceKernel::Scalar:
+		return "scalar";
+	case CpuForceKernel::Avx2:
+		return "avx2";
+	case CpuForceKernel::Avx512:
+		return "avx512";
+	default:
+		return "unknown";
+	}
+}
+
+bool isCpuForceKernelSupported(CpuForceKernel kernel, const CpuFeatures &features)
+{
+	switch (kernel)
+	{
+	case CpuForceKernel::Scalar:
+		return true;
+	case CpuForceKernel::Avx2:
+		return isAvx2KernelCompiled() && features.avx2 && features.fma;
+	case CpuForceKernel::Avx512:
+		return isAvx512KernelCompiled() && features.avx512f;
+	default:
+		return false;
+	}
+}
+
+CpuForceKernelFunction cpuForceKernelFunction(CpuForceKernel kernel)
+{
+	switch (kernel)
+	{
+	case CpuForceKernel::Avx2:
+		return accumulateAccelerationsAvx2;
+	case CpuForceKernel::Avx512:
+		return accumulateAccelerationsAvx512;
+	default:
+		return accumulateAccelerationsScalar;
+	}
+}
+
+CpuForceKernel bestCpuForceKernel(const CpuFeatures &features)
+{
+	if (isCpuForceKernelSupported(CpuForceKernel::Avx512, features))
+	{
+		return CpuForceKernel::Avx512;
+	}
+	if (isCpuForceKernelSupported(CpuForceKernel::Avx2, features))
+	{
+		return CpuForceKernel::Avx2;
+	}
+	return CpuForceKernel::Scalar;
+}
+
+} // namespace pgs
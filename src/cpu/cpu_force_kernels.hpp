@@ -0,0 +1,96 @@
+#pragma once
+
+// Included by the translation units built with AVX2 and AVX-512 code generation, so this
+// header must stay free of inline functions: the linker may keep any copy of one, and an
+// AVX-512 copy would then run on CPUs without it.
+
+// std
+#include <cstdint>
+
+namespace pgs
+{
+struct CpuFeatures;
+
+// Particle state in structure of arrays layout. Target arrays are padded to a multiple of
+// CPU_PARTICLE_ALIGNMENT floats, targets past the live count write padding accelerations
+// only. Sources are read in [sourceBegin, sourceEnd) exactly, their masses weight the sum.
+struct CpuParticleView
+{
+	const float *x;
+	const float *y;
+	const float *mass;
+};
+
+// What particle.comp gets from its specialization constants, see pgs_particles.hpp
+struct CpuForceConstants
+{
+	float gravConstant;
+	float damp;
+};
+
+// widest vector of any kernel, the padding of the particle arrays
+static constexpr uint32_t CPU_PARTICLE_ALIGNMENT = 16;
+
+// Adds the pull of sources [sourceBegin, sourceEnd) on targets [targetBegin, targetEnd)
+// to ax and ay, which are indexed like the targets. targetBegin must be a multiple of
+// CPU_PARTICLE_ALIGNMENT, the vector kernels round targetEnd up to their width. The target
+// masses are never read. Sources may be the targets themselves, or a list gathered from
+// elsewhere such as the interaction list of a tree walk.
+using CpuForceKernelFunction = void (*)(const CpuParticleView &targets,
+										uint32_t targetBegin,
+										uint32_t targetEnd,
+										const CpuParticleView &sources,
+										uint32_t sourceBegin,
+										uint32_t sourceEnd,
+										CpuForceConstants constants,
+										float *ax,
+										float *ay);
+
+enum class CpuForceKernel
+{
+	Scalar,
+	Avx2, // 8 wide, rsqrt with one Newton step, needs AVX2 and FMA
+	Avx512, // 16 wide, rsqrt14 with one Newton step, needs AVX-512F
+	Count
+};
+
+void accumulateAccelerationsScalar(const CpuParticleView &targets,
+								   uint32_t targetBegin,
+								   uint32_t targetEnd,
+								   const CpuParticleView &sources,
+								   uint32_t sourceBegin,
+								   uint32_t sourceEnd,
+								   CpuForceConstants constants,
+								   float *ax,
+								   float *ay);
+void accumulateAccelerationsAvx2(const CpuParticleView &targets,
+								 uint32_t targetBegin,
+								 uint32_t targetEnd,
+								 const CpuParticleView &sources,
+								 uint32_t sourceBegin,
+								 uint32_t sourceEnd,
+								 CpuForceConstants constants,
+								 float *ax,
+								 float *ay);
+void accumulateAccelerationsAvx512(const CpuParticleView &targets,
+								   uint32_t targetBegin,
+								   uint32_t targetEnd,
+								   const CpuParticleView &sources,
+								   uint32_t sourceBegin,
+								   uint32_t sourceEnd,
+								   CpuForceConstants constants,
+								   float *ax,
+								   float *ay);
+
+// false when the compiler could not target the instruction set, the kernel then
+// forwards to the scalar one
+bool isAvx2KernelCompiled();
+bool isAvx512KernelCompiled();
+
+const char *cpuForceKernelName(CpuForceKernel kernel);
+// compiled in and runnable on this CPU
+bool isCpuForceKernelSupported(CpuForceKernel kernel, const CpuFeatures &features);
+CpuForceKernelFunction cpuForceKernelFunction(CpuForceKernel kernel);
+// widest supported kernel
+CpuForceKernel bestCpuForceKernel(const CpuFeatures &features);
+} // namespace pgs
@@ -0,0 +1,169 @@
+// Built with AVX2 and FMA code generation, see CMakeLists.txt. Only reached after
+// isCpuForceKernelSupported checked the CPU, so nothing here may be called otherwise.
+#include "cpu_force_kernels.hpp"
+
+// MSVC has no __FMA__, its /arch:AVX2 implies FMA
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+namespace pgs
+{
+
+namespace
+{
+
+constexpr uint32_t LANES = 8;
+// target vectors kept in registers while the sources stream past. Two vectors and two
+// sources per iteration fit the 16 ymm registers without spilling.
+constexpr uint32_t TARGET_VECTORS = 2;
+constexpr uint32_t SOURCES_PER_ITERATION = 2;
+
+struct Constants
+{
+	__m256 damp;
+	__m256 half;
+	__m256 threeHalves;
+};
+
+// rsqrt is good to 12 bits, one Newton step brings it close to full single precision
+inline __m256 inverseSqrt(__m256 value, const Constants &c)
+{
+	__m256 estimate = _mm256_rsqrt_ps(value);
+	__m256 halfValue = _mm256_mul_ps(c.half, value);
+	__m256 estimateSqr = _mm256_mul_ps(estimate, estimate);
+	return _mm256_mul_ps(estimate, _mm256_fnmadd_ps(halfValue, estimateSqr, c.threeHalves));
+}
+
+inline void accumulatePair(__m256 xj, __m256 yj, __m256 mj, __m256 xi, __m256 yi,
+						   const Constants &c, __m256 &sumX, __m256 &sumY)
+{
+	__m256 dx = _mm256_sub_ps(xj, xi);
+	__m256 dy = _mm256_sub_ps(yj, yi);
+	__m256 distSqr = _mm256_fmadd_ps(dx, dx, _mm256_fmadd_ps(dy, dy, c.damp));
+	__m256 invDist = inverseSqrt(distSqr, c);
+	__m256 scale = _mm256_mul_ps(mj, _mm256_mul_ps(invDist, _mm256_mul_ps(invDist, invDist)));
+	sumX = _mm256_fmadd_ps(dx, scale, sumX);
+	sumY = _mm256_fmadd_ps(dy, scale, sumY);
+}
+
+// VECTORS * LANES targets starting at i against every source
+template <uint32_t VECTORS>
+void accumulateTargetBlock(const CpuParticleView &targets,
+						   uint32_t i,
+						   const CpuParticleView &sources,
+						   uint32_t sourceBegin,
+						   uint32_t sourceEnd,
+						   CpuForceConstants constants,
+						   const Constants &c,
+						   float *ax,
+						   float *ay)
+{
+	__m256 xi[VECTORS];
+	__m256 yi[VECTORS];
+	__m256 sumX[VECTORS];
+	__m256 sumY[VECTORS];
+	for (uint32_t v = 0; v < VECTORS; v++)
+	{
+		xi[v] = _mm256_loadu_ps(targets.x + i + v * LANES);
+		yi[v] = _mm256_loadu_ps(targets.y + i + v * LANES);
+		sumX[v] = _mm256_setzero_ps();
+		sumY[v] = _mm256_setzero_ps();
+	}
+
+	uint32_t j = sourceBegin;
+	uint32_t unrolledEnd = sourceEnd - (sourceEnd - sourceBegin) % SOURCES_PER_ITERATION;
+	for (; j < unrolledEnd; j += SOURCES_PER_ITERATION)
+	{
+		__m256 xj0 = _mm256_broadcast_ss(sources.x + j);
+		__m256 yj0 = _mm256_broadcast_ss(sources.y + j);
+		__m256 mj0 = _mm256_broadcast_ss(sources.mass + j);
+		__m256 xj1 = _mm256_broadcast_ss(sources.x + j + 1);
+		__m256 yj1 = _mm256_broadcast_ss(sources.y + j + 1);
+		__m256 mj1 = _mm256_broadcast_ss(sources.mass + j + 1);
+		for (uint32_t v = 0; v < VECTORS; v++)
+		{
+			accumulatePair(xj0, yj0, mj0, xi[v], yi[v], c, sumX[v], sumY[v]);
+			accumulatePair(xj1, yj1, mj1, xi[v], yi[v], c, sumX[v], sumY[v]);
+		}
+	}
+	for (; j < sourceEnd; j++)
+	{
+		__m256 xj = _mm256_broadcast_ss(sources.x + j);
+		__m256 yj = _mm256_broadcast_ss(sources.y + j);
+		__m256 mj = _mm256_broadcast_ss(sources.mass + j);
+		for (uint32_t v = 0; v < VECTORS; v++)
+		{
+			accumulatePair(xj, yj, mj, xi[v], yi[v], c, sumX[v], sumY[v]);
+		}
+	}
+
+	__m256 gravConstant = _mm256_set1_ps(constants.gravConstant);
+	for (uint32_t v = 0; v < VECTORS; v++)
+	{
+		float *axOut = ax + i + v * LANES;
+		float *ayOut = ay + i + v * LANES;
+		_mm256_storeu_ps(axOut, _mm256_fmadd_ps(sumX[v], gravConstant, _mm256_loadu_ps(axOut)));
+		_mm256_storeu_ps(ayOut, _mm256_fmadd_ps(sumY[v], gravConstant, _mm256_loadu_ps(ayOut)));
+	}
+}
+
+} // namespace
+
+void accumulateAccelerationsAvx2(const CpuParticleView &targets,
+								 uint32_t targetBegin,
+								 uint32_t targetEnd,
+								 const CpuParticleView &sources,
+								 uint32_t sourceBegin,
+								 uint32_t sourceEnd,
+								 CpuForceConstants constants,
+								 float *ax,
+								 float *ay)
+{
+	const Constants c{_mm256_set1_ps(constants.damp), _mm256_set1_ps(0.5f), _mm256_set1_ps(1.5f)};
+
+	uint32_t end = (targetEnd + LANES - 1) / LANES * LANES;
+	uint32_t i = targetBegin;
+	for (; i + TARGET_VECTORS * LANES <= end; i += TARGET_VECTORS * LANES)
+	{
+		accumulateTargetBlock<TARGET_VECTORS>(targets, i, sources, sourceBegin, sourceEnd, constants, c, ax, ay);
+	}
+	for (; i < end; i += LANES)
+	{
+		accumulateTargetBlock<1>(targets, i, sources, sourceBegin, sourceEnd, constants, c, ax, ay);
+	}
+}
+
+bool isAvx2KernelCompiled()
+{
+	return true;
+}
+
+} // namespace pgs
+
+#else
+
+namespace pgs
+{
+
+void accumulateAccelerationsAvx2(const CpuParticleView &targets,
+								 uint32_t targetBegin,
+								 uint32_t targetEnd,
+								 const CpuParticleView &sources,
+								 uint32_t sourceBegin,
+								 uint32_t sourceEnd,
+								 CpuForceConstants constants,
+								 float *ax,
+								 float *ay)
+{
+	accumulateAccelerationsScalar(targets, targetBegin, targetEnd, sources, sourceBegin, sourceEnd,
+								  constants, ax, ay);
+}
+
+bool isAvx2KernelCompiled()
+{
+	return false;
+}
+
+} // namespace pgs
+
+#endif
@@ -0,0 +1,168 @@
+// Built with AVX-512F code generation, see CMakeLists.txt. Only reached after
+// isCpuForceKernelSupported checked the CPU, so nothing here may be called otherwise.
+#include "cpu_force_kernels.hpp"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+namespace pgs
+{
+
+namespace
+{
+
+constexpr uint32_t LANES = 16;
+// target vectors kept in registers while the sources stream past. Four vectors and two
+// sources per iteration leave half of the 32 zmm registers for temporaries.
+constexpr uint32_t TARGET_VECTORS = 4;
+constexpr uint32_t SOURCES_PER_ITERATION = 2;
+
+struct Constants
+{
+	__m512 damp;
+	__m512 half;
+	__m512 threeHalves;
+};
+
+// rsqrt14 is good to 14 bits, one Newton step brings it to full single precision
+inline __m512 inverseSqrt(__m512 value, const Constants &c)
+{
+	__m512 estimate = _mm512_rsqrt14_ps(value);
+	__m512 halfValue = _mm512_mul_ps(c.half, value);
+	__m512 estimateSqr = _mm512_mul_ps(estimate, estimate);
+	return _mm512_mul_ps(estimate, _mm512_fnmadd_ps(halfValue, estimateSqr, c.threeHalves));
+}
+
+inline void accumulatePair(__m512 xj, __m512 yj, __m512 mj, __m512 xi, __m512 yi,
+						   const Constants &c, __m512 &sumX, __m512 &sumY)
+{
+	__m512 dx = _mm512_sub_ps(xj, xi);
+	__m512 dy = _mm512_sub_ps(yj, yi);
+	__m512 distSqr = _mm512_fmadd_ps(dx, dx, _mm512_fmadd_ps(dy, dy, c.damp));
+	__m512 invDist = inverseSqrt(distSqr, c);
+	__m512 scale = _mm512_mul_ps(mj, _mm512_mul_ps(invDist, _mm512_mul_ps(invDist, invDist)));
+	sumX = _mm512_fmadd_ps(dx, scale, sumX);
+	sumY = _mm512_fmadd_ps(dy, scale, sumY);
+}
+
+// VECTORS * LANES targets starting at i against every source
+template <uint32_t VECTORS>
+void accumulateTargetBlock(const CpuParticleView &targets,
+						   uint32_t i,
+						   const CpuParticleView &sources,
+						   uint32_t sourceBegin,
+						   uint32_t sourceEnd,
+						   CpuForceConstants constants,
+						   const Constants &c,
+						   float *ax,
+						   float *ay)
+{
+	__m512 xi[VECTORS];
+	__m512 yi[VECTORS];
+	__m512 sumX[VECTORS];
+	__m512 sumY[VECTORS];
+	for (uint32_t v = 0; v < VECTORS; v++)
+	{
+		xi[v] = _mm512_loadu_ps(targets.x + i + v * LANES);
+		yi[v] = _mm512_loadu_ps(targets.y + i + v * LANES);
+		sumX[v] = _mm512_setzero_ps();
+		sumY[v] = _mm512_setzero_ps();
+	}
+
+	uint32_t j = sourceBegin;
+	uint32_t unrolledEnd = sourceEnd - (sourceEnd - sourceBegin) % SOURCES_PER_ITERATION;
+	for (; j < unrolledEnd; j += SOURCES_PER_ITERATION)
+	{
+		__m512 xj0 = _mm512_set1_ps(sources.x[j]);
+		__m512 yj0 = _mm512_set1_ps(sources.y[j]);
+		__m512 mj0 = _mm512_set1_ps(sources.mass[j]);
+		__m512 xj1 = _mm512_set1_ps(sources.x[j + 1]);
+		__m512 yj1 = _mm512_set1_ps(sources.y[j + 1]);
+		__m512 mj1 = _mm512_set1_ps(sources.mass[j + 1]);
+		for (uint32_t v = 0; v < VECTORS; v++)
+		{
+			accumulatePair(xj0, yj0, mj0, xi[v], yi[v], c, sumX[v], sumY[v]);
+			accumulatePair(xj1, yj1, mj1, xi[v], yi[v], c, sumX[v], sumY[v]);
+		}
+	}
+	for (; j < sourceEnd; j++)
+	{
+		__m512 xj = _mm512_set1_ps(sources.x[j]);
+		__m512 yj = _mm512_set1_ps(sources.y[j]);
+		__m512 mj = _mm512_set1_ps(sources.mass[j]);
+		for (uint32_t v = 0; v < VECTORS; v++)
+		{
+			accumulatePair(xj, yj, mj, xi[v], yi[v], c, sumX[v], sumY[v]);
+		}
+	}
+
+	__m512 gravConstant = _mm512_set1_ps(constants.gravConstant);
+	for (uint32_t v = 0; v < VECTORS; v++)
+	{
+		float *axOut = ax + i + v * LANES;
+		float *ayOut = ay + i + v * LANES;
+		_mm512_storeu_ps(axOut, _mm512_fmadd_ps(sumX[v], gravConstant, _mm512_loadu_ps(axOut)));
+		_mm512_storeu_ps(ayOut, _mm512_fmadd_ps(sumY[v], gravConstant, _mm512_loadu_ps(ayOut)));
+	}
+}
+
+} // namespace
+
+void accumulateAccelerationsAvx512(const CpuParticleView &targets,
+								 uint32_t targetBegin,
+								 uint32_t targetEnd,
+								 const CpuParticleView &sources,
+								 uint32_t sourceBegin,
+								 uint32_t sourceEnd,
+								 CpuForceConstants constants,
+								 float *ax,
+								 float *ay)
+{
+	const Constants c{_mm512_set1_ps(constants.damp), _mm512_set1_ps(0.5f), _mm512_set1_ps(1.5f)};
+
+	uint32_t end = (targetEnd + LANES - 1) / LANES * LANES;
+	uint32_t i = targetBegin;
+	for (; i + TARGET_VECTORS * LANES <= end; i += TARGET_VECTORS * LANES)
+	{
+		accumulateTargetBlock<TARGET_VECTORS>(targets, i, sources, sourceBegin, sourceEnd, constants, c, ax, ay);
+	}
+	for (; i < end; i += LANES)
+	{
+		accumulateTargetBlock<1>(targets, i, sources, sourceBegin, sourceEnd, constants, c, ax, ay);
+	}
+}
+
+bool isAvx512KernelCompiled()
+{
+	return true;
+}
+
+} // namespace pgs
+
+#else
+
+namespace pgs
+{
+
+void accumulateAccelerationsAvx512(const CpuParticleView &targets,
+								 uint32_t targetBegin,
+								 uint32_t targetEnd,
+								 const CpuParticleView &sources,
+								 uint32_t sourceBegin,
+								 uint32_t sourceEnd,
+								 CpuForceConstants constants,
+								 float *ax,
+								 float *ay)
+{
+	accumulateAccelerationsScalar(targets, targetBegin, targetEnd, sources, sourceBegin, sourceEnd,
+								  constants, ax, ay);
+}
+
+bool isAvx512KernelCompiled()
+{
+	return false;
+}
+
+} // namespace pgs
+
+#endif
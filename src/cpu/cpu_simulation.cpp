@@ -0,0 +1,210 @@
+#include "cpu_simulation.hpp"
+
+#include "cpu_features.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <numeric>
+
+namespace pgs
+{
+
+CpuSimulation::CpuSimulation(const std::vector<Particle> &particles,
+							 uint32_t threadCount,
+							 bool pinThreads)
+	: m_forceKernel{bestCpuForceKernel(hostCpuFeatures())},
+	  m_threadPool{std::make_unique<CpuThreadPool>(threadCount, pinThreads)}
+{
+	setParticles(particles);
+}
+
+void CpuSimulation::setParticles(const std::vector<Particle> &particles)
+{
+	m_particleCount = static_cast<uint32_t>(particles.size());
+	size_t paddedCount = (particles.size() + CPU_PARTICLE_ALIGNMENT - 1) / CPU_PARTICLE_ALIGNMENT *
+						 CPU_PARTICLE_ALIGNMENT;
+	// padding particles sit at the origin with zero mass and never move
+	m_x.assign(paddedCount, 0.0f);
+	m_y.assign(paddedCount, 0.0f);
+	m_vx.assign(paddedCount, 0.0f);
+	m_vy.assign(paddedCount, 0.0f);
+	m_mass.assign(paddedCount, 0.0f);
+	m_ax.assign(paddedCount, 0.0f);
+	m_ay.assign(paddedCount, 0.0f);
+	m_ids.resize(particles.size());
+	std::iota(m_ids.begin(), m_ids.end(), 0);
+	for (size_t i = 0; i < particles.size(); i++)
+	{
+		m_x[i] = particles[i].position.x;
+		m_y[i] = particles[i].position.y;
+		m_vx[i] = particles[i].velocity.x;
+		m_vy[i] = particles[i].velocity.y;
+		m_mass[i] = particles[i].mass;
+	}
+}
+
+const char *CpuSimulation::forceSolverName(ForceSolver solver)
+{
+	switch (solver)
+	{
+	case ForceSolver::Direct:
+		return "direct";
+	case ForceSolver::BarnesHut:
+		return "barnes-hut";
+	default:
+		return "unknown";
+	}
+}
+
+void CpuSimulation::setForceKernel(CpuForceKernel kernel)
+{
+	assert(isCpuForceKernelSupported(kernel, hostCpuFeatures()) &&
+		   "CPU force kernel not supported on this machine");
+	m_forceKernel = kernel;
+}
+
+void CpuSimulation::setThreadCount(uint32_t threadCount, bool pinThreads)
+{
+	// the old workers have to exit before the new ones claim their CPUs
+	m_threadPool.reset();
+	m_threadPool = std::make_unique<CpuThreadPool>(threadCount, pinThreads);
+}
+
+void CpuSimulation::computeAccelerations()
+{
+	if (m_forceSolver == ForceSolver::BarnesHut)
+	{
+		computeBarnesHutAccelerations();
+	}
+	else
+	{
+		computeDirectAccelerations();
+	}
+}
+
+void CpuSimulation::computeDirectAccelerations()
+{
+	CpuParticleView view{m_x.data(), m_y.data(), m_mass.data()};
+	CpuForceConstants constants{GRAV_CONSTANT, DAMP};
+	CpuForceKernelFunction kernel = cpuForceKernelFunction(m_forceKernel);
+
+	// every task owns its targets' accelerations, so tasks never write the same slot
+	uint32_t tileCount = (m_particleCount + TARGET_TILE - 1) / TARGET_TILE;
+	m_threadPool->parallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+		uint32_t targetBegin = tile * TARGET_TILE;
+		uint32_t targetEnd = std::min(targetBegin + TARGET_TILE, m_particleCount);
+		// the vector kernels also add into the padding past the last target
+		size_t clearEnd = std::min<size_t>(targetBegin + TARGET_TILE, m_ax.size());
+		std::fill(m_ax.begin() + targetBegin, m_ax.begin() + clearEnd, 0.0f);
+		std::fill(m_ay.begin() + targetBegin, m_ay.begin() + clearEnd, 0.0f);
+		for (uint32_t sourceBegin = 0; sourceBegin < m_particleCount; sourceBegin += SOURCE_TILE)
+		{
+			uint32_t sourceEnd = std::min(sourceBegin + SOURCE_TILE, m_particleCount);
+			kernel(view, targetBegin, targetEnd, view, sourceBegin, sourceEnd, constants, m_ax.data(), m_ay.data());
+		}
+	});
+}
+
+void CpuSimulation::computeBarnesHutAccelerations()
+{
+	const std::vector<uint32_t> &order =
+		m_barnesHut.sortByMortonKey(*m_threadPool, m_x.data(), m_y.data(), m_particleCount);
+	reorder(order);
+
+	CpuParticleView view{m_x.data(), m_y.data(), m_mass.data()};
+	CpuForceConstants constants{GRAV_CONSTANT, DAMP};
+	m_barnesHut.build(*m_threadPool, view, m_particleCount);
+	m_barnesHut.computeAccelerations(*m_threadPool,
+									 cpuForceKernelFunction(m_forceKernel),
+									 view,
+									 m_particleCount,
+									 constants,
+									 m_ax.data(),
+									 m_ay.data());
+}
+
+void CpuSimulation::reorder(const std::vector<uint32_t> &order)
+{
+	m_reorderScratch.resize(m_x.size());
+	m_idScratch.resize(m_ids.size());
+
+	// the padding past the live count keeps its place
+	uint32_t tileCount = (m_particleCount + INTEGRATE_TILE - 1) / INTEGRATE_TILE;
+	for (std::vector<float> *values : {&m_x, &m_y, &m_vx, &m_vy, &m_mass})
+	{
+		std::copy(values->begin() + m_particleCount, values->end(),
+				  m_reorderScratch.begin() + m_particleCount);
+		m_threadPool->parallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+			uint32_t begin = tile * INTEGRATE_TILE;
+			uint32_t end = std::min(begin + INTEGRATE_TILE, m_particleCount);
+			for (uint32_t i = begin; i < end; i++)
+			{
+				m_reorderScratch[i] = (*values)[order[i]];
+			}
+		});
+		values->swap(m_reorderScratch);
+	}
+	for (uint32_t i = 0; i < m_particleCount; i++)
+	{
+		m_idScratch[i] = m_ids[order[i]];
+	}
+	m_ids.swap(m_idScratch);
+}
+
+void CpuSimulation::step(float frameTime)
+{
+	computeAccelerations();
+
+	// same order as integrateParticle in step_common.glsl. Runs once every force is
+	// summed, the force tasks read every position.
+	uint32_t tileCount = (m_particleCount + INTEGRATE_TILE - 1) / INTEGRATE_TILE;
+	m_threadPool->parallelFor(tileCount, [&](uint32_t tile, uint32_t) {
+		uint32_t begin = tile * INTEGRATE_TILE;
+		uint32_t end = std::min(begin + INTEGRATE_TILE, m_particleCount);
+		for (uint32_t i = begin; i < end; i++)
+		{
+			m_vx[i] += m_ax[i] * frameTime;
+			m_vy[i] += m_ay[i] * frameTime;
+			m_x[i] += m_vx[i] * frameTime;
+			m_y[i] += m_vy[i] * frameTime;
+		}
+	});
+}
+
+std::vector<Particle> CpuSimulation::getParticles() const
+{
+	std::vector<Particle> particles(m_particleCount);
+	for (uint32_t i = 0; i < m_particleCount; i++)
+	{
+		Particle &particle = particles[m_ids[i]];
+		particle.position = glm::vec2(m_x[i], m_y[i]);
+		particle.velocity = glm::vec2(m_vx[i], m_vy[i]);
+		particle.mass = m_mass[i];
+	}
+	return particles;
+}
+
+void CpuSimulation::writeState(glm::vec2 *positions, glm::vec2 *velocities, float *colorValues) const
+{
+	for (uint32_t i = 0; i < m_particleCount; i++)
+	{
+		uint32_t id = m_ids[i];
+		positions[id] = glm::vec2(m_x[i], m_y[i]);
+		velocities[id] = glm::vec2(m_vx[i], m_vy[i]);
+		colorValues[id] = std::sqrt(m_ax[i] * m_ax[i] + m_ay[i] * m_ay[i]);
+	}
+}
+
+std::vector<glm::vec2> CpuSimulation::getAccelerations() const
+{
+	std::vector<glm::vec2> accelerations(m_particleCount);
+	for (uint32_t i = 0; i < m_particleCount; i++)
+	{
+		accelerations[m_ids[i]] = glm::vec2(m_ax[i], m_ay[i]);
+	}
+	return accelerations;
+}
+
+} // namespace pgs
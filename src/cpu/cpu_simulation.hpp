@@ -0,0 +1,126 @@
+#pragma once
+
+#include "cpu_barnes_hut.hpp"
+#include "cpu_force_kernels.hpp"
+#include "cpu_thread_pool.hpp"
+#include "pgs_particles.hpp"
+
+// std
+#include <memory>
+#include <vector>
+
+namespace pgs
+{
+// Headless simulation on the host with the physics of particle.comp: the softened,
+// mass-weighted pull of every particle followed by a semi-implicit Euler step. Starts
+// from the same Particle initial conditions as the GPU, so its states can be
+// compared against it.
+//
+// Both passes run on a CpuThreadPool. The direct solver splits the force pass into tiles
+// of TARGET_TILE targets, one task each, and every task sums the sources in tiles of
+// SOURCE_TILE so the source positions stay in the core's caches while all target vectors
+// of the tile pass over them. The Barnes-Hut solver (CpuBarnesHut) reorders the particles
+// along a Morton curve every step, getParticleIds() follows them.
+class CpuSimulation
+{
+  public:
+	enum class ForceSolver
+	{
+		Direct, // all pairs, O(N^2)
+		BarnesHut, // quadtree, O(N log N)
+		Count
+	};
+	static const char *forceSolverName(ForceSolver solver);
+
+	// multiples of CPU_PARTICLE_ALIGNMENT. 256 targets give every core a few dozen tasks
+	// to balance at 16k particles, 2048 sources (24 KiB) fit L1 on current cores.
+	static constexpr uint32_t TARGET_TILE = 256;
+	static constexpr uint32_t SOURCE_TILE = 2048;
+	// particles per task of the integration pass
+	static constexpr uint32_t INTEGRATE_TILE = 4096;
+
+	// 0 threads uses every hardware thread, see CpuThreadPool
+	explicit CpuSimulation(const std::vector<Particle> &particles,
+						   uint32_t threadCount = 0,
+						   bool pinThreads = true);
+
+	CpuSimulation(const CpuSimulation &) = delete;
+	CpuSimulation &operator=(const CpuSimulation &) = delete;
+
+	// picked from the host CPU's features at construction, must be supported
+	void setForceKernel(CpuForceKernel kernel);
+	CpuForceKernel getForceKernel() const
+	{
+		return m_forceKernel;
+	}
+
+	void setForceSolver(ForceSolver solver)
+	{
+		m_forceSolver = solver;
+	}
+	ForceSolver getForceSolver() const
+	{
+		return m_forceSolver;
+	}
+	// opening angle and leaf size of the Barnes-Hut solver
+	CpuBarnesHut &getBarnesHut()
+	{
+		return m_barnesHut;
+	}
+
+	// replaces the thread pool, 0 uses every hardware thread
+	void setThreadCount(uint32_t threadCount, bool pinThreads = true);
+	uint32_t getThreadCount() const
+	{
+		return m_threadPool->getThreadCount();
+	}
+
+	// overwrites the accelerations with the force solver's sum over the current positions
+	void computeAccelerations();
+	void step(float frameTime);
+
+	uint32_t getParticleCount() const
+	{
+		return m_particleCount;
+	}
+	// current state in the order it was created in, whatever the slot order
+	std::vector<Particle> getParticles() const;
+	// accelerations of the last computeAccelerations, in the same order as getParticles
+	std::vector<glm::vec2> getAccelerations() const;
+	// replaces the state, the particle ids restart in the given order
+	void setParticles(const std::vector<Particle> &particles);
+	// the fields of PgsModel::StateBuffers in creation order, getParticleCount() each;
+	// the color values are the last step's acceleration magnitudes like integrate.comp
+	void writeState(glm::vec2 *positions, glm::vec2 *velocities, float *colorValues) const;
+	// original index of the particle in every slot
+	const std::vector<uint32_t> &getParticleIds() const
+	{
+		return m_ids;
+	}
+
+  private:
+	void computeDirectAccelerations();
+	void computeBarnesHutAccelerations();
+	// slot i receives the particle in slot order[i]
+	void reorder(const std::vector<uint32_t> &order);
+
+	uint32_t m_particleCount;
+	CpuForceKernel m_forceKernel;
+	ForceSolver m_forceSolver = ForceSolver::Direct;
+	CpuBarnesHut m_barnesHut;
+	std::unique_ptr<CpuThreadPool> m_threadPool;
+
+	// padded to CPU_PARTICLE_ALIGNMENT, see CpuParticleView
+	std::vector<float> m_x;
+	std::vector<float> m_y;
+	std::vector<float> m_vx;
+	std::vector<float> m_vy;
+	std::vector<float> m_mass;
+	std::vector<float> m_ax;
+	std::vector<float> m_ay;
+	std::vector<uint32_t> m_ids;
+	// reorder targets, swapped with the arrays they were filled for
+	std::vector<float> m_reorderScratch;
+	std::vector<uint32_t> m_idScratch;
+};
+} // namespace pgs
@@ -0,0 +1,242 @@
+#include "cpu_thread_pool.hpp"
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// std
+#include <algorithm>
+#include <iostream>
+
+namespace pgs
+{
+
+namespace
+{
+
+// Logical CPUs this process may run on, in ascending order. Affinity masks set by
+// taskset, cgroups, containers or job objects leave out the rest, so CPU i is not
+// necessarily allowed. Other platforms report every hardware thread.
+std::vector<uint32_t> allowedCpus()
+{
+	std::vector<uint32_t> cpus;
+#if defined(_WIN32)
+	// the process' own processor group, at most 64 CPUs
+	DWORD_PTR processMask = 0;
+	DWORD_PTR systemMask = 0;
+	if (GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+	{
+		for (uint32_t cpu = 0; cpu < 64; cpu++)
+		{
+			if (processMask & (DWORD_PTR(1) << cpu))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#elif defined(__linux__)
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0)
+	{
+		for (uint32_t cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &mask))
+			{
+				cpus.push_back(cpu);
+			}
+		}
+	}
+#endif
+	if (cpus.empty())
+	{
+		for (uint32_t cpu = 0; cpu < std::max(std::thread::hardware_concurrency(), 1u); cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+// false if the thread could not be bound, other platforms never pin
+bool pinThread(std::thread &thread, uint32_t cpu)
+{
+#if defined(_WIN32)
+	if (cpu >= 64)
+	{
+		return false;
+	}
+	return SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << cpu) != 0;
+#elif defined(__linux__)
+	if (cpu >= CPU_SETSIZE)
+	{
+		return false;
+	}
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	CPU_SET(cpu, &cpus);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+#else
+	(void)thread;
+	(void)cpu;
+	return false;
+#endif
+}
+
+} // namespace
+
+CpuThreadPool::CpuThreadPool(uint32_t threadCount, bool pinThreads)
+{
+	std::vector<uint32_t> cpus = allowedCpus();
+	if (threadCount == 0)
+	{
+		threadCount = static_cast<uint32_t>(cpus.size());
+	}
+	// more threads than CPUs would stack several on one, let the scheduler spread them
+	m_pinned = pinThreads && threadCount <= cpus.size();
+
+	for (uint32_t i = 0; i < threadCount; i++)
+	{
+		m_queues.push_back(std::make_unique<TaskQueue>());
+	}
+	for (uint32_t worker = 1; worker < threadCount; worker++)
+	{
+		m_threads.emplace_back(&CpuThreadPool::workerLoop, this, worker);
+		if (m_pinned && !pinThread(m_threads.back(), cpus[worker]))
+		{
+			std::cerr << "CpuThreadPool: could not pin worker " << worker << " to cpu "
+					  << cpus[worker] << ", running unpinned" << std::endl;
+			m_pinned = false;
+		}
+	}
+}
+
+CpuThreadPool::~CpuThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto &thread : m_threads)
+	{
+		thread.join();
+	}
+}
+
+uint32_t CpuThreadPool::hardwareThreadCount()
+{
+	return static_cast<uint32_t>(allowedCpus().size());
+}
+
+void CpuThreadPool::parallelFor(uint32_t taskCount, const Task &task)
+{
+	uint32_t threadCount = getThreadCount();
+	if (threadCount == 1 || taskCount <= 1)
+	{
+		for (uint32_t i = 0; i < taskCount; i++)
+		{
+			task(i, 0);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock{m_mutex};
+		for (uint32_t worker = 0; worker < threadCount; worker++)
+		{
+			uint32_t begin = static_cast<uint32_t>(uint64_t(taskCount) * worker / threadCount);
+			uint32_t end = static_cast<uint32_t>(uint64_t(taskCount) * (worker + 1) / threadCount);
+			std::lock_guard<std::mutex> queueLock{m_queues[worker]->mutex};
+			for (uint32_t i = begin; i < end; i++)
+			{
+				m_queues[worker]->tasks.push_back(i);
+			}
+		}
+		m_task = &task;
+		m_generation++;
+		m_running = true;
+	}
+	m_wake.notify_all();
+
+	drain(0, task);
+
+	// workers that joined may still be running a stolen task, and none may join once
+	// m_running is cleared, so task outlives every use of it
+	std::unique_lock<std::mutex> lock{m_mutex};
+	m_done.wait(lock, [this] { return m_activeWorkers == 0; });
+	m_running = false;
+	m_task = nullptr;
+}
+
+void CpuThreadPool::workerLoop(uint32_t worker)
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		const Task *task;
+		{
+			std::unique_lock<std::mutex> lock{m_mutex};
+			m_wake.wait(lock, [&] { return m_stop || (m_running && m_generation != seenGeneration); });
+			if (m_stop)
+			{
+				return;
+			}
+			seenGeneration = m_generation;
+			task = m_task;
+			m_activeWorkers++;
+		}
+
+		drain(worker, *task);
+
+		{
+			std::lock_guard<std::mutex> lock{m_mutex};
+			m_activeWorkers--;
+		}
+		m_done.notify_all();
+	}
+}
+
+void CpuThreadPool::drain(uint32_t worker, const Task &task)
+{
+	uint32_t index;
+	while (popTask(worker, index))
+	{
+		task(index, worker);
+	}
+}
+
+bool CpuThreadPool::popTask(uint32_t worker, uint32_t &task)
+{
+	{
+		TaskQueue &own = *m_queues[worker];
+		std::lock_guard<std::mutex> lock{own.mutex};
+		if (!own.tasks.empty())
+		{
+			task = own.tasks.front();
+			own.tasks.pop_front();
+			return true;
+		}
+	}
+
+	// steal from the far end of the next busy queue, away from where its owner works
+	uint32_t threadCount = getThreadCount();
+	for (uint32_t offset = 1; offset < threadCount; offset++)
+	{
+		TaskQueue &victim = *m_queues[(worker + offset) % threadCount];
+		std::lock_guard<std::mutex> lock{victim.mutex};
+		if (!victim.tasks.empty())
+		{
+			task = victim.tasks.back();
+			victim.tasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+} // namespace pgs
@@ -0,0 +1,78 @@
+#pragma once
+
+// std
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pgs
+{
+// Fixed set of worker threads running parallelFor jobs with work stealing. Every worker
+// starts on its own contiguous block of the tasks, taking them front to back, and steals
+// from the back of another worker's block once its own runs dry, so uneven tasks still
+// end at about the same time. The calling thread works as worker 0.
+class CpuThreadPool
+{
+  public:
+	// task index and the worker running it, < getThreadCount()
+	using Task = std::function<void(uint32_t task, uint32_t worker)>;
+
+	// 0 threads uses every CPU the process may run on. Pinned workers are bound to one
+	// of those CPUs each (worker i to the i-th allowed CPU, the caller is left alone), so
+	// their tiles stay in the caches they warmed. If a worker cannot be bound, a warning
+	// is printed and the rest run unpinned.
+	explicit CpuThreadPool(uint32_t threadCount = 0, bool pinThreads = true);
+	~CpuThreadPool();
+
+	CpuThreadPool(const CpuThreadPool &) = delete;
+	CpuThreadPool &operator=(const CpuThreadPool &) = delete;
+
+	uint32_t getThreadCount() const
+	{
+		return static_cast<uint32_t>(m_queues.size());
+	}
+
+	// runs task(i, worker) for every i in [0, taskCount) and returns once all finished
+	void parallelFor(uint32_t taskCount, const Task &task);
+
+	// false if pinning was off, there were more threads than CPUs, or binding failed
+	bool isPinned() const
+	{
+		return m_pinned;
+	}
+
+	// logical CPUs in the process' affinity mask, not every CPU of the machine
+	static uint32_t hardwareThreadCount();
+
+  private:
+	struct TaskQueue
+	{
+		std::mutex mutex;
+		std::deque<uint32_t> tasks;
+	};
+
+	void workerLoop(uint32_t worker);
+	// runs tasks until every queue is empty
+	void drain(uint32_t worker, const Task &task);
+	bool popTask(uint32_t worker, uint32_t &task);
+
+	std::vector<std::unique_ptr<TaskQueue>> m_queues;
+	std::vector<std::thread> m_threads;
+	bool m_pinned = false;
+
+	// guards the job state below
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	const Task *m_task = nullptr;
+	uint64_t m_generation = 0;
+	bool m_running = false;
+	uint32_t m_activeWorkers = 0;
+	bool m_stop = false;
+};
+} // namespace pgs
@@ -1,7 +1,12 @@
 #include "gravSimApp.hpp"
 
+#include "backends/compute_backend.hpp"
+#include "backends/cpu_backend.hpp"
+#include "backends/cpu_state_upload.hpp"
+#include "cpu/cpu_simulation.hpp"
 #include "pgs_buffer.hpp"
-#include "systems/particle_system.hpp"
+#include "pgs_gpu_timer.hpp"
+#include "pgs_kernel_tuner.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -10,28 +15,28 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
 #include <stdexcept>
+#include <string>
 
 namespace pgs
 {
 
-struct GlobalUbo
-{
-	alignas(16) float frameTime;
-	uint32_t particleCount;
-};
-
 GravSimApp::GravSimApp()
 {
 	globalPool =
 		PgsDescriptorPool::Builder(m_pgsDevice)
-			.setMaxSets(PgsSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, PgsSwapChain::MAX_FRAMES_IN_FLIGHT)
-			.addPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, PgsSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.setMaxSets(GLOBAL_SET_COUNT + PgsModel::STATE_BUFFER_COUNT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+						 GLOBAL_SET_STORAGE_BUFFERS * GLOBAL_SET_COUNT +
+							 3 * PgsModel::STATE_BUFFER_COUNT)
 			.build();
 }
 
@@ -41,41 +46,229 @@ GravSimApp::~GravSimApp()
 
 void GravSimApp::run()
 {
-	std::vector<std::unique_ptr<PgsBuffer>> uboBuffers(PgsSwapChain::MAX_FRAMES_IN_FLIGHT);
-	for (int i = 0; i < uboBuffers.size(); i++)
-	{
-		uboBuffers[i] = std::make_unique<PgsBuffer>(m_pgsDevice,
-													sizeof(GlobalUbo),
-													1,
-													VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-													VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-		uboBuffers[i]->map();
-	}
-
+	// per-step values (frame time, particle count) are push constants, see ParticleSystem
 	auto globalSetLayout =
 		PgsDescriptorSetLayout::Builder(m_pgsDevice)
 			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
-			.addBinding(1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
 			.build();
 
+	uint32_t maxCount = ParticleSystem::maxParticleCount(m_pgsDevice, FORCE_SOLVER, INTEGRATOR);
+	if (PARTICLE_COUNT > maxCount)
+	{
+		throw std::length_error(std::to_string(PARTICLE_COUNT) + " particles exceed the " +
+								std::to_string(maxCount) + " the device can bind for the " +
+								ParticleSystem::forceSolverName(FORCE_SOLVER) + " solver and the " +
+								ParticleSystem::integratorName(INTEGRATOR) + " integrator");
+	}
+
+	// the restricted solver needs massive bodies, the others start from equal masses
+	std::shared_ptr<PgsModel> pgsModel =
+		FORCE_SOLVER == ParticleSystem::ForceSolver::Restricted
+			? PgsModel::createRestrictedModel(m_pgsDevice, PARTICLE_COUNT)
+			: PgsModel::createModel(m_pgsDevice, PARTICLE_COUNT);
+
+	// written by solvers that run as a separate pass before integration
+	PgsBuffer accelerationBuffer{m_pgsDevice,
+								 sizeof(glm::vec2),
+								 pgsModel->getParticleCount(),
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+									 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+								 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+	// written next to the accelerations when the Hermite integrator evaluates forces
+	PgsBuffer jerkBuffer{m_pgsDevice,
+						 sizeof(glm::vec2),
+						 pgsModel->getParticleCount(),
+						 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+						 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+	// block timestep active particles and the dispatch arguments over them
+	PgsBuffer activeListBuffer{m_pgsDevice,
+							   sizeof(uint32_t),
+							   BlockTimestepSystem::ACTIVE_LIST_HEADER_WORDS +
+								   pgsModel->getParticleCount(),
+							   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+								   VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+								   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+
 	ParticleSystem particleSystem{m_pgsDevice,
 								  m_pgsRenderer.getSwapChainRenderPass(),
-								  globalSetLayout->getDescriptorSetLayout()};
+								  globalSetLayout->getDescriptorSetLayout(),
+								  pgsModel->getParticleCount()};
+	// grid parameters first, so the mesh solvers are created once with them
+	particleSystem.setParticleMeshGridSize(PARTICLE_MESH_GRID_SIZE);
+	particleSystem.setP3MParameters(P3M_GRID_SIZE, P3M_SPLIT_RADIUS);
+	particleSystem.setForceKernel(FORCE_KERNEL);
+	particleSystem.setForceSolver(FORCE_SOLVER);
+	particleSystem.bindModel(*pgsModel, accelerationBuffer, jerkBuffer, activeListBuffer);
+	if (INTEGRATOR == ParticleSystem::Integrator::BlockTimesteps)
+	{
+		particleSystem.getBlockTimestepSystem().setParameters(BLOCK_TIMESTEP_MAX_LEVEL,
+															  BLOCK_TIMESTEP_ACCURACY);
+	}
+	particleSystem.setIntegrator(INTEGRATOR);
+	particleSystem.setSpatialSortInterval(SPATIAL_SORT_INTERVAL);
+	particleSystem.setMergeParameters(MERGE_RADIUS, MERGE_INTERVAL);
+	if (FORCE_SOLVER == ParticleSystem::ForceSolver::BarnesHut || REPORT_BARNES_HUT_ACCURACY)
+	{
+		particleSystem.getBarnesHutSystem().setOpeningAngle(BARNES_HUT_OPENING_ANGLE);
+	}
+	particleSystem.setColormap(COLORMAP);
+	particleSystem.setColorSource(COLOR_SOURCE);
+	particleSystem.setColorScale(COLOR_SCALE);
 
-	std::shared_ptr<PgsModel> pgsModel = PgsModel::createModel(m_pgsDevice);
+	if (BENCHMARK_FORCE_KERNELS)
+	{
+		benchmarkForceKernels(particleSystem, *globalSetLayout);
+	}
+	if (COMPARE_CPU_BACKEND)
+	{
+		compareCpuBackend(particleSystem, *globalSetLayout);
+	}
 
-	std::vector<VkDescriptorSet> globalDescriptorSets(PgsSwapChain::MAX_FRAMES_IN_FLIGHT);
-	for (int i = 0; i < globalDescriptorSets.size(); i++)
+	// one set per state buffer, reading that state buffer and writing the other. Nothing in
+	// the sets changes per frame, so frames in flight share them.
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> globalDescriptorSets;
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
 	{
-		auto bufferInfo = uboBuffers[i]->descriptorInfo();
-		auto storageInfo = pgsModel->getVertexBuffer()->descriptorInfo();
+		auto &stateIn = pgsModel->getState(state);
+		auto &stateOut = pgsModel->getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = stateIn.positions->descriptorInfo();
+		auto positionOutInfo = stateOut.positions->descriptorInfo();
+		auto velocityInfo = stateIn.velocities->descriptorInfo();
+		auto velocityOutInfo = stateOut.velocities->descriptorInfo();
+		auto colorValueOutInfo = stateOut.colorValues->descriptorInfo();
+		auto accelerationInfo = accelerationBuffer.descriptorInfo();
+		auto jerkInfo = jerkBuffer.descriptorInfo();
+		auto activeListInfo = activeListBuffer.descriptorInfo();
+		auto countInfo = pgsModel->getCountBuffer().descriptorInfo();
+		auto massInfo = pgsModel->getMassBuffer().descriptorInfo();
 		auto result = PgsDescriptorWriter(*globalSetLayout, *globalPool)
-						  .writeBuffer(0, &storageInfo)
-						  .writeBuffer(1, &bufferInfo)
-						  .build(globalDescriptorSets[i]);
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(2, &accelerationInfo)
+						  .writeBuffer(3, &positionOutInfo)
+						  .writeBuffer(4, &velocityInfo)
+						  .writeBuffer(5, &velocityOutInfo)
+						  .writeBuffer(6, &colorValueOutInfo)
+						  .writeBuffer(7, &jerkInfo)
+						  .writeBuffer(8, &activeListInfo)
+						  .writeBuffer(9, &countInfo)
+						  .writeBuffer(10, &massInfo)
+						  .build(globalDescriptorSets[state]);
+		assert(result && "Failed to build descriptor writer!");
+	}
+
+	// one set per state buffer for the vertex shader
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> renderDescriptorSets;
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto positionInfo = pgsModel->getState(state).positions->descriptorInfo();
+		auto velocityInfo = pgsModel->getState(state).velocities->descriptorInfo();
+		auto colorValueInfo = pgsModel->getState(state).colorValues->descriptorInfo();
+		auto result = PgsDescriptorWriter(particleSystem.getRenderSetLayout(), *globalPool)
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(1, &velocityInfo)
+						  .writeBuffer(2, &colorValueInfo)
+						  .build(renderDescriptorSets[state]);
 		assert(result && "Failed to build descriptor writer!");
 	}
 
+	if (AUTOTUNE_FORCE_KERNEL)
+	{
+		PgsKernelTuner tuner{m_pgsDevice, KERNEL_TUNING_CACHE_PATH};
+		auto config = tuner.tune(particleSystem,
+								 globalDescriptorSets[pgsModel->getStateIndex()],
+								 pgsModel->getParticleCount(),
+								 RETUNE_FORCE_KERNEL);
+		particleSystem.setForceKernel(config.kernel);
+		std::cout << "force kernel: " << ParticleSystem::forceKernelName(config.kernel)
+				  << ", local size " << config.localSizeX << ", unroll " << config.unroll << " ("
+				  << config.millisecondsPerStep << " ms/step)" << std::endl;
+	}
+
+	if (FORCE_CHUNK_BUDGET_MS > 0.0)
+	{
+		PgsKernelTuner tuner{m_pgsDevice, KERNEL_TUNING_CACHE_PATH};
+		uint32_t chunkSize = tuner.chooseForceChunkSize(particleSystem,
+														globalDescriptorSets[pgsModel->getStateIndex()],
+														pgsModel->getParticleCount(),
+														FORCE_CHUNK_BUDGET_MS);
+		particleSystem.setForceChunkSize(chunkSize);
+		if (chunkSize == 0)
+		{
+			std::cout << "force chunks: a whole step fits " << FORCE_CHUNK_BUDGET_MS << " ms" << std::endl;
+		}
+		else
+		{
+			std::cout << "force chunks: " << chunkSize << " sources per dispatch for "
+					  << FORCE_CHUNK_BUDGET_MS << " ms" << std::endl;
+		}
+	}
+
+	if (REPORT_BARNES_HUT_ACCURACY)
+	{
+		auto report = particleSystem.getBarnesHutSystem().measureAccuracy(
+			globalDescriptorSets[pgsModel->getStateIndex()],
+			*pgsModel->getCurrentState().positions,
+			pgsModel->getMassBuffer(),
+			accelerationBuffer,
+			pgsModel->getParticleCount(),
+			1024);
+		std::cout << "barnes-hut accuracy (opening angle "
+				  << particleSystem.getBarnesHutSystem().getOpeningAngle() << ", "
+				  << report.sampleCount << " samples): rms relative error "
+				  << report.rmsRelativeError << ", max relative error "
+				  << report.maxRelativeError << std::endl;
+	}
+
+	std::unique_ptr<SimulationBackend> backend;
+	// records the stepped state into the frame, the compute backend is its own presenter
+	std::unique_ptr<CpuStateUpload> cpuStateUpload;
+	SimulationPresenter *presenter = nullptr;
+	if (SIMULATION_BACKEND == SimulationBackend::Type::Cpu)
+	{
+		vkDeviceWaitIdle(m_pgsDevice.device());
+		auto cpuBackend =
+			std::make_unique<CpuBackend>(pgsModel->readParticles(), CPU_BACKEND_THREAD_COUNT);
+		cpuBackend->getSimulation().setForceSolver(CPU_BACKEND_SOLVER);
+		cpuBackend->getSimulation().getBarnesHut().setOpeningAngle(BARNES_HUT_OPENING_ANGLE);
+		cpuStateUpload = std::make_unique<CpuStateUpload>(m_pgsDevice, *pgsModel, *cpuBackend);
+		presenter = cpuStateUpload.get();
+		backend = std::move(cpuBackend);
+	}
+	else
+	{
+		auto computeBackend = std::make_unique<ComputeBackend>(m_pgsDevice,
+															   particleSystem,
+															   *pgsModel,
+															   globalDescriptorSets);
+		presenter = computeBackend.get();
+		backend = std::move(computeBackend);
+	}
+	std::cout << "simulation backend: " << SimulationBackend::typeName(backend->getType())
+			  << std::endl;
+
+	AdaptiveTimestepSystem adaptiveTimestep{m_pgsDevice, PgsSwapChain::MAX_FRAMES_IN_FLIGHT};
+	adaptiveTimestep.bindState(*pgsModel);
+	adaptiveTimestep.setParameters(ADAPTIVE_TIMESTEP_ACCURACY,
+								   ADAPTIVE_MIN_DT * TIME_SCALE,
+								   ADAPTIVE_MAX_DT * TIME_SCALE);
+	// the reduction reads the velocities and color values, which the CPU backend uploads
+	bool adaptive = ADAPTIVE_TIMESTEP && (backend->getType() == SimulationBackend::Type::Cpu ||
+										  INTEGRATOR != ParticleSystem::Integrator::BlockTimesteps);
+
+	// wall clock time not yet simulated, consumed in steps of stepTime
+	float accumulator = 0.0f;
+	SimulationStats stats{};
+
 	auto currentTime = std::chrono::high_resolution_clock::now();
 	while (!m_pgsWindow.shouldClose())
 	{
@@ -91,29 +284,366 @@ void GravSimApp::run()
 		if (auto commandBuffer = m_pgsRenderer.beginFrame())
 		{
 			int frameIndex = m_pgsRenderer.getFrameIndex();
+
+			// this frame's fence was waited on, so its slot holds the reduction of the
+			// state it ended with MAX_FRAMES_IN_FLIGHT frames ago
+			float stepTime = SIMULATION_DT;
+			if (adaptive)
+			{
+				stepTime = adaptiveTimestep.readTimestep(frameIndex, SIMULATION_DT * TIME_SCALE) /
+						   TIME_SCALE;
+			}
+
 			FrameInfo frameInfo{frameIndex,
-								frameTime,
+								stepTime * TIME_SCALE,
 								commandBuffer,
 								pgsModel,
-								globalDescriptorSets[frameIndex]};
+								globalDescriptorSets[pgsModel->getStateIndex()],
+								VK_NULL_HANDLE};
 
-			// update
-			GlobalUbo ubo{};
-			ubo.frameTime = frameTime;
-			ubo.particleCount = PgsModel::PARTICLE_COUNT;
-			uboBuffers[frameIndex]->writeToBuffer(&ubo);
-			uboBuffers[frameIndex]->flush();
+			accumulator += frameTime;
+			auto substeps = static_cast<uint32_t>(accumulator / stepTime);
+			if (substeps > MAX_SUBSTEPS_PER_FRAME)
+			{
+				stats.droppedTime += accumulator - MAX_SUBSTEPS_PER_FRAME * stepTime;
+				substeps = MAX_SUBSTEPS_PER_FRAME;
+				accumulator = 0.0f;
+			}
+			else
+			{
+				accumulator -= substeps * stepTime;
+			}
 
-			// render
-			particleSystem.computeParticles(frameInfo);
+			// simulate and render
+			backend->step(frameInfo.frameTime, substeps);
+			presenter->present(frameInfo);
+			if (adaptive)
+			{
+				adaptiveTimestep.recordReduction(commandBuffer,
+												 frameIndex,
+												 pgsModel->getStateIndex(),
+												 pgsModel->getParticleCount());
+			}
+			frameInfo.renderDescriptorSet = renderDescriptorSets[pgsModel->getStateIndex()];
 			m_pgsRenderer.beginSwapChainRenderPass(commandBuffer);
 			particleSystem.renderParticles(frameInfo);
 			m_pgsRenderer.endSwapChainRenderPass(commandBuffer);
 			m_pgsRenderer.endFrame();
+
+			stats.frames++;
+			stats.substeps += substeps;
+			stats.maxSubsteps = std::max(stats.maxSubsteps, substeps);
+			stats.simulatedTime += substeps * stepTime;
+		}
+
+		stats.elapsed += frameTime;
+		if (PRINT_STATS && stats.elapsed >= STATS_INTERVAL)
+		{
+			printStats(stats, *backend);
+			stats = SimulationStats{};
+			backend->resetStats();
 		}
 	}
 
 	vkDeviceWaitIdle(m_pgsDevice.device());
 }
 
+void GravSimApp::printStats(const SimulationStats &stats, const SimulationBackend &backend)
+{
+	double frames = std::max(stats.frames, 1u);
+	double steps = std::max(stats.substeps, 1u);
+	std::cout << std::fixed << std::setprecision(1) << stats.frames / stats.elapsed << " fps, "
+			  << std::setprecision(2) << stats.substeps / frames << " substeps/frame (max "
+			  << stats.maxSubsteps << "), " << stats.substeps / stats.elapsed
+			  << " steps/s, mean step " << std::setprecision(3) << stats.simulatedTime / steps * 1000.0
+			  << " ms, dropped " << stats.droppedTime << " s, "
+			  << SimulationBackend::typeName(backend.getType()) << " backend ";
+	// both are the time the steps themselves took, so the backends compare directly
+	const SimulationBackend::Stats &backendStats = backend.getStats();
+	if (backendStats.timedSteps > 0)
+	{
+		std::cout << backendStats.milliseconds / backendStats.timedSteps
+				  << (backend.isDeviceTimed() ? " device" : " host") << " ms/step" << std::endl;
+	}
+	else
+	{
+		std::cout << "untimed" << std::endl;
+	}
+}
+
+void GravSimApp::benchmarkForceKernels(ParticleSystem &particleSystem,
+									   PgsDescriptorSetLayout &globalSetLayout)
+{
+	constexpr uint32_t WARMUP_ITERATIONS = 2;
+	constexpr uint32_t ITERATIONS = 10;
+	const std::vector<uint32_t> particleCounts{4096, 16384, 65536, 262144};
+	const auto countSize = static_cast<uint32_t>(particleCounts.size());
+
+	// two sets per count, over the state in generation order and after a Morton sort
+	auto benchmarkPool = PgsDescriptorPool::Builder(m_pgsDevice)
+							 .setMaxSets(2 * countSize)
+							 .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+										  2 * GLOBAL_SET_STORAGE_BUFFERS * countSize)
+							 .build();
+
+	// only written by the symmetric kernel, but every binding of the set has to be
+	// valid, it also stands in for the jerk and active list buffers
+	PgsBuffer accelerationBuffer{m_pgsDevice,
+								 sizeof(glm::vec2),
+								 particleCounts.back(),
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+								 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+	SpatialSortSystem spatialSortSystem{m_pgsDevice, particleCounts.back()};
+	// the passes the sort is meant to help: the tree walk and the P3M cell list read
+	// their neighbours from nearby slots once the particles are Morton ordered
+	BarnesHutSystem barnesHutSystem{m_pgsDevice,
+									globalSetLayout.getDescriptorSetLayout(),
+									particleCounts.back()};
+	barnesHutSystem.setOpeningAngle(BARNES_HUT_OPENING_ANGLE);
+	P3MSystem p3mSystem{m_pgsDevice,
+						globalSetLayout.getDescriptorSetLayout(),
+						particleCounts.back(),
+						P3M_GRID_SIZE,
+						P3M_SPLIT_RADIUS};
+
+	PgsGpuTimer timer{m_pgsDevice, 2};
+
+	// records WARMUP_ITERATIONS + ITERATIONS passes and returns the time of the timed ones
+	auto timeIterations = [&](auto &&recordIteration) {
+		VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+		timer.reset(commandBuffer);
+		for (uint32_t iteration = 0; iteration < WARMUP_ITERATIONS + ITERATIONS; iteration++)
+		{
+			if (iteration == WARMUP_ITERATIONS)
+			{
+				timer.writeTimestamp(commandBuffer, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+			}
+			recordIteration(commandBuffer);
+		}
+		timer.writeTimestamp(commandBuffer, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+		m_pgsDevice.endSingleTimeCommands(commandBuffer);
+
+		timer.fetchResults();
+		return timer.elapsedMilliseconds(0, 1);
+	};
+
+	// every step reads the same state, so repeated steps do identical work
+	auto createBenchmarkSet = [&](PgsModel &model, uint32_t stateIn) {
+		auto &in = model.getState(stateIn);
+		auto &out = model.getState((stateIn + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = in.positions->descriptorInfo();
+		auto positionOutInfo = out.positions->descriptorInfo();
+		auto velocityInfo = in.velocities->descriptorInfo();
+		auto velocityOutInfo = out.velocities->descriptorInfo();
+		auto colorValueOutInfo = out.colorValues->descriptorInfo();
+		auto accelerationInfo = accelerationBuffer.descriptorInfo();
+		auto countInfo = model.getCountBuffer().descriptorInfo();
+		auto massInfo = model.getMassBuffer().descriptorInfo();
+		VkDescriptorSet descriptorSet;
+		auto result = PgsDescriptorWriter(globalSetLayout, *benchmarkPool)
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(2, &accelerationInfo)
+						  .writeBuffer(3, &positionOutInfo)
+						  .writeBuffer(4, &velocityInfo)
+						  .writeBuffer(5, &velocityOutInfo)
+						  .writeBuffer(6, &colorValueOutInfo)
+						  .writeBuffer(7, &accelerationInfo)
+						  .writeBuffer(8, &accelerationInfo)
+						  .writeBuffer(9, &countInfo)
+						  .writeBuffer(10, &massInfo)
+						  .build(descriptorSet);
+		assert(result && "Failed to build descriptor writer!");
+		return descriptorSet;
+	};
+
+	// the direct kernel comes first and is the baseline of the speedups. The symmetric
+	// kernel's time includes its reduction and integrate passes, so its speedup is net.
+	auto benchmarkKernels = [&](VkDescriptorSet descriptorSet, uint32_t particleCount, const char *order) {
+		double directMilliseconds = 0.0;
+		for (uint32_t k = 0; k < static_cast<uint32_t>(ParticleSystem::ForceKernel::Count); k++)
+		{
+			auto kernel = static_cast<ParticleSystem::ForceKernel>(k);
+			if (!particleSystem.isForceKernelSupported(kernel))
+			{
+				std::cout << "\t" << std::setw(8) << particleCount << " particles  "
+						  << ParticleSystem::forceKernelName(kernel) << " kernel unsupported" << std::endl;
+				continue;
+			}
+
+			double milliseconds = timeIterations([&](VkCommandBuffer commandBuffer) {
+				// zero time step so positions stay put
+				particleSystem.recordForceKernel(commandBuffer, descriptorSet, kernel, particleCount, 0.0f);
+				PgsComputePipeline::computeBarrier(commandBuffer);
+			});
+			if (kernel == ParticleSystem::ForceKernel::Direct)
+			{
+				directMilliseconds = milliseconds;
+			}
+			double interactions = static_cast<double>(particleCount) * particleCount * ITERATIONS;
+			std::cout << "\t" << std::setw(8) << particleCount << " particles  " << std::setw(8)
+					  << ParticleSystem::forceKernelName(kernel) << "  " << std::setw(10) << order
+					  << "  " << std::fixed << std::setprecision(3) << milliseconds / ITERATIONS
+					  << " ms/step  " << std::setprecision(2) << interactions / (milliseconds * 1e6)
+					  << " G interactions/s  " << directMilliseconds / milliseconds << "x direct"
+					  << std::endl;
+		}
+	};
+
+	// Barnes-Hut and P3M over the same state, relative to the generation order. Both clear
+	// their buffers with transfers at the start of every pass, so iterations are ordered
+	// against the previous pass's reads too.
+	std::array<double, 2> generationMilliseconds{};
+	auto benchmarkSolvers = [&](VkDescriptorSet descriptorSet, uint32_t particleCount, const char *order) {
+		const std::array<const char *, 2> solverNames{"barnes-hut", "p3m"};
+		for (uint32_t solver = 0; solver < solverNames.size(); solver++)
+		{
+			double milliseconds = timeIterations([&](VkCommandBuffer commandBuffer) {
+				if (solver == 0)
+				{
+					barnesHutSystem.computeAccelerations(commandBuffer, descriptorSet, particleCount);
+				}
+				else
+				{
+					p3mSystem.computeAccelerations(commandBuffer, descriptorSet, particleCount);
+				}
+				PgsComputePipeline::computeBarrier(commandBuffer);
+				PgsComputePipeline::computeToTransferBarrier(commandBuffer);
+			});
+			if (std::strcmp(order, "generation") == 0)
+			{
+				generationMilliseconds[solver] = milliseconds;
+			}
+			std::cout << "\t" << std::setw(8) << particleCount << " particles  " << std::setw(10)
+					  << solverNames[solver] << "  " << std::setw(10) << order << "  " << std::fixed
+					  << std::setprecision(3) << milliseconds / ITERATIONS << " ms/step  "
+					  << std::setprecision(2) << generationMilliseconds[solver] / milliseconds
+					  << "x generation" << std::endl;
+		}
+	};
+
+	std::cout << "force kernel benchmark on " << m_pgsDevice.properties.deviceName << " ("
+			  << ITERATIONS << " steps per sample, subgroup size "
+			  << m_pgsDevice.subgroupSupport.subgroupSize << ")" << std::endl;
+	for (uint32_t i = 0; i < countSize; i++)
+	{
+		uint32_t particleCount = particleCounts[i];
+		auto model = PgsModel::createModel(m_pgsDevice, particleCount);
+
+		VkDescriptorSet generationSet = createBenchmarkSet(*model, 0);
+		benchmarkKernels(generationSet, particleCount, "generation");
+		benchmarkSolvers(generationSet, particleCount, "generation");
+
+		// the sort reads state 0 and leaves the Morton ordered particles in state 1
+		spatialSortSystem.bindState(*model);
+		VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+		spatialSortSystem.recordSort(commandBuffer, *model);
+		m_pgsDevice.endSingleTimeCommands(commandBuffer);
+		VkDescriptorSet mortonSet = createBenchmarkSet(*model, 1);
+		benchmarkKernels(mortonSet, particleCount, "morton");
+		benchmarkSolvers(mortonSet, particleCount, "morton");
+	}
+}
+
+void GravSimApp::compareCpuBackend(ParticleSystem &particleSystem,
+								   PgsDescriptorSetLayout &globalSetLayout)
+{
+	const uint32_t particleCount = CPU_COMPARISON_PARTICLE_COUNT;
+	const float stepTime = SIMULATION_DT * TIME_SCALE;
+
+	std::vector<PgsModel::Particle> particles = generateParticles(particleCount);
+	PgsModel model{m_pgsDevice, particles};
+	CpuSimulation cpuSimulation{particles};
+
+	auto comparisonPool = PgsDescriptorPool::Builder(m_pgsDevice)
+							  .setMaxSets(PgsModel::STATE_BUFFER_COUNT)
+							  .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+										   GLOBAL_SET_STORAGE_BUFFERS * PgsModel::STATE_BUFFER_COUNT)
+							  .build();
+
+	// the direct kernel integrates in place and never touches it, it stands in for the
+	// acceleration, jerk and active list bindings
+	PgsBuffer accelerationBuffer{m_pgsDevice,
+								 sizeof(glm::vec2),
+								 particleCount,
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+								 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT};
+
+	// one set per state buffer like the simulation loop, so consecutive steps ping-pong
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> descriptorSets;
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto &in = model.getState(state);
+		auto &out = model.getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = in.positions->descriptorInfo();
+		auto positionOutInfo = out.positions->descriptorInfo();
+		auto velocityInfo = in.velocities->descriptorInfo();
+		auto velocityOutInfo = out.velocities->descriptorInfo();
+		auto colorValueOutInfo = out.colorValues->descriptorInfo();
+		auto accelerationInfo = accelerationBuffer.descriptorInfo();
+		auto countInfo = model.getCountBuffer().descriptorInfo();
+		auto massInfo = model.getMassBuffer().descriptorInfo();
+		auto result = PgsDescriptorWriter(globalSetLayout, *comparisonPool)
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(2, &accelerationInfo)
+						  .writeBuffer(3, &positionOutInfo)
+						  .writeBuffer(4, &velocityInfo)
+						  .writeBuffer(5, &velocityOutInfo)
+						  .writeBuffer(6, &colorValueOutInfo)
+						  .writeBuffer(7, &accelerationInfo)
+						  .writeBuffer(8, &accelerationInfo)
+						  .writeBuffer(9, &countInfo)
+						  .writeBuffer(10, &massInfo)
+						  .build(descriptorSets[state]);
+		assert(result && "Failed to build descriptor writer!");
+	}
+
+	VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+	for (uint32_t step = 0; step < CPU_COMPARISON_STEPS; step++)
+	{
+		particleSystem.recordForceKernel(commandBuffer,
+										 descriptorSets[model.getStateIndex()],
+										 ParticleSystem::ForceKernel::Direct,
+										 particleCount,
+										 stepTime);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+		model.swapStateBuffers();
+	}
+	m_pgsDevice.endSingleTimeCommands(commandBuffer);
+
+	for (uint32_t step = 0; step < CPU_COMPARISON_STEPS; step++)
+	{
+		cpuSimulation.step(stepTime);
+	}
+
+	VkDeviceSize positionBytes = sizeof(glm::vec2) * particleCount;
+	PgsBuffer positionStaging{m_pgsDevice,
+							  sizeof(glm::vec2),
+							  particleCount,
+							  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+								  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	m_pgsDevice.copyBuffer(model.getCurrentState().positions->getBuffer(),
+						   positionStaging.getBuffer(),
+						   positionBytes);
+	std::vector<glm::vec2> gpuPositions(particleCount);
+	positionStaging.map();
+	memcpy(gpuPositions.data(), positionStaging.getMappedMemory(), positionBytes);
+
+	// the kernels round differently (pow against rsqrt with a Newton step), so the
+	// states drift apart slowly; a broken kernel shows up as an error near the disk size
+	std::vector<PgsModel::Particle> cpuParticles = cpuSimulation.getParticles();
+	double squaredErrorSum = 0.0;
+	double maxError = 0.0;
+	for (uint32_t i = 0; i < particleCount; i++)
+	{
+		double error = glm::length(gpuPositions[i] - cpuParticles[i].position);
+		squaredErrorSum += error * error;
+		maxError = std::max(maxError, error);
+	}
+	std::cout << "cpu backend (" << cpuForceKernelName(cpuSimulation.getForceKernel())
+			  << " kernel) against the direct kernel after " << CPU_COMPARISON_STEPS << " steps of "
+			  << particleCount << " particles: rms position difference "
+			  << std::sqrt(squaredErrorSum / particleCount) << ", max " << maxError << std::endl;
+}
+
 } // namespace pgs
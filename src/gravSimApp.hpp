@@ -1,9 +1,13 @@
 #pragma once
 
+#include "backends/simulation_backend.hpp"
+#include "cpu/cpu_simulation.hpp"
 #include "pgs_descriptors.hpp"
 #include "pgs_device.hpp"
 #include "pgs_renderer.hpp"
 #include "pgs_window.hpp"
+#include "systems/adaptive_timestep_system.hpp"
+#include "systems/particle_system.hpp"
 
 // std
 #include <memory>
@@ -17,6 +21,93 @@ class GravSimApp
 	static constexpr int WIDTH = 2560;
 	static constexpr int HEIGHT = 1440;
 
+	// particles created at startup, any count works, the last work group of every pass
+	// is partially filled
+	static constexpr uint32_t PARTICLE_COUNT = PgsModel::DEFAULT_PARTICLE_COUNT;
+
+	// fixed simulation time step, wall clock time is consumed in steps of this size
+	static constexpr float SIMULATION_DT = 1.0f / 120.0f;
+	// simulated time per second of wall clock time, one step advances the
+	// simulation by SIMULATION_DT * TIME_SCALE
+	static constexpr float TIME_SCALE = 0.1f;
+	// pick the step from the largest acceleration and speed of the state a few frames
+	// back instead of SIMULATION_DT, see AdaptiveTimestepSystem. Block timesteps keep
+	// SIMULATION_DT as their finest step.
+	static constexpr bool ADAPTIVE_TIMESTEP = false;
+	static constexpr float ADAPTIVE_TIMESTEP_ACCURACY = AdaptiveTimestepSystem::DEFAULT_ACCURACY;
+	// adaptive steps stay within [SIMULATION_DT / 16, SIMULATION_DT * 4]
+	static constexpr float ADAPTIVE_MIN_DT = SIMULATION_DT / 16.0f;
+	static constexpr float ADAPTIVE_MAX_DT = SIMULATION_DT * 4.0f;
+	// upper bound of substeps recorded into one frame, time beyond it is dropped so a
+	// slow frame can't snowball into ever longer ones
+	static constexpr uint32_t MAX_SUBSTEPS_PER_FRAME = 8;
+	// print frame rate and substep statistics every STATS_INTERVAL seconds
+	static constexpr bool PRINT_STATS = true;
+	static constexpr float STATS_INTERVAL = 2.0f;
+
+	// engine stepping the particles, see SimulationBackend. The solver, integrator and
+	// tuning settings below only apply to the compute backend, the CPU backend steps
+	// CPU_BACKEND_SOLVER with semi-implicit Euler.
+	static constexpr SimulationBackend::Type SIMULATION_BACKEND = SimulationBackend::Type::Compute;
+	// worker threads of the CPU backend, 0 uses every hardware thread
+	static constexpr uint32_t CPU_BACKEND_THREAD_COUNT = 0;
+	static constexpr CpuSimulation::ForceSolver CPU_BACKEND_SOLVER =
+		CpuSimulation::ForceSolver::BarnesHut;
+
+	// gravity kernel used by the simulation loop
+	static constexpr ParticleSystem::ForceKernel FORCE_KERNEL = ParticleSystem::ForceKernel::Tiled;
+	// force engine used by the simulation loop, Restricted starts from
+	// PgsModel::createRestrictedModel instead of the default distribution
+	static constexpr ParticleSystem::ForceSolver FORCE_SOLVER = ParticleSystem::ForceSolver::Direct;
+	// time integrator used by the simulation loop, Hermite needs the Direct or Restricted solver
+	static constexpr ParticleSystem::Integrator INTEGRATOR = ParticleSystem::Integrator::Euler;
+	// coarsest block timestep level (steps of SIMULATION_DT * 2^level) and the accuracy
+	// parameter picking the levels, only used by ParticleSystem::Integrator::BlockTimesteps
+	static constexpr uint32_t BLOCK_TIMESTEP_MAX_LEVEL = BlockTimestepSystem::DEFAULT_MAX_LEVEL;
+	static constexpr float BLOCK_TIMESTEP_ACCURACY = BlockTimestepSystem::DEFAULT_ACCURACY;
+	// steps between Morton-order spatial sorts of the particle state, 0 disables sorting
+	static constexpr uint32_t SPATIAL_SORT_INTERVAL = 120;
+	// merge particles closer than MERGE_RADIUS every MERGE_INTERVAL steps, shrinking the
+	// live count as clumps form; 0 disables merging, see MergeSystem
+	static constexpr float MERGE_RADIUS = 0.0f;
+	static constexpr uint32_t MERGE_INTERVAL = 30;
+	// Barnes-Hut opening angle, smaller is more accurate and slower
+	static constexpr float BARNES_HUT_OPENING_ANGLE = 0.5f;
+	// particle-mesh grid resolution per axis, must be a power of two
+	static constexpr uint32_t PARTICLE_MESH_GRID_SIZE = 512;
+	// P3M mesh resolution and force split radius, 0 picks 1.25 mesh cells
+	static constexpr uint32_t P3M_GRID_SIZE = 256;
+	static constexpr float P3M_SPLIT_RADIUS = 0.0f;
+	// how particles are colored when drawn, changing these never touches the simulation
+	static constexpr ParticleSystem::Colormap COLORMAP = ParticleSystem::Colormap::Classic;
+	static constexpr ParticleSystem::ColorSource COLOR_SOURCE =
+		ParticleSystem::ColorSource::Acceleration;
+	// color source value mapped to the middle of the colormap
+	static constexpr float COLOR_SCALE = 1.0f;
+	// compare one Barnes-Hut pass against the direct sum before the simulation starts
+	static constexpr bool REPORT_BARNES_HUT_ACCURACY = false;
+	// pick the all-pairs kernel, work group size and unroll factor by timing them at
+	// startup; the choice is cached per device and particle count in KERNEL_TUNING_CACHE_PATH
+	static constexpr bool AUTOTUNE_FORCE_KERNEL = false;
+	// ignore the cache and time every candidate again
+	static constexpr bool RETUNE_FORCE_KERNEL = false;
+	static constexpr const char *KERNEL_TUNING_CACHE_PATH = "kernel_tuning.cache";
+	// longest a single all-pairs dispatch of the direct solver may run, longer sums
+	// are split into chunks of sources timed at startup; 0 never splits
+	static constexpr double FORCE_CHUNK_BUDGET_MS = 0.0;
+	// time every force kernel at several particle counts before the simulation starts
+	static constexpr bool BENCHMARK_FORCE_KERNELS = false;
+	// step the same initial conditions with the direct kernel and the CPU backend before
+	// the simulation starts and report how far the positions drift apart, see CpuSimulation
+	static constexpr bool COMPARE_CPU_BACKEND = false;
+	static constexpr uint32_t CPU_COMPARISON_PARTICLE_COUNT = 4096;
+	static constexpr uint32_t CPU_COMPARISON_STEPS = 60;
+
+	// global descriptor sets, one per particle state buffer
+	static constexpr int GLOBAL_SET_COUNT = PgsModel::STATE_BUFFER_COUNT;
+	// storage buffers bound by one global descriptor set
+	static constexpr int GLOBAL_SET_STORAGE_BUFFERS = 10;
+
 	GravSimApp();
 	~GravSimApp();
 
@@ -26,7 +117,22 @@ class GravSimApp
 	void run();
 
   private:
+	// frame and substep counts since the last printStats
+	struct SimulationStats
+	{
+		uint32_t frames;
+		uint32_t substeps;
+		uint32_t maxSubsteps;
+		float elapsed;
+		float droppedTime;
+		float simulatedTime;
+	};
+
 	void loadGameObjects();
+	void printStats(const SimulationStats &stats, const SimulationBackend &backend);
+	void benchmarkForceKernels(ParticleSystem &particleSystem,
+							   PgsDescriptorSetLayout &globalSetLayout);
+	void compareCpuBackend(ParticleSystem &particleSystem, PgsDescriptorSetLayout &globalSetLayout);
 
 	PgsWindow m_pgsWindow{WIDTH, HEIGHT, "Particle Gravity Simulation"};
 	PgsDevice m_pgsDevice{m_pgsWindow};
@@ -0,0 +1,219 @@
+#include "headless_app.hpp"
+
+#include "backends/cpu_backend.hpp"
+#include "cpu/cpu_features.hpp"
+#include "cpu/cpu_simulation.hpp"
+#include "cpu/cpu_thread_pool.hpp"
+
+// std
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace pgs
+{
+
+void HeadlessApp::run()
+{
+	const CpuFeatures &features = hostCpuFeatures();
+	std::cout << "headless cpu backend: avx2 " << features.avx2 << ", fma " << features.fma
+			  << ", avx512f " << features.avx512f << std::endl;
+
+	if (REPORT_SCALING)
+	{
+		reportScaling();
+	}
+	if (REPORT_BARNES_HUT_ACCURACY)
+	{
+		reportBarnesHutAccuracy();
+	}
+
+	CpuBackend backend{generateParticles(PARTICLE_COUNT), m_threadCount, PIN_THREADS};
+	CpuSimulation &simulation = backend.getSimulation();
+	configure(simulation);
+	// the tree code is rated by the all-pairs work it replaces
+	double interactionsPerStep = static_cast<double>(PARTICLE_COUNT) * PARTICLE_COUNT;
+	const char *interactionUnit = FORCE_SOLVER == CpuSimulation::ForceSolver::Direct
+									  ? " G interactions/s"
+									  : " G direct-equivalent interactions/s";
+
+	if (BENCHMARK_CPU_KERNELS)
+	{
+		CpuForceKernel bestKernel = simulation.getForceKernel();
+		double scalarMilliseconds = 0.0;
+		for (uint32_t k = 0; k < static_cast<uint32_t>(CpuForceKernel::Count); k++)
+		{
+			auto kernel = static_cast<CpuForceKernel>(k);
+			if (!isCpuForceKernelSupported(kernel, features))
+			{
+				std::cout << "\t" << std::setw(8) << cpuForceKernelName(kernel) << " kernel unsupported"
+						  << std::endl;
+				continue;
+			}
+
+			simulation.setForceKernel(kernel);
+			auto begin = std::chrono::high_resolution_clock::now();
+			simulation.computeAccelerations();
+			auto end = std::chrono::high_resolution_clock::now();
+			double milliseconds = std::chrono::duration<double, std::milli>(end - begin).count();
+			if (kernel == CpuForceKernel::Scalar)
+			{
+				scalarMilliseconds = milliseconds;
+			}
+			std::cout << "\t" << std::setw(8) << PARTICLE_COUNT << " particles  " << std::setw(8)
+					  << cpuForceKernelName(kernel) << "  " << std::fixed << std::setprecision(3)
+					  << milliseconds << " ms/step  " << std::setprecision(2)
+					  << interactionsPerStep / (milliseconds * 1e6) << interactionUnit << "  "
+					  << scalarMilliseconds / milliseconds << "x scalar" << std::endl;
+		}
+		simulation.setForceKernel(bestKernel);
+	}
+
+	std::cout << "simulating " << PARTICLE_COUNT << " particles for " << STEP_COUNT
+			  << " steps with the " << CpuSimulation::forceSolverName(simulation.getForceSolver())
+			  << " solver and the " << cpuForceKernelName(simulation.getForceKernel())
+			  << " kernel on " << simulation.getThreadCount() << " threads" << std::endl;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	auto statsStart = start;
+	for (uint32_t step = 0; step < STEP_COUNT; step++)
+	{
+		backend.step(STEP_TIME, 1);
+
+		auto now = std::chrono::high_resolution_clock::now();
+		float elapsed = std::chrono::duration<float>(now - statsStart).count();
+		if (elapsed >= STATS_INTERVAL)
+		{
+			const SimulationBackend::Stats &stats = backend.getStats();
+			std::cout << std::fixed << std::setprecision(2) << stats.steps / elapsed << " steps/s, "
+					  << stats.steps * interactionsPerStep / (elapsed * 1e9) << interactionUnit
+					  << ", " << std::setprecision(3) << stats.milliseconds / stats.timedSteps
+					  << " host ms/step" << std::endl;
+			statsStart = now;
+			backend.resetStats();
+		}
+	}
+
+	double seconds =
+		std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	std::cout << std::fixed << std::setprecision(2) << STEP_COUNT << " steps in " << seconds
+			  << " s, " << STEP_COUNT / seconds << " steps/s, "
+			  << STEP_COUNT * interactionsPerStep / (seconds * 1e9) << interactionUnit << std::endl;
+}
+
+void HeadlessApp::configure(CpuSimulation &simulation)
+{
+	simulation.setForceSolver(FORCE_SOLVER);
+	simulation.getBarnesHut().setOpeningAngle(BARNES_HUT_OPENING_ANGLE);
+	simulation.getBarnesHut().setLeafSize(BARNES_HUT_LEAF_SIZE);
+}
+
+double HeadlessApp::measureStepMilliseconds(uint32_t particleCount, uint32_t threadCount)
+{
+	CpuSimulation simulation{generateParticles(particleCount), threadCount, PIN_THREADS};
+	configure(simulation);
+	// the first step wakes the workers and pulls the state into their caches
+	simulation.step(STEP_TIME);
+
+	auto begin = std::chrono::high_resolution_clock::now();
+	for (uint32_t step = 0; step < SCALING_STEPS; step++)
+	{
+		simulation.step(STEP_TIME);
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	return std::chrono::duration<double, std::milli>(end - begin).count() / SCALING_STEPS;
+}
+
+void HeadlessApp::reportScaling()
+{
+	const std::vector<uint32_t> strongParticleCounts{4096, 16384, 65536};
+
+	// powers of two up to every hardware thread, and the full count when it is none
+	uint32_t maxThreads = CpuThreadPool::hardwareThreadCount();
+	std::vector<uint32_t> threadCounts;
+	for (uint32_t threads = 1; threads < maxThreads; threads *= 2)
+	{
+		threadCounts.push_back(threads);
+	}
+	threadCounts.push_back(maxThreads);
+
+	std::cout << "strong scaling (" << SCALING_STEPS << " steps per sample)" << std::endl;
+	for (uint32_t particleCount : strongParticleCounts)
+	{
+		double singleMilliseconds = 0.0;
+		for (uint32_t threads : threadCounts)
+		{
+			double milliseconds = measureStepMilliseconds(particleCount, threads);
+			if (threads == 1)
+			{
+				singleMilliseconds = milliseconds;
+			}
+			double speedup = singleMilliseconds / milliseconds;
+			std::cout << "\t" << std::setw(8) << particleCount << " particles  " << std::setw(4)
+					  << threads << " threads  " << std::fixed << std::setprecision(3)
+					  << milliseconds << " ms/step  " << std::setprecision(2) << speedup
+					  << "x speedup  " << std::setprecision(1) << 100.0 * speedup / threads
+					  << "% efficiency" << std::endl;
+		}
+	}
+
+	std::cout << "weak scaling (" << WEAK_SCALING_BASE_COUNT << " particles on 1 thread)" << std::endl;
+	double singleMilliseconds = 0.0;
+	for (uint32_t threads : threadCounts)
+	{
+		// whole target tiles, so the work per thread stays comparable
+		double idealCount = WEAK_SCALING_BASE_COUNT * std::sqrt(static_cast<double>(threads));
+		uint32_t particleCount = std::max(
+			static_cast<uint32_t>(std::lround(idealCount / CpuSimulation::TARGET_TILE)) *
+				CpuSimulation::TARGET_TILE,
+			CpuSimulation::TARGET_TILE);
+		double milliseconds = measureStepMilliseconds(particleCount, threads);
+		if (threads == 1)
+		{
+			singleMilliseconds = milliseconds;
+		}
+		// pairs per thread are only close to equal after rounding, scale them back out
+		double pairsPerThread = static_cast<double>(particleCount) * particleCount / threads;
+		double basePairs = static_cast<double>(WEAK_SCALING_BASE_COUNT) * WEAK_SCALING_BASE_COUNT;
+		double efficiency = singleMilliseconds / milliseconds * pairsPerThread / basePairs;
+		std::cout << "\t" << std::setw(8) << particleCount << " particles  " << std::setw(4) << threads
+				  << " threads  " << std::fixed << std::setprecision(3) << milliseconds
+				  << " ms/step  " << std::setprecision(1) << 100.0 * efficiency << "% efficiency"
+				  << std::endl;
+	}
+}
+
+void HeadlessApp::reportBarnesHutAccuracy()
+{
+	CpuSimulation simulation{generateParticles(BARNES_HUT_ACCURACY_PARTICLE_COUNT),
+							 m_threadCount,
+							 PIN_THREADS};
+	configure(simulation);
+	simulation.setForceSolver(CpuSimulation::ForceSolver::BarnesHut);
+	simulation.computeAccelerations();
+	std::vector<glm::vec2> treeAccelerations = simulation.getAccelerations();
+	uint32_t nodeCount = simulation.getBarnesHut().getNodeCount();
+
+	simulation.setForceSolver(CpuSimulation::ForceSolver::Direct);
+	simulation.computeAccelerations();
+	std::vector<glm::vec2> directAccelerations = simulation.getAccelerations();
+
+	double squaredErrorSum = 0.0;
+	double maxError = 0.0;
+	for (size_t i = 0; i < directAccelerations.size(); i++)
+	{
+		double reference = std::max(static_cast<double>(glm::length(directAccelerations[i])), 1e-30);
+		double error = glm::length(treeAccelerations[i] - directAccelerations[i]) / reference;
+		squaredErrorSum += error * error;
+		maxError = std::max(maxError, error);
+	}
+	std::cout << "cpu barnes-hut accuracy (opening angle " << BARNES_HUT_OPENING_ANGLE
+			  << ", leaf size " << BARNES_HUT_LEAF_SIZE << ", " << nodeCount << " nodes, "
+			  << directAccelerations.size() << " particles): rms relative error "
+			  << std::sqrt(squaredErrorSum / std::max<size_t>(directAccelerations.size(), 1))
+			  << ", max relative error " << maxError << std::endl;
+}
+
+} // namespace pgs
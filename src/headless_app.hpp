@@ -0,0 +1,62 @@
+#pragma once
+
+#include "cpu/cpu_simulation.hpp"
+
+// std
+#include <vector>
+
+namespace pgs
+{
+// Runs the simulation on the host without a window or Vulkan device, through a
+// CpuBackend (see CpuSimulation). Started with --headless, prints throughput instead of
+// drawing. --threads N overrides THREAD_COUNT.
+class HeadlessApp
+{
+  public:
+	// worker threads of the CPU backend, 0 uses every hardware thread
+	static constexpr uint32_t THREAD_COUNT = 0;
+	// bind every worker to its own logical CPU, see CpuThreadPool
+	static constexpr bool PIN_THREADS = true;
+	// force engine of the CPU backend
+	static constexpr CpuSimulation::ForceSolver FORCE_SOLVER = CpuSimulation::ForceSolver::Direct;
+	// smaller is more accurate and slower, 0 opens every node and matches the direct sum
+	static constexpr float BARNES_HUT_OPENING_ANGLE = 0.5f;
+	static constexpr uint32_t BARNES_HUT_LEAF_SIZE = CpuBarnesHut::DEFAULT_LEAF_SIZE;
+	// the tree code makes counts far past what the all-pairs sum can step interactively
+	static constexpr uint32_t PARTICLE_COUNT =
+		FORCE_SOLVER == CpuSimulation::ForceSolver::BarnesHut ? 262144 : 16384;
+	static constexpr uint32_t STEP_COUNT = 600;
+	// GravSimApp::SIMULATION_DT * GravSimApp::TIME_SCALE, the step of the windowed loop
+	// without adaptive timesteps. Kept apart so the headless build needs no window.
+	static constexpr float STEP_TIME = 1.0f / 120.0f * 0.1f;
+	// print throughput every STATS_INTERVAL seconds
+	static constexpr float STATS_INTERVAL = 2.0f;
+	// time one force evaluation with every kernel the CPU supports before the run
+	static constexpr bool BENCHMARK_CPU_KERNELS = true;
+	// time steps from 1 thread up to all of them before the run: strong scaling at fixed
+	// particle counts, and weak scaling with the particles growing as the square root of
+	// the threads so every thread keeps the same share of the O(N^2) pairs
+	static constexpr bool REPORT_SCALING = false;
+	static constexpr uint32_t WEAK_SCALING_BASE_COUNT = 8192;
+	static constexpr uint32_t SCALING_STEPS = 3;
+	// compare one Barnes-Hut pass against the direct sum over every particle before the run
+	static constexpr bool REPORT_BARNES_HUT_ACCURACY = false;
+	static constexpr uint32_t BARNES_HUT_ACCURACY_PARTICLE_COUNT = 16384;
+
+	explicit HeadlessApp(uint32_t threadCount = THREAD_COUNT) : m_threadCount{threadCount}
+	{
+	}
+
+	void run();
+
+  private:
+	// applies the solver settings above
+	static void configure(CpuSimulation &simulation);
+	void reportScaling();
+	void reportBarnesHutAccuracy();
+	// mean step time of a simulation of particleCount particles on threadCount threads
+	double measureStepMilliseconds(uint32_t particleCount, uint32_t threadCount);
+
+	uint32_t m_threadCount;
+};
+} // namespace pgs
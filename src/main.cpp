@@ -1,13 +1,55 @@
 
+#ifndef PGS_HEADLESS_ONLY
 #include "gravSimApp.hpp"
+#endif
+#include "headless_app.hpp"
 
 // std
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
-int main()
+int main(int argc, char **argv)
 {
+	// --headless simulates on the CPU and never opens a window or Vulkan device,
+	// --threads N sets its worker threads. Builds with PGS_HEADLESS_ONLY have nothing else.
+#ifdef PGS_HEADLESS_ONLY
+	bool headless = true;
+#else
+	bool headless = false;
+#endif
+	uint32_t threadCount = pgs::HeadlessApp::THREAD_COUNT;
+	for (int i = 1; i < argc; i++)
+	{
+		if (std::strcmp(argv[i], "--headless") == 0)
+		{
+			headless = true;
+		}
+		else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+		{
+			threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+	}
+
+	if (headless)
+	{
+		pgs::HeadlessApp app{threadCount};
+
+		try
+		{
+			app.run();
+		}
+		catch (const std::exception &e)
+		{
+			std::cerr << e.what() << '\n';
+			return EXIT_FAILURE;
+		}
+
+		return EXIT_SUCCESS;
+	}
+
+#ifndef PGS_HEADLESS_ONLY
 	pgs::GravSimApp app{};
 
 	try
@@ -21,4 +63,5 @@ int main()
 	}
 
 	return EXIT_SUCCESS;
+#endif
 }
\ No newline at end of file
@@ -10,6 +10,8 @@
 // std
 #include <cassert>
 #include <cstring>
+#include <stdexcept>
+#include <string>
 
 namespace pgs
 {
@@ -35,7 +37,7 @@ VkDeviceSize PgsBuffer::getAlignment(VkDeviceSize instanceSize, VkDeviceSize min
 
 PgsBuffer::PgsBuffer(PgsDevice &device,
 					 VkDeviceSize instanceSize,
-					 uint32_t instanceCount,
+					 VkDeviceSize instanceCount,
 					 VkBufferUsageFlags usageFlags,
 					 VkMemoryPropertyFlags memoryPropertyFlags,
 					 VkDeviceSize minOffsetAlignment)
@@ -44,6 +46,12 @@ PgsBuffer::PgsBuffer(PgsDevice &device,
 {
 	m_alignmentSize = getAlignment(instanceSize, minOffsetAlignment);
 	m_bufferSize = m_alignmentSize * instanceCount;
+	if ((usageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) &&
+		m_bufferSize > device.properties.limits.maxStorageBufferRange)
+	{
+		throw std::length_error("storage buffer of " + std::to_string(m_bufferSize) +
+								" bytes exceeds maxStorageBufferRange");
+	}
 	device.createBuffer(m_bufferSize, m_usageFlags, m_memoryPropertyFlags, m_buffer, m_memory);
 }
 
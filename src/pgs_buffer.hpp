@@ -8,9 +8,11 @@ namespace pgs
 class PgsBuffer
 {
   public:
+	// Storage buffers are bound whole, so their size is checked against
+	// maxStorageBufferRange here, see PgsModel::maxParticleCount
 	PgsBuffer(PgsDevice &device,
 			  VkDeviceSize instanceSize,
-			  uint32_t instanceCount,
+			  VkDeviceSize instanceCount,
 			  VkBufferUsageFlags usageFlags,
 			  VkMemoryPropertyFlags memoryPropertyFlags,
 			  VkDeviceSize minOffsetAlignment = 1);
@@ -41,7 +43,7 @@ class PgsBuffer
 	{
 		return m_mapped;
 	}
-	uint32_t getInstanceCount() const
+	VkDeviceSize getInstanceCount() const
 	{
 		return m_instanceCount;
 	}
@@ -75,7 +77,7 @@ class PgsBuffer
 	VkDeviceMemory m_memory = VK_NULL_HANDLE;
 
 	VkDeviceSize m_bufferSize;
-	uint32_t m_instanceCount;
+	VkDeviceSize m_instanceCount;
 	VkDeviceSize m_instanceSize;
 	VkDeviceSize m_alignmentSize;
 	VkBufferUsageFlags m_usageFlags;
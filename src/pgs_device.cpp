@@ -4,6 +4,8 @@
 #include <cstring>
 #include <iostream>
 #include <set>
+#include <stdexcept>
+#include <string>
 #include <unordered_set>
 
 namespace pgs
@@ -90,7 +92,7 @@ void PgsDevice::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "No Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	appInfo.apiVersion = VK_API_VERSION_1_1;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -151,6 +153,101 @@ void PgsDevice::pickPhysicalDevice()
 
 	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
 	std::cout << "physical device: " << properties.deviceName << std::endl;
+
+	querySubgroupSupport();
+	queryMemoryLimits();
+}
+
+void PgsDevice::queryMemoryLimits()
+{
+	maxMemoryAllocationSize = 0;
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return;
+	}
+
+	VkPhysicalDeviceMaintenance3Properties maintenance3Properties{};
+	maintenance3Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MAINTENANCE_3_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &maintenance3Properties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+	maxMemoryAllocationSize = maintenance3Properties.maxMemoryAllocationSize;
+
+	std::cout << "max storage buffer range: " << properties.limits.maxStorageBufferRange
+			  << " bytes, max allocation: " << maxMemoryAllocationSize << " bytes" << std::endl;
+}
+
+void PgsDevice::querySubgroupSupport()
+{
+	subgroupSupport = SubgroupSupport{};
+	if (properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		std::cout << "subgroups: unsupported (Vulkan 1.0 device)" << std::endl;
+		return;
+	}
+
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(physicalDevice,
+										 nullptr,
+										 &extensionCount,
+										 availableExtensions.data());
+	bool sizeControlExtension = false;
+	for (const auto &extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME) == 0)
+		{
+			sizeControlExtension = true;
+		}
+	}
+
+	VkPhysicalDeviceSubgroupSizeControlPropertiesEXT sizeControlProperties{};
+	sizeControlProperties.sType =
+		VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES_EXT;
+	VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+	subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+	subgroupProperties.pNext = sizeControlExtension ? &sizeControlProperties : nullptr;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &subgroupProperties;
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+
+	VkPhysicalDeviceSubgroupSizeControlFeaturesEXT sizeControlFeatures{};
+	sizeControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT;
+	if (sizeControlExtension)
+	{
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &sizeControlFeatures;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+	}
+
+	subgroupSupport.subgroupSize = subgroupProperties.subgroupSize;
+	subgroupSupport.computeShuffle =
+		(subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+		(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT);
+	subgroupSupport.sizeControl =
+		sizeControlExtension && sizeControlFeatures.subgroupSizeControl &&
+		sizeControlFeatures.computeFullSubgroups &&
+		(sizeControlProperties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT);
+	subgroupSupport.minSubgroupSize =
+		subgroupSupport.sizeControl ? sizeControlProperties.minSubgroupSize : subgroupProperties.subgroupSize;
+	subgroupSupport.maxSubgroupSize =
+		subgroupSupport.sizeControl ? sizeControlProperties.maxSubgroupSize : subgroupProperties.subgroupSize;
+
+	std::cout << "subgroups: size " << subgroupSupport.subgroupSize << ", compute shuffle "
+			  << (subgroupSupport.computeShuffle ? "yes" : "no") << ", size control ";
+	if (subgroupSupport.sizeControl)
+	{
+		std::cout << subgroupSupport.minSubgroupSize << "-" << subgroupSupport.maxSubgroupSize
+				  << std::endl;
+	}
+	else
+	{
+		std::cout << "no" << std::endl;
+	}
 }
 
 void PgsDevice::createLogicalDevice()
@@ -181,8 +278,20 @@ void PgsDevice::createLogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
 	createInfo.pEnabledFeatures = &deviceFeatures;
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+
+	// lets the subgroup force kernel pin its subgroup size, see PgsComputePipeline
+	std::vector<const char *> enabledExtensions = deviceExtensions;
+	VkPhysicalDeviceSubgroupSizeControlFeaturesEXT sizeControlFeatures{};
+	sizeControlFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT;
+	if (subgroupSupport.sizeControl)
+	{
+		enabledExtensions.push_back(VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME);
+		sizeControlFeatures.subgroupSizeControl = VK_TRUE;
+		sizeControlFeatures.computeFullSubgroups = VK_TRUE;
+		createInfo.pNext = &sizeControlFeatures;
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+	createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 	// might not really be necessary anymore because device specific validation
 	// layers have been deprecated
@@ -491,6 +600,13 @@ void PgsDevice::createBuffer(VkDeviceSize size,
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(device_, buffer, &memRequirements);
 
+	if (maxMemoryAllocationSize != 0 && memRequirements.size > maxMemoryAllocationSize)
+	{
+		vkDestroyBuffer(device_, buffer, nullptr);
+		throw std::length_error("buffer of " + std::to_string(memRequirements.size) +
+								" bytes exceeds maxMemoryAllocationSize");
+	}
+
 	VkMemoryAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocInfo.allocationSize = memRequirements.size;
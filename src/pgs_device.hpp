@@ -28,6 +28,18 @@ struct QueueFamilyIndices
 	}
 };
 
+// Subgroup capabilities of the picked device, all false/zero before Vulkan 1.1
+struct SubgroupSupport
+{
+	uint32_t subgroupSize = 0;
+	// compute shaders may use GL_KHR_shader_subgroup_shuffle
+	bool computeShuffle = false;
+	// VK_EXT_subgroup_size_control is enabled and can pin compute subgroup sizes
+	bool sizeControl = false;
+	uint32_t minSubgroupSize = 0;
+	uint32_t maxSubgroupSize = 0;
+};
+
 class PgsDevice
 {
   public:
@@ -98,6 +110,10 @@ class PgsDevice
 							 VkDeviceMemory &imageMemory);
 
 	VkPhysicalDeviceProperties properties;
+	SubgroupSupport subgroupSupport;
+	// largest single memory allocation (VkPhysicalDeviceMaintenance3Properties),
+	// zero on Vulkan 1.0 devices, which do not report it
+	VkDeviceSize maxMemoryAllocationSize = 0;
 
   private:
 	void createInstance();
@@ -106,6 +122,8 @@ class PgsDevice
 	void pickPhysicalDevice();
 	void createLogicalDevice();
 	void createCommandPool();
+	void querySubgroupSupport();
+	void queryMemoryLimits();
 
 	// helper functions
 	bool isDeviceSuitable(VkPhysicalDevice device);
@@ -12,9 +12,12 @@ namespace pgs
 struct FrameInfo
 {
 	int frameIndex;
+	// time step of one simulation substep
 	float frameTime;
 	VkCommandBuffer commandBuffer;
 	std::shared_ptr<PgsModel> model;
 	VkDescriptorSet globalDescriptorSet;
+	// particle state drawn by renderParticles, set once the step has been recorded
+	VkDescriptorSet renderDescriptorSet;
 };
 } // namespace pgs
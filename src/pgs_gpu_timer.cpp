@@ -0,0 +1,76 @@
+#include "pgs_gpu_timer.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace pgs
+{
+
+PgsGpuTimer::PgsGpuTimer(PgsDevice &device, uint32_t timestampCount)
+	: m_pgsDevice{device}, m_timestampCount{timestampCount}, m_timestamps(timestampCount, 0)
+{
+	if (m_pgsDevice.properties.limits.timestampComputeAndGraphics != VK_TRUE)
+	{
+		throw std::runtime_error("device does not support timestamp queries!");
+	}
+
+	VkQueryPoolCreateInfo queryPoolInfo{};
+	queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolInfo.queryCount = m_timestampCount;
+
+	if (vkCreateQueryPool(m_pgsDevice.device(), &queryPoolInfo, nullptr, &m_queryPool) !=
+		VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create timestamp query pool!");
+	}
+}
+
+PgsGpuTimer::~PgsGpuTimer()
+{
+	vkDestroyQueryPool(m_pgsDevice.device(), m_queryPool, nullptr);
+}
+
+void PgsGpuTimer::reset(VkCommandBuffer commandBuffer)
+{
+	vkCmdResetQueryPool(commandBuffer, m_queryPool, 0, m_timestampCount);
+}
+
+void PgsGpuTimer::writeTimestamp(VkCommandBuffer commandBuffer,
+								 uint32_t index,
+								 VkPipelineStageFlagBits stage)
+{
+	assert(index < m_timestampCount && "Timestamp index out of range");
+	vkCmdWriteTimestamp(commandBuffer, stage, m_queryPool, index);
+}
+
+bool PgsGpuTimer::fetchResults(bool wait)
+{
+	VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT;
+	if (wait)
+	{
+		flags |= VK_QUERY_RESULT_WAIT_BIT;
+	}
+
+	auto result = vkGetQueryPoolResults(m_pgsDevice.device(),
+										m_queryPool,
+										0,
+										m_timestampCount,
+										m_timestamps.size() * sizeof(uint64_t),
+										m_timestamps.data(),
+										sizeof(uint64_t),
+										flags);
+	return result == VK_SUCCESS;
+}
+
+double PgsGpuTimer::elapsedMilliseconds(uint32_t beginIndex, uint32_t endIndex) const
+{
+	assert(beginIndex < m_timestampCount && endIndex < m_timestampCount &&
+		   "Timestamp index out of range");
+	// timestampPeriod is the number of nanoseconds per timestamp tick
+	double ticks = static_cast<double>(m_timestamps[endIndex] - m_timestamps[beginIndex]);
+	return ticks * m_pgsDevice.properties.limits.timestampPeriod * 1e-6;
+}
+
+} // namespace pgs
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "pgs_device.hpp"
+
+// std
+#include <vector>
+
+namespace pgs
+{
+
+/*
+ * Wraps a timestamp query pool so GPU work can be timed from inside a command buffer
+ */
+class PgsGpuTimer
+{
+  public:
+	PgsGpuTimer(PgsDevice &device, uint32_t timestampCount);
+	~PgsGpuTimer();
+
+	PgsGpuTimer(const PgsGpuTimer &) = delete;
+	PgsGpuTimer &operator=(const PgsGpuTimer &) = delete;
+
+	void reset(VkCommandBuffer commandBuffer);
+	void writeTimestamp(VkCommandBuffer commandBuffer,
+						uint32_t index,
+						VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+	// Reads back all timestamps; returns false if results are not available yet
+	bool fetchResults(bool wait = true);
+	double elapsedMilliseconds(uint32_t beginIndex, uint32_t endIndex) const;
+
+  private:
+	PgsDevice &m_pgsDevice;
+	VkQueryPool m_queryPool = VK_NULL_HANDLE;
+	uint32_t m_timestampCount;
+	std::vector<uint64_t> m_timestamps;
+};
+
+} // namespace pgs
@@ -0,0 +1,212 @@
+#include "pgs_kernel_tuner.hpp"
+
+#include "pgs_gpu_timer.hpp"
+
+// std
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+namespace pgs
+{
+
+PgsKernelTuner::PgsKernelTuner(PgsDevice &device, std::string cachePath)
+	: m_pgsDevice{device}, m_cachePath{std::move(cachePath)}
+{
+	loadCache();
+}
+
+PgsKernelTuner::Config PgsKernelTuner::tune(ParticleSystem &particleSystem,
+											VkDescriptorSet globalDescriptorSet,
+											uint32_t particleCount,
+											bool retune)
+{
+	std::string key = cacheKey(particleCount);
+	auto cached = m_cache.find(key);
+	if (!retune && cached != m_cache.end())
+	{
+		const Config &config = cached->second;
+		particleSystem.configureForceKernels(config.localSizeX, config.unroll);
+		return config;
+	}
+
+	std::cout << "tuning force kernels for " << particleCount << " particles on "
+			  << m_pgsDevice.properties.deviceName << std::endl;
+
+	Config best{ParticleSystem::ForceKernel::Direct,
+				PgsComputePipeline::LOCAL_SIZE_X,
+				1,
+				std::numeric_limits<double>::max()};
+	for (Config candidate : candidates())
+	{
+		particleSystem.configureForceKernels(candidate.localSizeX, candidate.unroll);
+		candidate.millisecondsPerStep =
+			timeConfig(particleSystem, globalDescriptorSet, particleCount, candidate.kernel);
+
+		std::cout << "\t" << std::setw(6) << ParticleSystem::forceKernelName(candidate.kernel)
+				  << "  local size " << std::setw(4) << candidate.localSizeX << "  unroll "
+				  << candidate.unroll << "  " << std::fixed << std::setprecision(3)
+				  << candidate.millisecondsPerStep << " ms/step" << std::endl;
+
+		if (candidate.millisecondsPerStep < best.millisecondsPerStep)
+		{
+			best = candidate;
+		}
+	}
+
+	particleSystem.configureForceKernels(best.localSizeX, best.unroll);
+	m_cache[key] = best;
+	saveCache();
+	return best;
+}
+
+std::vector<PgsKernelTuner::Config> PgsKernelTuner::candidates() const
+{
+	const std::vector<uint32_t> localSizes{64, 128, 256, 512, 1024};
+	const std::vector<uint32_t> unrolls{1, 2, 4, 8};
+	const auto &limits = m_pgsDevice.properties.limits;
+
+	std::vector<Config> configs;
+	for (uint32_t localSizeX : localSizes)
+	{
+		if (localSizeX > limits.maxComputeWorkGroupSize[0] ||
+			localSizeX > limits.maxComputeWorkGroupInvocations)
+		{
+			continue;
+		}
+		for (uint32_t unroll : unrolls)
+		{
+			for (uint32_t k = 0; k < static_cast<uint32_t>(ParticleSystem::ForceKernel::Count); k++)
+			{
+				auto kernel = static_cast<ParticleSystem::ForceKernel>(k);
+				// the tiled kernel stages one position and one mass per invocation in
+				// shared memory
+				if (kernel == ParticleSystem::ForceKernel::Tiled &&
+					localSizeX * (sizeof(glm::vec2) + sizeof(float)) >
+						limits.maxComputeSharedMemorySize)
+				{
+					continue;
+				}
+				// without shuffles the subgroup kernel falls back to the tiled one
+				if (kernel == ParticleSystem::ForceKernel::Subgroup &&
+					!m_pgsDevice.subgroupSupport.computeShuffle)
+				{
+					continue;
+				}
+				// the symmetric kernel has a fixed tile and no unrolled loop, time it once
+				if (kernel == ParticleSystem::ForceKernel::Symmetric &&
+					(localSizeX != PgsComputePipeline::LOCAL_SIZE_X || unroll != 1))
+				{
+					continue;
+				}
+				configs.push_back({kernel, localSizeX, unroll, 0.0});
+			}
+		}
+	}
+	return configs;
+}
+
+double PgsKernelTuner::timeConfig(ParticleSystem &particleSystem,
+								  VkDescriptorSet globalDescriptorSet,
+								  uint32_t particleCount,
+								  ParticleSystem::ForceKernel kernel)
+{
+	constexpr uint32_t WARMUP_ITERATIONS = 2;
+	constexpr uint32_t ITERATIONS = 5;
+
+	PgsGpuTimer timer{m_pgsDevice, 2};
+	VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+	timer.reset(commandBuffer);
+	for (uint32_t iteration = 0; iteration < WARMUP_ITERATIONS + ITERATIONS; iteration++)
+	{
+		if (iteration == WARMUP_ITERATIONS)
+		{
+			timer.writeTimestamp(commandBuffer, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+		}
+		particleSystem.recordForceKernel(commandBuffer, globalDescriptorSet, kernel, particleCount, 0.0f);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+	}
+	timer.writeTimestamp(commandBuffer, 1, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT);
+	m_pgsDevice.endSingleTimeCommands(commandBuffer);
+
+	timer.fetchResults();
+	return timer.elapsedMilliseconds(0, 1) / ITERATIONS;
+}
+
+uint32_t PgsKernelTuner::chooseForceChunkSize(ParticleSystem &particleSystem,
+											  VkDescriptorSet globalDescriptorSet,
+											  uint32_t particleCount,
+											  double budgetMilliseconds)
+{
+	double milliseconds = timeConfig(particleSystem,
+									 globalDescriptorSet,
+									 particleCount,
+									 particleSystem.getForceKernel());
+	if (milliseconds <= budgetMilliseconds)
+	{
+		return 0;
+	}
+
+	// a dispatch costs about the same for every source, whole work groups keep the
+	// tiles of the tiled kernel full
+	uint32_t localSizeX = particleSystem.getKernelLocalSizeX();
+	double sources = particleCount * budgetMilliseconds / milliseconds;
+	uint32_t chunkSize = static_cast<uint32_t>(sources) / localSizeX * localSizeX;
+	return std::max(chunkSize, localSizeX);
+}
+
+std::string PgsKernelTuner::cacheKey(uint32_t particleCount) const
+{
+	// the pipeline cache UUID changes with the device and its driver version,
+	// both of which can move the fastest configuration
+	std::ostringstream key;
+	key << std::hex << std::setfill('0');
+	for (uint8_t byte : m_pgsDevice.properties.pipelineCacheUUID)
+	{
+		key << std::setw(2) << static_cast<uint32_t>(byte);
+	}
+	key << std::dec << ':' << particleCount;
+	return key.str();
+}
+
+// One configuration per line: <uuid>:<particle count> <kernel> <local size> <unroll> <ms per step>
+void PgsKernelTuner::loadCache()
+{
+	std::ifstream file{m_cachePath};
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream fields{line};
+		std::string key;
+		uint32_t kernel;
+		Config config{};
+		if (fields >> key >> kernel >> config.localSizeX >> config.unroll >> config.millisecondsPerStep &&
+			kernel < static_cast<uint32_t>(ParticleSystem::ForceKernel::Count) && config.localSizeX > 0 &&
+			config.unroll > 0)
+		{
+			config.kernel = static_cast<ParticleSystem::ForceKernel>(kernel);
+			m_cache[key] = config;
+		}
+	}
+}
+
+void PgsKernelTuner::saveCache() const
+{
+	std::ofstream file{m_cachePath, std::ios::trunc};
+	if (!file)
+	{
+		std::cerr << "failed to write kernel tuning cache " << m_cachePath << std::endl;
+		return;
+	}
+	for (const auto &[key, config] : m_cache)
+	{
+		file << key << ' ' << static_cast<uint32_t>(config.kernel) << ' ' << config.localSizeX << ' '
+			 << config.unroll << ' ' << config.millisecondsPerStep << '\n';
+	}
+}
+
+} // namespace pgs
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "pgs_device.hpp"
+#include "systems/particle_system.hpp"
+
+// std
+#include <map>
+#include <string>
+#include <vector>
+
+namespace pgs
+{
+
+/*
+ * Picks the fastest all-pairs kernel configuration (kernel, work group size and
+ * inner loop unroll factor) by timing every candidate with timestamp queries.
+ * Results are persisted per device and particle count in a small text cache, so
+ * later launches apply them without timing anything.
+ */
+class PgsKernelTuner
+{
+  public:
+	struct Config
+	{
+		ParticleSystem::ForceKernel kernel;
+		uint32_t localSizeX;
+		uint32_t unroll;
+		double millisecondsPerStep;
+	};
+
+	PgsKernelTuner(PgsDevice &device, std::string cachePath);
+
+	PgsKernelTuner(const PgsKernelTuner &) = delete;
+	PgsKernelTuner &operator=(const PgsKernelTuner &) = delete;
+
+	// Returns the cached configuration for this device and particleCount, or times every
+	// candidate when there is none or retune is set. globalDescriptorSet must be
+	// bound to a state of particleCount particles; steps are recorded with a zero
+	// time step, so the state is left as it was. Leaves particleSystem configured
+	// with the returned configuration.
+	Config tune(ParticleSystem &particleSystem,
+				VkDescriptorSet globalDescriptorSet,
+				uint32_t particleCount,
+				bool retune = false);
+
+	// Times one unchunked evaluation of the configured kernel and returns the sources
+	// per chunk that keep a dispatch within budgetMilliseconds, a multiple of the
+	// work group size, or zero when the whole sum already fits. Same requirements on
+	// globalDescriptorSet as tune().
+	uint32_t chooseForceChunkSize(ParticleSystem &particleSystem,
+								  VkDescriptorSet globalDescriptorSet,
+								  uint32_t particleCount,
+								  double budgetMilliseconds);
+
+  private:
+	std::vector<Config> candidates() const;
+	double timeConfig(ParticleSystem &particleSystem,
+					  VkDescriptorSet globalDescriptorSet,
+					  uint32_t particleCount,
+					  ParticleSystem::ForceKernel kernel);
+	std::string cacheKey(uint32_t particleCount) const;
+	void loadCache();
+	void saveCache() const;
+
+	PgsDevice &m_pgsDevice;
+	std::string m_cachePath;
+	std::map<std::string, Config> m_cache;
+};
+
+} // namespace pgs
@@ -1,155 +1,291 @@
 #include "pgs_model.hpp"
 
 #include "pgs_utils.hpp"
+#include "pipelines/pgs_computePipeline.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
 #include <cstring>
-#include <random>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 namespace pgs
 {
 
-PgsModel::PgsModel(PgsDevice &device, const std::vector<Particle> &particles) : m_pgsDevice{device}
+PgsModel::PgsModel(PgsDevice &device, const std::vector<Particle> &particles, uint32_t massiveCount)
+	: m_pgsDevice{device}, m_massiveCount{massiveCount}
 {
-	createVertexBuffers(particles);
+	assert(massiveCount <= particles.size() && "More massive bodies than particles");
+	createStateBuffers(particles);
+	createCountBuffer();
 }
 
 PgsModel::~PgsModel()
 {
 }
 
-// One circle centered about the origin
-std::vector<pgs::PgsModel::Particle> particleDist1()
+uint32_t PgsModel::maxParticleCount(PgsDevice &device, VkDeviceSize elementSize)
 {
-	const double TWO_PI = 6.2831853071795864769;
-	const float radius = 0.5f;
-	const float multiplier = 2.5f;
-	std::default_random_engine rndEngine((unsigned)time(nullptr));
-	std::uniform_real_distribution<float> rndDistribution(0.0f, 1.0f);
-
-	std::vector<pgs::PgsModel::Particle> particles(pgs::PgsModel::PARTICLE_COUNT);
-	for (auto &particle : particles)
+	VkDeviceSize maxBytes = device.properties.limits.maxStorageBufferRange;
+	if (device.maxMemoryAllocationSize != 0)
 	{
-		float r = radius * sqrt(rndDistribution(rndEngine));
-		float theta = rndDistribution(rndEngine) * TWO_PI;
-		particle.position = glm::vec2(r * cos(theta), r * sin(theta));
-		float distanceToCenter = glm::dot(particle.position, particle.position);
-		glm::vec2 directionPerpendicularToCenterLine =
-			glm::vec2(-particle.position.y, particle.position.x);
-		particle.velocity = distanceToCenter * directionPerpendicularToCenterLine * multiplier;
+		maxBytes = std::min(maxBytes, device.maxMemoryAllocationSize);
 	}
+	VkDeviceSize maxCount = maxBytes / elementSize;
+	return static_cast<uint32_t>(
+		std::min<VkDeviceSize>(maxCount, std::numeric_limits<uint32_t>::max()));
+}
 
-	return particles;
+std::unique_ptr<PgsModel> PgsModel::createModel(PgsDevice &device, uint32_t particleCount)
+{
+	uint32_t maxCount = maxParticleCount(device);
+	if (particleCount > maxCount)
+	{
+		throw std::length_error(std::to_string(particleCount) + " particles exceed the " +
+								std::to_string(maxCount) + " the device can bind");
+	}
+
+	std::vector<Particle> particles = generateParticles(particleCount);
+
+	return std::make_unique<PgsModel>(device, particles);
 }
 
-// Two seperate squares
-std::vector<pgs::PgsModel::Particle> particleDist2()
+std::unique_ptr<PgsModel> PgsModel::createRestrictedModel(PgsDevice &device, uint32_t particleCount)
 {
-	std::vector<pgs::PgsModel::Particle> particles(pgs::PgsModel::PARTICLE_COUNT);
-	glm::vec2 center1(-0.3f, -0.3f);
-	glm::vec2 center2(0.3f, 0.3f);
-	float radius1 = 0.2f;
-	float radius2 = 0.2f;
-	const float velocityDamping = 0.5f;
-
-	std::default_random_engine rndEngine((unsigned)time(nullptr));
-	std::uniform_real_distribution<float> rndDist1(center1.x - radius1, center1.y + radius1);
-	std::uniform_real_distribution<float> rndDist2(center2.x - radius2, center2.y + radius2);
-
-	// First half of particles in dist1, second half in dist2
-	for (size_t i = 0; i < particles.size() / 2; i++)
+	uint32_t maxCount = maxParticleCount(device);
+	if (particleCount > maxCount)
 	{
-		pgs::PgsModel::Particle &particle1 = particles[i];
-		pgs::PgsModel::Particle &particle2 = particles[2 * i];
-
-		// Particle 1
-		particle1.position = glm::vec2(rndDist1(rndEngine), rndDist1(rndEngine));
-		float distanceToCenter1 =
-			glm::dot(center1 - particle1.position, center1 - particle1.position);
-		glm::vec2 directionPerpendicularToCenterLine1 =
-			glm::vec2(-particle1.position.y, particle1.position.x);
-		particle1.velocity =
-			distanceToCenter1 * directionPerpendicularToCenterLine1 * velocityDamping;
-
-		// Particle 2
-		particle2.position = glm::vec2(rndDist2(rndEngine), rndDist2(rndEngine));
-		float distanceToCenter2 =
-			glm::dot(center2 - particle2.position, center2 - particle2.position);
-		glm::vec2 directionPerpendicularToCenterLine2 =
-			glm::vec2(-particle2.position.y, particle2.position.x);
-		particle2.velocity =
-			distanceToCenter2 * directionPerpendicularToCenterLine2 * velocityDamping;
+		throw std::length_error(std::to_string(particleCount) + " particles exceed the " +
+								std::to_string(maxCount) + " the device can bind");
 	}
 
-	return particles;
+	std::vector<Particle> particles = generateRestrictedParticles(particleCount);
+
+	return std::make_unique<PgsModel>(device,
+									  particles,
+									  std::min(particleCount, RESTRICTED_MASSIVE_COUNT));
 }
 
-std::unique_ptr<PgsModel> PgsModel::createModel(PgsDevice &device)
+template <typename T>
+static std::unique_ptr<PgsBuffer> createStorageBuffer(PgsDevice &device,
+													  const std::vector<T> &values,
+													  PgsBuffer &stagingBuffer)
 {
-	std::vector<Particle> particles = particleDist1();
+	auto buffer = std::make_unique<PgsBuffer>(device,
+											  sizeof(T),
+											  static_cast<uint32_t>(values.size()),
+											  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+												  VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+												  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+											  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-	return std::make_unique<PgsModel>(device, particles);
+	VkDeviceSize bufferSize = sizeof(T) * values.size();
+	stagingBuffer.writeToBuffer((void *)values.data(), bufferSize);
+	device.copyBuffer(stagingBuffer.getBuffer(), buffer->getBuffer(), bufferSize);
+	return buffer;
 }
 
-void PgsModel::createVertexBuffers(const std::vector<Particle> &particles)
+void PgsModel::createStateBuffers(const std::vector<Particle> &particles)
 {
 	m_vertexCount = static_cast<uint32_t>(particles.size());
-	VkDeviceSize bufferSize = sizeof(particles[0]) * m_vertexCount;
-	uint32_t vertexSize = sizeof(particles[0]);
 
+	std::vector<glm::vec2> positions(m_vertexCount);
+	std::vector<glm::vec2> velocities(m_vertexCount);
+	// nothing has been accelerated yet
+	std::vector<float> colorValues(m_vertexCount, 0.0f);
+	std::vector<uint32_t> particleIds(m_vertexCount);
+	std::vector<float> masses(m_vertexCount);
+	for (uint32_t i = 0; i < m_vertexCount; i++)
+	{
+		positions[i] = particles[i].position;
+		velocities[i] = particles[i].velocity;
+		particleIds[i] = i;
+		masses[i] = particles[i].mass;
+	}
+
+	// large enough for the widest field, reused for every upload
 	PgsBuffer stagingBuffer{
 		m_pgsDevice,
-		vertexSize,
+		sizeof(glm::vec2),
 		m_vertexCount,
 		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
 	};
-
 	stagingBuffer.map();
-	stagingBuffer.writeToBuffer((void *)particles.data());
 
-	m_vertexBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
-												 vertexSize,
-												 m_vertexCount,
-												 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-													 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
-													 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-												 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// both states start out identical, so either one can be read first
+	for (auto &state : m_states)
+	{
+		state.positions = createStorageBuffer(m_pgsDevice, positions, stagingBuffer);
+		state.velocities = createStorageBuffer(m_pgsDevice, velocities, stagingBuffer);
+		state.colorValues = createStorageBuffer(m_pgsDevice, colorValues, stagingBuffer);
+	}
+	for (auto &ids : m_particleIds)
+	{
+		ids = createStorageBuffer(m_pgsDevice, particleIds, stagingBuffer);
+	}
+	m_massBuffer = createStorageBuffer(m_pgsDevice, masses, stagingBuffer);
+}
 
-	m_pgsDevice.copyBuffer(stagingBuffer.getBuffer(), m_vertexBuffer->getBuffer(), bufferSize);
+PgsModel::CountArgs PgsModel::countArgs(uint32_t particleCount) const
+{
+	// particle_count.comp fixes up the force groups once the kernel work group size is known
+	CountArgs args{};
+	args.particleCount = particleCount;
+	args.draw = {particleCount, 1, 0, 0};
+	uint32_t groupCount = (particleCount + PgsComputePipeline::LOCAL_SIZE_X - 1) /
+						  PgsComputePipeline::LOCAL_SIZE_X;
+	args.forceGroups =
+		PgsComputePipeline::splitGroupCount(groupCount, PgsComputePipeline::INDIRECT_MAX_GROUP_COUNT_X);
+	args.passGroups = args.forceGroups;
+	return args;
 }
 
-void PgsModel::bind(VkCommandBuffer commandBuffer)
+void PgsModel::createCountBuffer()
 {
-	VkBuffer buffers[] = {m_vertexBuffer->getBuffer()};
-	VkDeviceSize offsets[] = {0};
-	vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+	// every slot starts out live
+	CountArgs args = countArgs(m_vertexCount);
+
+	PgsBuffer stagingBuffer{m_pgsDevice,
+							sizeof(CountArgs),
+							1,
+							VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	stagingBuffer.map();
+	stagingBuffer.writeToBuffer(&args, sizeof(CountArgs));
+
+	m_countBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												sizeof(CountArgs),
+												1,
+												VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+													VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+													VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_pgsDevice.copyBuffer(stagingBuffer.getBuffer(), m_countBuffer->getBuffer(), sizeof(CountArgs));
 }
 
-void PgsModel::draw(VkCommandBuffer commandBuffer)
+template <typename T>
+static std::vector<T> readStorageBuffer(PgsDevice &device, PgsBuffer &buffer, uint32_t count)
+{
+	std::vector<T> values(count);
+	if (count == 0)
+	{
+		return values;
+	}
+
+	VkDeviceSize bufferSize = sizeof(T) * count;
+	PgsBuffer stagingBuffer{device,
+							sizeof(T),
+							count,
+							VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	device.copyBuffer(buffer.getBuffer(), stagingBuffer.getBuffer(), bufferSize);
+	stagingBuffer.map();
+	memcpy(values.data(), stagingBuffer.getMappedMemory(), bufferSize);
+	return values;
+}
+
+template <typename T>
+static void writeStorageBuffer(PgsDevice &device,
+							   const std::vector<T> &values,
+							   PgsBuffer &buffer,
+							   PgsBuffer &stagingBuffer)
 {
-	vkCmdDraw(commandBuffer, m_vertexCount, 1, 0, 0);
+	VkDeviceSize bufferSize = sizeof(T) * values.size();
+	if (bufferSize == 0)
+	{
+		return;
+	}
+	stagingBuffer.writeToBuffer((void *)values.data(), bufferSize);
+	device.copyBuffer(stagingBuffer.getBuffer(), buffer.getBuffer(), bufferSize);
 }
 
-std::vector<VkVertexInputBindingDescription> PgsModel::Particle::getBindingDescriptions()
+std::vector<PgsModel::Particle> PgsModel::readParticles()
 {
-	std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
-	bindingDescriptions[0].binding = 0;
-	bindingDescriptions[0].stride = sizeof(Particle);
-	bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-	return bindingDescriptions;
+	CountArgs args = readStorageBuffer<CountArgs>(m_pgsDevice, *m_countBuffer, 1)[0];
+	uint32_t liveCount = std::min(args.particleCount, m_vertexCount);
+
+	auto positions = readStorageBuffer<glm::vec2>(m_pgsDevice, *getCurrentState().positions, liveCount);
+	auto velocities = readStorageBuffer<glm::vec2>(m_pgsDevice, *getCurrentState().velocities, liveCount);
+	auto masses = readStorageBuffer<float>(m_pgsDevice, *m_massBuffer, liveCount);
+	auto particleIds = readStorageBuffer<uint32_t>(m_pgsDevice, getParticleIds(), liveCount);
+
+	// sorts and merges permute the slots, the ids restore creation order
+	std::vector<uint32_t> slots(liveCount);
+	for (uint32_t i = 0; i < liveCount; i++)
+	{
+		slots[i] = i;
+	}
+	std::sort(slots.begin(), slots.end(), [&](uint32_t a, uint32_t b) {
+		return particleIds[a] < particleIds[b];
+	});
+
+	std::vector<Particle> particles(liveCount);
+	for (uint32_t i = 0; i < liveCount; i++)
+	{
+		uint32_t slot = slots[i];
+		particles[i].position = positions[slot];
+		particles[i].velocity = velocities[slot];
+		particles[i].mass = masses[slot];
+	}
+	return particles;
 }
 
-std::vector<VkVertexInputAttributeDescription> PgsModel::Particle::getAttributeDescriptions()
+void PgsModel::writeParticles(const std::vector<Particle> &particles)
 {
-	std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
+	if (particles.size() > m_vertexCount)
+	{
+		throw std::length_error(std::to_string(particles.size()) + " particles exceed the " +
+								std::to_string(m_vertexCount) + " slots of the model");
+	}
+	auto particleCount = static_cast<uint32_t>(particles.size());
 
-	attributeDescriptions.push_back({0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Particle, position)});
-	attributeDescriptions.push_back({1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Particle, velocity)});
-	attributeDescriptions.push_back(
-		{2, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Particle, color)});
+	std::vector<glm::vec2> positions(particleCount);
+	std::vector<glm::vec2> velocities(particleCount);
+	std::vector<float> colorValues(particleCount, 0.0f);
+	std::vector<uint32_t> particleIds(particleCount);
+	std::vector<float> masses(particleCount);
+	for (uint32_t i = 0; i < particleCount; i++)
+	{
+		positions[i] = particles[i].position;
+		velocities[i] = particles[i].velocity;
+		particleIds[i] = i;
+		masses[i] = particles[i].mass;
+	}
+
+	// large enough for the widest field and the count arguments, reused for every upload
+	PgsBuffer stagingBuffer{
+		m_pgsDevice,
+		sizeof(glm::vec2),
+		std::max(particleCount, static_cast<uint32_t>(sizeof(CountArgs) / sizeof(glm::vec2))),
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
+	};
+	stagingBuffer.map();
 
-	return attributeDescriptions;
+	writeStorageBuffer(m_pgsDevice, positions, *getCurrentState().positions, stagingBuffer);
+	writeStorageBuffer(m_pgsDevice, velocities, *getCurrentState().velocities, stagingBuffer);
+	writeStorageBuffer(m_pgsDevice, colorValues, *getCurrentState().colorValues, stagingBuffer);
+	writeStorageBuffer(m_pgsDevice, masses, *m_massBuffer, stagingBuffer);
+	for (auto &ids : m_particleIds)
+	{
+		writeStorageBuffer(m_pgsDevice, particleIds, *ids, stagingBuffer);
+	}
+	std::vector<CountArgs> args{countArgs(particleCount)};
+	writeStorageBuffer(m_pgsDevice, args, *m_countBuffer, stagingBuffer);
+}
+
+void PgsModel::draw(VkCommandBuffer commandBuffer)
+{
+	// no vertex buffers are bound, particle.vert pulls its attributes by gl_VertexIndex,
+	// the vertex count is the live particle count on the GPU
+	vkCmdDrawIndirect(commandBuffer,
+					  m_countBuffer->getBuffer(),
+					  DRAW_ARGS_OFFSET,
+					  1,
+					  sizeof(VkDrawIndirectCommand));
 }
 } // namespace pgs
@@ -2,6 +2,7 @@
 
 #include "pgs_buffer.hpp"
 #include "pgs_device.hpp"
+#include "pgs_particles.hpp"
 
 // libs
 #define GLM_FORCE_RADIANS
@@ -9,6 +10,8 @@
 #include <glm/glm.hpp>
 
 // std
+#include <array>
+#include <cstddef>
 #include <memory>
 #include <vector>
 
@@ -17,45 +20,151 @@ namespace pgs
 class PgsModel
 {
   public:
-	struct Particle
-	{
-		glm::vec2 position{};
-		glm::vec2 velocity{};
-		glm::vec4 color{};
+	// see pgs_particles.hpp, shared with the backends that need no device
+	using Particle = pgs::Particle;
 
-		static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
-		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	// One particle state in structure of arrays layout, bound to the compute
+	// shaders as storage buffers and pulled by index in the vertex shader
+	struct StateBuffers
+	{
+		std::unique_ptr<PgsBuffer> positions; // vec2
+		std::unique_ptr<PgsBuffer> velocities; // vec2
+		std::unique_ptr<PgsBuffer> colorValues; // float, see shaders/particle.vert
+	};
 
-		bool operator==(const Particle &other) const
-		{
-			return position == other.position && velocity == other.velocity;
-		}
+	// Live particle count and the indirect arguments derived from it, kept in a GPU
+	// buffer so passes that add or remove particles need no CPU round trip. Must
+	// match particle_count.comp, which rewrites the arguments after such a pass.
+	struct CountArgs
+	{
+		uint32_t particleCount;
+		uint32_t padding0[3];
+		VkDrawIndirectCommand draw;
+		VkDispatchIndirectCommand forceGroups; // work groups of the all-pairs kernels
+		uint32_t padding1;
+		VkDispatchIndirectCommand passGroups; // work groups of LOCAL_SIZE_X passes
+		uint32_t padding2;
 	};
+	static constexpr VkDeviceSize DRAW_ARGS_OFFSET = offsetof(CountArgs, draw);
+	static constexpr VkDeviceSize FORCE_GROUPS_OFFSET = offsetof(CountArgs, forceGroups);
+	static constexpr VkDeviceSize PASS_GROUPS_OFFSET = offsetof(CountArgs, passGroups);
 
-	static constexpr uint32_t PARTICLE_COUNT = 256 * 256;
+	static constexpr uint32_t DEFAULT_PARTICLE_COUNT = pgs::DEFAULT_PARTICLE_COUNT;
+	// central body and companion of createRestrictedModel
+	static constexpr uint32_t RESTRICTED_MASSIVE_COUNT = pgs::RESTRICTED_MASSIVE_COUNT;
+	// particle state is double buffered, every step reads one buffer and writes the other
+	static constexpr uint32_t STATE_BUFFER_COUNT = 2;
 
-	PgsModel(PgsDevice &device, const std::vector<Particle> &particles);
+	static constexpr float GRAV_CONSTANT = pgs::GRAV_CONSTANT;
+	static constexpr float DAMP = pgs::DAMP;
+
+	// The first massiveCount particles are the massive bodies of the restricted solver
+	PgsModel(PgsDevice &device, const std::vector<Particle> &particles, uint32_t massiveCount = 0);
 	~PgsModel();
 
 	PgsModel(const PgsModel &) = delete;
 	PgsModel &operator=(const PgsModel &) = delete;
 
-	static std::unique_ptr<PgsModel> createModel(PgsDevice &device);
-	std::unique_ptr<PgsBuffer> &getVertexBuffer()
+	// Most particles whose per-particle buffers of elementSize bytes still fit one
+	// storage buffer binding and one allocation on this device, the default is the
+	// widest state field (vec2). See ParticleSystem::maxParticleCount for the
+	// buffers of the solvers and integrators.
+	static uint32_t maxParticleCount(PgsDevice &device, VkDeviceSize elementSize = sizeof(glm::vec2));
+	static std::unique_ptr<PgsModel> createModel(PgsDevice &device,
+												 uint32_t particleCount = DEFAULT_PARTICLE_COUNT);
+	// A central body and a companion on a circular orbit, surrounded by a disk of
+	// massless tracers on circular orbits, for ParticleSystem::ForceSolver::Restricted
+	static std::unique_ptr<PgsModel> createRestrictedModel(
+		PgsDevice &device,
+		uint32_t particleCount = DEFAULT_PARTICLE_COUNT);
+	// The latest particle state, read by the next step and drawn
+	StateBuffers &getCurrentState()
+	{
+		return m_states[m_stateIndex];
+	}
+	StateBuffers &getState(uint32_t index)
+	{
+		return m_states[index];
+	}
+	uint32_t getStateIndex() const
+	{
+		return m_stateIndex;
+	}
+	// Call after recording a step so the state it wrote becomes the current one
+	void swapStateBuffers()
+	{
+		m_stateIndex = (m_stateIndex + 1) % STATE_BUFFER_COUNT;
+	}
+
+	// Original index of the particle in every slot of the current state. Steps keep
+	// the slot order, only SpatialSortSystem reorders slots, so consumers that track
+	// individual particles look them up through these buffers. Double buffered like
+	// the state, but swapped only by a reorder.
+	PgsBuffer &getParticleIds()
+	{
+		return *m_particleIds[m_particleIdIndex];
+	}
+	PgsBuffer &getParticleIdBuffer(uint32_t index)
+	{
+		return *m_particleIds[index];
+	}
+	uint32_t getParticleIdIndex() const
+	{
+		return m_particleIdIndex;
+	}
+	void swapParticleIdBuffers()
+	{
+		m_particleIdIndex = (m_particleIdIndex + 1) % STATE_BUFFER_COUNT;
+	}
+
+	// Particle slots in the state buffers, an upper bound of the live count on the
+	// GPU, which starts out equal to it
+	uint32_t getParticleCount() const
 	{
-		return m_vertexBuffer;
+		return m_vertexCount;
+	}
+	// Massive bodies of the restricted solver, they occupy the leading slots
+	uint32_t getMassiveCount() const
+	{
+		return m_massiveCount;
+	}
+	// float per slot, bound to the global descriptor sets. Not double buffered since
+	// steps never change it, passes that reorder slots gather it into a scratch
+	// buffer and copy it back.
+	PgsBuffer &getMassBuffer()
+	{
+		return *m_massBuffer;
+	}
+	// CountArgs, bound to the global descriptor sets and read by indirect commands
+	PgsBuffer &getCountBuffer()
+	{
+		return *m_countBuffer;
 	}
 
-	void bind(VkCommandBuffer commandBuffer);
 	void draw(VkCommandBuffer commandBuffer);
 
+	// Blocking readback of the live particles of the current state, ordered by particle
+	// id (creation order); particles merged away are missing. The device must be idle.
+	std::vector<Particle> readParticles();
+	// Blocking upload that replaces the current state, the masses and the live count,
+	// and restarts the particle ids. At most getParticleCount() particles, the device
+	// must be idle. Call ParticleSystem::invalidateState afterwards.
+	void writeParticles(const std::vector<Particle> &particles);
+
   private:
-	void createVertexBuffers(const std::vector<Particle> &particles);
+	void createStateBuffers(const std::vector<Particle> &particles);
+	void createCountBuffer();
+	CountArgs countArgs(uint32_t particleCount) const;
 
 	PgsDevice &m_pgsDevice;
 
-	std::vector<Particle> m_vertices{};
-	std::unique_ptr<PgsBuffer> m_vertexBuffer;
+	std::array<StateBuffers, STATE_BUFFER_COUNT> m_states;
+	uint32_t m_stateIndex{0};
+	std::array<std::unique_ptr<PgsBuffer>, STATE_BUFFER_COUNT> m_particleIds;
+	uint32_t m_particleIdIndex{0};
+	std::unique_ptr<PgsBuffer> m_massBuffer;
+	std::unique_ptr<PgsBuffer> m_countBuffer;
 	uint32_t m_vertexCount;
+	uint32_t m_massiveCount;
 };
 } // namespace pgs
@@ -0,0 +1,142 @@
+#include "pgs_particles.hpp"
+
+// std
+#include <cmath>
+#include <ctime>
+#include <random>
+
+namespace pgs
+{
+
+// One circle centered about the origin
+std::vector<Particle> particleDist1(uint32_t particleCount)
+{
+	const double TWO_PI = 6.2831853071795864769;
+	const float radius = 0.5f;
+	const float multiplier = 2.5f;
+	std::default_random_engine rndEngine((unsigned)time(nullptr));
+	std::uniform_real_distribution<float> rndDistribution(0.0f, 1.0f);
+
+	std::vector<Particle> particles(particleCount);
+	for (auto &particle : particles)
+	{
+		float r = radius * sqrt(rndDistribution(rndEngine));
+		float theta = rndDistribution(rndEngine) * TWO_PI;
+		particle.position = glm::vec2(r * cos(theta), r * sin(theta));
+		float distanceToCenter = glm::dot(particle.position, particle.position);
+		glm::vec2 directionPerpendicularToCenterLine =
+			glm::vec2(-particle.position.y, particle.position.x);
+		particle.velocity = distanceToCenter * directionPerpendicularToCenterLine * multiplier;
+	}
+
+	return particles;
+}
+
+// Two seperate squares
+std::vector<Particle> particleDist2(uint32_t particleCount)
+{
+	std::vector<Particle> particles(particleCount);
+	glm::vec2 center1(-0.3f, -0.3f);
+	glm::vec2 center2(0.3f, 0.3f);
+	float radius1 = 0.2f;
+	float radius2 = 0.2f;
+	const float velocityDamping = 0.5f;
+
+	std::default_random_engine rndEngine((unsigned)time(nullptr));
+	std::uniform_real_distribution<float> rndDist1(center1.x - radius1, center1.y + radius1);
+	std::uniform_real_distribution<float> rndDist2(center2.x - radius2, center2.y + radius2);
+
+	// First half of particles in dist1, second half in dist2
+	for (size_t i = 0; i < particles.size() / 2; i++)
+	{
+		Particle &particle1 = particles[i];
+		Particle &particle2 = particles[2 * i];
+
+		// Particle 1
+		particle1.position = glm::vec2(rndDist1(rndEngine), rndDist1(rndEngine));
+		float distanceToCenter1 =
+			glm::dot(center1 - particle1.position, center1 - particle1.position);
+		glm::vec2 directionPerpendicularToCenterLine1 =
+			glm::vec2(-particle1.position.y, particle1.position.x);
+		particle1.velocity =
+			distanceToCenter1 * directionPerpendicularToCenterLine1 * velocityDamping;
+
+		// Particle 2
+		particle2.position = glm::vec2(rndDist2(rndEngine), rndDist2(rndEngine));
+		float distanceToCenter2 =
+			glm::dot(center2 - particle2.position, center2 - particle2.position);
+		glm::vec2 directionPerpendicularToCenterLine2 =
+			glm::vec2(-particle2.position.y, particle2.position.x);
+		particle2.velocity =
+			distanceToCenter2 * directionPerpendicularToCenterLine2 * velocityDamping;
+	}
+
+	return particles;
+}
+
+// A central body and a companion, surrounded by a disk of tracers on circular
+// orbits about the central body. Masses are in units of the default particle.
+std::vector<Particle> particleDistRestricted(uint32_t particleCount)
+{
+	const double TWO_PI = 6.2831853071795864769;
+	const float centralMass = 100000.0f;
+	const float companionMass = 5000.0f;
+	const float companionRadius = 0.35f;
+	const float innerRadius = 0.05f;
+	const float outerRadius = 0.5f;
+	std::default_random_engine rndEngine((unsigned)time(nullptr));
+	std::uniform_real_distribution<float> rndDistribution(0.0f, 1.0f);
+
+	// speed of a circular orbit at radius r about a softened point mass
+	auto circularSpeed = [](float mass, float r) {
+		float r2 = r * r + DAMP;
+		return sqrt(GRAV_CONSTANT * mass * r * r / (r2 * sqrt(r2)));
+	};
+
+	std::vector<Particle> particles(particleCount);
+	if (particleCount == 0)
+	{
+		return particles;
+	}
+	particles[0].mass = centralMass;
+	if (particleCount > 1)
+	{
+		// the pair orbits their common center of mass, which stays at rest
+		float totalMass = centralMass + companionMass;
+		float relativeSpeed = circularSpeed(totalMass, companionRadius);
+		particles[1].mass = companionMass;
+		particles[1].position = glm::vec2(companionRadius * centralMass / totalMass, 0.0f);
+		particles[1].velocity = glm::vec2(0.0f, relativeSpeed * centralMass / totalMass);
+		particles[0].position = glm::vec2(-companionRadius * companionMass / totalMass, 0.0f);
+		particles[0].velocity = glm::vec2(0.0f, -relativeSpeed * companionMass / totalMass);
+	}
+
+	for (uint32_t i = RESTRICTED_MASSIVE_COUNT; i < particleCount; i++)
+	{
+		auto &particle = particles[i];
+		// uniform in area between the inner and outer radius
+		float u = rndDistribution(rndEngine);
+		float r = sqrt(innerRadius * innerRadius +
+							u * (outerRadius * outerRadius - innerRadius * innerRadius));
+		float theta = rndDistribution(rndEngine) * TWO_PI;
+		glm::vec2 direction(cos(theta), sin(theta));
+		particle.position = particles[0].position + r * direction;
+		particle.velocity = particles[0].velocity +
+							circularSpeed(centralMass, r) * glm::vec2(-direction.y, direction.x);
+		particle.mass = 0.0f;
+	}
+
+	return particles;
+}
+
+std::vector<Particle> generateParticles(uint32_t particleCount)
+{
+	return particleDist1(particleCount);
+}
+
+std::vector<Particle> generateRestrictedParticles(uint32_t particleCount)
+{
+	return particleDistRestricted(particleCount);
+}
+
+} // namespace pgs
@@ -0,0 +1,45 @@
+#pragma once
+
+// libs
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// std
+#include <cstdint>
+#include <vector>
+
+namespace pgs
+{
+// Initial conditions and physics constants shared by every backend. Needs no window or
+// Vulkan device, so the headless build compiles against this header alone.
+
+// Initial conditions of one particle. On the GPU the fields live in separate buffers,
+// see PgsModel::StateBuffers.
+struct Particle
+{
+	glm::vec2 position{};
+	glm::vec2 velocity{};
+	// in units of the default particle, tracers of the restricted solver have none
+	float mass{1.0f};
+
+	bool operator==(const Particle &other) const
+	{
+		return position == other.position && velocity == other.velocity && mass == other.mass;
+	}
+};
+
+constexpr uint32_t DEFAULT_PARTICLE_COUNT = 256 * 256;
+// central body and companion of generateRestrictedParticles
+constexpr uint32_t RESTRICTED_MASSIVE_COUNT = 2;
+
+// must match gravity_common.glsl
+constexpr float GRAV_CONSTANT = 0.000001f;
+constexpr float DAMP = 0.0005f;
+
+// One disk of particles about the origin, the distribution of PgsModel::createModel
+std::vector<Particle> generateParticles(uint32_t particleCount = DEFAULT_PARTICLE_COUNT);
+// A central body and a companion on a circular orbit, surrounded by a disk of massless
+// tracers on circular orbits. The first RESTRICTED_MASSIVE_COUNT particles are massive.
+std::vector<Particle> generateRestrictedParticles(uint32_t particleCount = DEFAULT_PARTICLE_COUNT);
+} // namespace pgs
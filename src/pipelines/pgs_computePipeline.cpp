@@ -4,19 +4,78 @@
 #include "pgs_model.hpp"
 
 // std
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 
 namespace pgs
 {
 
+PgsComputePipeline::Specialization &PgsComputePipeline::Specialization::setUint(uint32_t constantId,
+																			   uint32_t value)
+{
+	for (auto &entry : m_entries)
+	{
+		if (entry.constantID == constantId)
+		{
+			m_data[entry.offset / sizeof(uint32_t)] = value;
+			return *this;
+		}
+	}
+
+	VkSpecializationMapEntry entry{};
+	entry.constantID = constantId;
+	entry.offset = static_cast<uint32_t>(m_data.size() * sizeof(uint32_t));
+	entry.size = sizeof(uint32_t);
+	m_entries.push_back(entry);
+	m_data.push_back(value);
+	return *this;
+}
+
+PgsComputePipeline::Specialization &PgsComputePipeline::Specialization::setFloat(uint32_t constantId,
+																				float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return setUint(constantId, bits);
+}
+
+PgsComputePipeline::Specialization &PgsComputePipeline::Specialization::setLocalSizeX(
+	uint32_t localSizeX)
+{
+	assert(localSizeX > 0 && "Work group size must be positive");
+	m_localSizeX = localSizeX;
+	return setUint(LOCAL_SIZE_X_CONSTANT_ID, localSizeX);
+}
+
+VkSpecializationInfo PgsComputePipeline::Specialization::getInfo() const
+{
+	VkSpecializationInfo info{};
+	info.mapEntryCount = static_cast<uint32_t>(m_entries.size());
+	info.pMapEntries = m_entries.data();
+	info.dataSize = m_data.size() * sizeof(uint32_t);
+	info.pData = m_data.data();
+	return info;
+}
+
+PgsComputePipeline::Specialization PgsComputePipeline::gravityConstants()
+{
+	Specialization specialization{};
+	specialization.setFloat(GRAV_CONSTANT_CONSTANT_ID, PgsModel::GRAV_CONSTANT)
+		.setFloat(DAMP_CONSTANT_ID, PgsModel::DAMP);
+	return specialization;
+}
+
 PgsComputePipeline::PgsComputePipeline(PgsDevice &device,
 						 const std::string &compFilepath,
-						 const VkPipelineLayout &pipelineLayout)
-	: m_pgsDevice{device}
+						 const VkPipelineLayout &pipelineLayout,
+						 const Specialization &specialization,
+						 uint32_t requiredSubgroupSize)
+	: m_pgsDevice{device}, m_localSizeX{specialization.getLocalSizeX()}
 {
-	createComputePipeline(compFilepath, pipelineLayout);
+	createComputePipeline(compFilepath, pipelineLayout, specialization, requiredSubgroupSize);
 }
 
 PgsComputePipeline::~PgsComputePipeline()
@@ -26,7 +85,9 @@ PgsComputePipeline::~PgsComputePipeline()
 }
 
 void PgsComputePipeline::createComputePipeline(const std::string &compFilepath,
-										 const VkPipelineLayout &pipelineLayout)
+										 const VkPipelineLayout &pipelineLayout,
+										 const Specialization &specialization,
+										 uint32_t requiredSubgroupSize)
 {
 	assert(pipelineLayout != VK_NULL_HANDLE &&
 		   "Cannot create graphics pipeline: no pipelineLayout provided in "
@@ -40,6 +101,24 @@ void PgsComputePipeline::createComputePipeline(const std::string &compFilepath,
 	shaderStage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
 	shaderStage.module = m_compShaderModule;
 	shaderStage.pName = "main";
+	// always specialize the work group size, so compute() and the shader agree on it
+	Specialization resolved = specialization;
+	resolved.setLocalSizeX(specialization.getLocalSizeX());
+	VkSpecializationInfo specializationInfo = resolved.getInfo();
+	shaderStage.pSpecializationInfo = &specializationInfo;
+
+	VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT subgroupSizeInfo{};
+	subgroupSizeInfo.sType =
+		VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO_EXT;
+	if (requiredSubgroupSize != 0)
+	{
+		assert(m_pgsDevice.subgroupSupport.sizeControl && "Subgroup size control is not enabled");
+		assert(m_localSizeX % requiredSubgroupSize == 0 &&
+			   "Full subgroups need a work group size that is a multiple of the subgroup size");
+		subgroupSizeInfo.requiredSubgroupSize = requiredSubgroupSize;
+		shaderStage.pNext = &subgroupSizeInfo;
+		shaderStage.flags |= VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT;
+	}
 
 	VkComputePipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -75,9 +154,168 @@ void PgsComputePipeline::bind(VkCommandBuffer commandBuffer)
 	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_computePipeline);
 }
 
-void PgsComputePipeline::compute(VkCommandBuffer commandBuffer)
+VkDispatchIndirectCommand PgsComputePipeline::splitGroupCount(uint64_t groupCount,
+															   uint32_t maxGroupCountX)
 {
-	vkCmdDispatch(commandBuffer, PgsModel::PARTICLE_COUNT / 256, 1, 1);
+	// as few rows as possible, evenly filled so at most one group per row is idle
+	uint64_t rows = std::max<uint64_t>((groupCount + maxGroupCountX - 1) / maxGroupCountX, 1);
+	VkDispatchIndirectCommand command{};
+	command.x = static_cast<uint32_t>((groupCount + rows - 1) / rows);
+	command.y = static_cast<uint32_t>(rows);
+	command.z = 1;
+	return command;
+}
+
+void PgsComputePipeline::compute(VkCommandBuffer commandBuffer, uint32_t particleCount)
+{
+	uint64_t groupCount = (static_cast<uint64_t>(particleCount) + m_localSizeX - 1) / m_localSizeX;
+	dispatchLinear(commandBuffer, groupCount);
+}
+
+void PgsComputePipeline::dispatchLinear(VkCommandBuffer commandBuffer, uint64_t groupCount)
+{
+	const auto &maxGroupCount = m_pgsDevice.properties.limits.maxComputeWorkGroupCount;
+	VkDispatchIndirectCommand groups = splitGroupCount(groupCount, maxGroupCount[0]);
+	if (groups.y > maxGroupCount[1])
+	{
+		throw std::length_error("dispatch of " + std::to_string(groupCount) +
+								" work groups exceeds maxComputeWorkGroupCount");
+	}
+	vkCmdDispatch(commandBuffer, groups.x, groups.y, groups.z);
+}
+
+void PgsComputePipeline::dispatch(VkCommandBuffer commandBuffer,
+								  uint32_t groupCountX,
+								  uint32_t groupCountY,
+								  uint32_t groupCountZ)
+{
+	vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+}
+
+void PgsComputePipeline::dispatchIndirect(VkCommandBuffer commandBuffer,
+										  VkBuffer buffer,
+										  VkDeviceSize offset)
+{
+	vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+void PgsComputePipeline::computeBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+void PgsComputePipeline::indirectBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT |
+							VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+void PgsComputePipeline::computeToTransferBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+void PgsComputePipeline::transferToComputeBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+void PgsComputePipeline::stepBeginBarrier(VkCommandBuffer commandBuffer)
+{
+	// the first scope covers everything submitted earlier on the queue, including
+	// frames still in flight that draw from or write to the buffers this step uses
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+							 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+}
+
+void PgsComputePipeline::computeToVertexBarrier(VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	// the draw reads its vertex count from PgsModel's count buffer
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
 }
 
 } // namespace pgs
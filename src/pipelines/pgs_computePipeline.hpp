@@ -12,25 +12,108 @@ namespace pgs
 class PgsComputePipeline
 {
   public:
+	// default work group size, must match local_size_x of shaders that fix it
+	static constexpr uint32_t LOCAL_SIZE_X = 256;
+
+	// constant_id 0 is reserved for the work group size of shaders that declare
+	// layout(local_size_x_id = 0), see Specialization::setLocalSizeX
+	static constexpr uint32_t LOCAL_SIZE_X_CONSTANT_ID = 0;
+	// constant_ids of the physics constants in gravity_common.glsl
+	static constexpr uint32_t GRAV_CONSTANT_CONSTANT_ID = 1;
+	static constexpr uint32_t DAMP_CONSTANT_ID = 2;
+	// constant_id of the all-pairs inner loop unroll factor
+	static constexpr uint32_t UNROLL_CONSTANT_ID = 3;
+	// constant_id of KERNEL_MODE, selects whether the all-pairs kernels integrate
+	// or only write accelerations (and jerks), see gravity_common.glsl
+	static constexpr uint32_t KERNEL_MODE_CONSTANT_ID = 4;
+
+	// Guaranteed minimum of maxComputeWorkGroupCount[0], the row length of dispatch
+	// arguments written on the GPU; must match MAX_GROUP_COUNT_X in dispatch_common.glsl
+	static constexpr uint32_t INDIRECT_MAX_GROUP_COUNT_X = 65535;
+
+	// 32 bit specialization constants baked into a pipeline at creation, so the
+	// driver can fold them into the kernel
+	class Specialization
+	{
+	  public:
+		Specialization &setUint(uint32_t constantId, uint32_t value);
+		Specialization &setFloat(uint32_t constantId, float value);
+		Specialization &setLocalSizeX(uint32_t localSizeX);
+
+		uint32_t getLocalSizeX() const
+		{
+			return m_localSizeX;
+		}
+		// only valid while this Specialization is alive and unchanged
+		VkSpecializationInfo getInfo() const;
+
+	  private:
+		std::vector<VkSpecializationMapEntry> m_entries;
+		std::vector<uint32_t> m_data;
+		uint32_t m_localSizeX{LOCAL_SIZE_X};
+	};
+
+	// GRAV_CONSTANT and damp from PgsModel, for every shader that includes gravity_common.glsl
+	static Specialization gravityConstants();
+
+	// A non-zero requiredSubgroupSize pins the subgroup size and requires full
+	// subgroups, only valid when PgsDevice::subgroupSupport.sizeControl is set
 	PgsComputePipeline(PgsDevice &device,
 				const std::string &compFilepath,
-				const VkPipelineLayout &pipelineLayout);
+				const VkPipelineLayout &pipelineLayout,
+				const Specialization &specialization = Specialization{},
+				uint32_t requiredSubgroupSize = 0);
 	~PgsComputePipeline();
 
 	PgsComputePipeline(const PgsComputePipeline &) = delete;
 	PgsComputePipeline &operator=(const PgsComputePipeline &) = delete;
 
+	// Spreads groupCount work groups over rows of at most maxGroupCountX, shaders
+	// recover the linear index with the helpers in dispatch_common.glsl
+	static VkDispatchIndirectCommand splitGroupCount(uint64_t groupCount, uint32_t maxGroupCountX);
+
 	void bind(VkCommandBuffer commandBuffer);
-	void compute(VkCommandBuffer commandBuffer);
+	// Dispatches enough work groups of getLocalSizeX() invocations to cover particleCount
+	void compute(VkCommandBuffer commandBuffer, uint32_t particleCount);
+	// Dispatches groupCount work groups, on a 2D grid once they exceed the device's
+	// maxComputeWorkGroupCount[0]
+	void dispatchLinear(VkCommandBuffer commandBuffer, uint64_t groupCount);
+	void dispatch(VkCommandBuffer commandBuffer,
+				  uint32_t groupCountX,
+				  uint32_t groupCountY = 1,
+				  uint32_t groupCountZ = 1);
+	// Dispatches the VkDispatchIndirectCommand at offset in buffer, written by an earlier pass
+	void dispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset = 0);
+
+	// Makes shader writes of previous dispatches visible to the following dispatches
+	static void computeBarrier(VkCommandBuffer commandBuffer);
+	// computeBarrier that also covers dispatch arguments written by shaders
+	static void indirectBarrier(VkCommandBuffer commandBuffer);
+	// Orders buffer copies after the shader writes they read, and the following
+	// dispatches after the copies
+	static void computeToTransferBarrier(VkCommandBuffer commandBuffer);
+	static void transferToComputeBarrier(VkCommandBuffer commandBuffer);
+
+	uint32_t getLocalSizeX() const
+	{
+		return m_localSizeX;
+	}
+	// Orders a step after the draws and shader writes of earlier frames on the queue
+	static void stepBeginBarrier(VkCommandBuffer commandBuffer);
+	// Makes the particle state and count written by a step visible to the draw
+	static void computeToVertexBarrier(VkCommandBuffer commandBuffer);
 
   private:
 	void createComputePipeline(const std::string &compFilepath,
-								const VkPipelineLayout &pipelineLayout);
+								const VkPipelineLayout &pipelineLayout,
+								const Specialization &specialization,
+								uint32_t requiredSubgroupSize);
 
 	void createShaderModule(const std::vector<char> &code, VkShaderModule *shaderModule);
 
 	PgsDevice &m_pgsDevice;
 	VkPipeline m_computePipeline;
 	VkShaderModule m_compShaderModule;
+	uint32_t m_localSizeX;
 };
 } // namespace pgs
@@ -1,6 +1,5 @@
 #include "pgs_graphicsPipeline.hpp"
 #include "../pgs_utils.hpp"
-#include "pgs_model.hpp"
 
 // std
 #include <cassert>
@@ -59,16 +58,13 @@ void PgsGraphicsPipeline::createGraphicsPipeline(const std::string &vertFilepath
 	shaderStages[1].pNext = nullptr;
 	shaderStages[1].pSpecializationInfo = nullptr;
 
-	auto bindingDescriptions = PgsModel::Particle::getBindingDescriptions();
-	auto attributeDescriptions = PgsModel::Particle::getAttributeDescriptions();
+	// the vertex shader pulls particle attributes from storage buffers
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputInfo.vertexAttributeDescriptionCount =
-		static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.vertexBindingDescriptionCount =
-		static_cast<uint32_t>(bindingDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-	vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
+	vertexInputInfo.vertexAttributeDescriptionCount = 0;
+	vertexInputInfo.vertexBindingDescriptionCount = 0;
+	vertexInputInfo.pVertexAttributeDescriptions = nullptr;
+	vertexInputInfo.pVertexBindingDescriptions = nullptr;
 
 	VkGraphicsPipelineCreateInfo pipelineInfo{};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
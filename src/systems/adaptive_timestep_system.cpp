@@ -0,0 +1,213 @@
+#include "adaptive_timestep_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+namespace pgs
+{
+
+// must match ReducePush in timestep_reduce.comp
+struct ReducePushConstants
+{
+	uint32_t particleCount;
+	uint32_t slot;
+};
+
+struct ReduceResult
+{
+	float maxAcceleration;
+	float maxSpeed;
+};
+
+AdaptiveTimestepSystem::AdaptiveTimestepSystem(PgsDevice &device, uint32_t slotCount)
+	: m_pgsDevice{device}, m_slotWritten(slotCount, false)
+{
+	m_resultBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												 sizeof(ReduceResult),
+												 slotCount,
+												 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+													 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	m_resultBuffer->map();
+
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	m_reducePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/timestep_reduce.comp.spv",
+															m_pipelineLayout);
+}
+
+AdaptiveTimestepSystem::~AdaptiveTimestepSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void AdaptiveTimestepSystem::createDescriptorSetLayout()
+{
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+}
+
+void AdaptiveTimestepSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(ReducePushConstants);
+
+	VkDescriptorSetLayout descriptorSetLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create adaptive timestep pipeline layout!");
+	}
+}
+
+void AdaptiveTimestepSystem::bindState(PgsModel &model)
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(PgsModel::STATE_BUFFER_COUNT)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+										4 * PgsModel::STATE_BUFFER_COUNT)
+						   .build();
+
+	auto resultInfo = m_resultBuffer->descriptorInfo();
+	auto countInfo = model.getCountBuffer().descriptorInfo();
+	m_countBuffer = model.getCountBuffer().getBuffer();
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto velocityInfo = model.getState(state).velocities->descriptorInfo();
+		auto colorValueInfo = model.getState(state).colorValues->descriptorInfo();
+		auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+						  .writeBuffer(0, &velocityInfo)
+						  .writeBuffer(1, &colorValueInfo)
+						  .writeBuffer(2, &resultInfo)
+						  .writeBuffer(3, &countInfo)
+						  .build(m_descriptorSets[state]);
+		assert(result && "Failed to build adaptive timestep descriptor set!");
+	}
+}
+
+void AdaptiveTimestepSystem::setParameters(float accuracy, float minDt, float maxDt)
+{
+	assert(minDt > 0.0f && minDt <= maxDt && "Invalid time step range");
+	m_accuracy = accuracy;
+	m_minDt = minDt;
+	m_maxDt = maxDt;
+}
+
+void AdaptiveTimestepSystem::recordReduction(VkCommandBuffer commandBuffer,
+											 uint32_t slot,
+											 uint32_t stateIndex,
+											 uint32_t particleCount)
+{
+	assert(slot < m_slotWritten.size() && "Slot out of range");
+	assert(m_descriptorSets[stateIndex] != VK_NULL_HANDLE && "bindState was not called");
+
+	vkCmdFillBuffer(commandBuffer,
+					m_resultBuffer->getBuffer(),
+					slot * sizeof(ReduceResult),
+					sizeof(ReduceResult),
+					0);
+
+	// the fill and the last step's writes have to land before the reduction reads
+	VkMemoryBarrier beginBarrier{};
+	beginBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	beginBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	beginBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &beginBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	m_reducePipeline->bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							1,
+							&m_descriptorSets[stateIndex],
+							0,
+							nullptr);
+
+	ReducePushConstants push{};
+	push.particleCount = particleCount;
+	push.slot = slot;
+	vkCmdPushConstants(commandBuffer,
+					   m_pipelineLayout,
+					   VK_SHADER_STAGE_COMPUTE_BIT,
+					   0,
+					   sizeof(ReducePushConstants),
+					   &push);
+	// over the live particles, merges leave stale state in the slots past them
+	m_reducePipeline->dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::PASS_GROUPS_OFFSET);
+
+	VkMemoryBarrier hostBarrier{};
+	hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_HOST_BIT,
+						 0,
+						 1,
+						 &hostBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	m_slotWritten[slot] = true;
+}
+
+float AdaptiveTimestepSystem::readTimestep(uint32_t slot, float fallbackDt)
+{
+	assert(slot < m_slotWritten.size() && "Slot out of range");
+	if (!m_slotWritten[slot])
+	{
+		return fallbackDt;
+	}
+
+	ReduceResult result;
+	memcpy(&result,
+		   static_cast<const char *>(m_resultBuffer->getMappedMemory()) + slot * sizeof(ReduceResult),
+		   sizeof(ReduceResult));
+
+	float softening = std::sqrt(PgsModel::DAMP);
+	float dt = m_maxDt;
+	if (result.maxAcceleration > 0.0f)
+	{
+		dt = std::min(dt, m_accuracy * std::sqrt(softening / result.maxAcceleration));
+	}
+	if (result.maxSpeed > 0.0f)
+	{
+		dt = std::min(dt, m_accuracy * softening / result.maxSpeed);
+	}
+	return std::max(dt, m_minDt);
+}
+
+} // namespace pgs
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pgs_model.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace pgs
+{
+
+/*
+ * Global adaptive time step. A reduction pass finds the largest acceleration and
+ * speed of the state a frame ends with and writes them to a host visible slot of
+ * that frame. When the frame's slot comes around again its fence has been waited
+ * on, so the host reads the result without stalling and picks the step
+ *   dt = accuracy * min(sqrt(softening / max|a|), softening / max|v|)
+ * clamped to [minDt, maxDt]. The step therefore lags the state by the number of
+ * frames in flight.
+ */
+class AdaptiveTimestepSystem
+{
+  public:
+	static constexpr float DEFAULT_ACCURACY = 0.05f;
+
+	AdaptiveTimestepSystem(PgsDevice &device, uint32_t slotCount);
+	~AdaptiveTimestepSystem();
+
+	AdaptiveTimestepSystem(const AdaptiveTimestepSystem &) = delete;
+	AdaptiveTimestepSystem &operator=(const AdaptiveTimestepSystem &) = delete;
+
+	// Creates the per-state descriptor sets over the model's velocities and color values
+	void bindState(PgsModel &model);
+	void setParameters(float accuracy, float minDt, float maxDt);
+
+	// Reduces the state stateIndex into slot, recorded after the frame's steps
+	void recordReduction(VkCommandBuffer commandBuffer,
+						 uint32_t slot,
+						 uint32_t stateIndex,
+						 uint32_t particleCount);
+	// Step picked from the last reduction into slot, whose frame must have finished,
+	// or fallbackDt if nothing was reduced into it yet
+	float readTimestep(uint32_t slot, float fallbackDt);
+
+  private:
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+
+	PgsDevice &m_pgsDevice;
+	float m_accuracy{DEFAULT_ACCURACY};
+	float m_minDt{0.0f};
+	float m_maxDt{0.0f};
+
+	std::unique_ptr<PgsBuffer> m_resultBuffer;
+	std::vector<bool> m_slotWritten;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	// indexed by the state that is reduced
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> m_descriptorSets{};
+	// the bound model's CountArgs, the reduction is dispatched over its live count
+	VkBuffer m_countBuffer{VK_NULL_HANDLE};
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_reducePipeline;
+};
+
+} // namespace pgs
@@ -0,0 +1,319 @@
+#include "barnes_hut_system.hpp"
+
+#include "../pgs_model.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace pgs
+{
+
+struct BarnesHutPushConstants
+{
+	uint32_t particleCount;
+	float openingAngle;
+};
+
+// must match BhNode in barnes_hut_common.glsl
+struct BhNode
+{
+	glm::vec4 bounds;
+	glm::vec2 com;
+	float mass;
+	uint32_t parent;
+	uint32_t left;
+	uint32_t right;
+	uint32_t visits;
+	uint32_t padding;
+};
+static_assert(sizeof(BhNode) == BarnesHutSystem::NODE_SIZE, "BhNode size changed");
+
+BarnesHutSystem::BarnesHutSystem(PgsDevice &device,
+								 VkDescriptorSetLayout globalSetLayout,
+								 uint32_t maxParticleCount)
+	: m_pgsDevice{device}, m_maxParticleCount{maxParticleCount}
+{
+	createBuffers();
+	createDescriptorSet();
+	createPipelineLayout(globalSetLayout);
+	createPipelines();
+}
+
+BarnesHutSystem::~BarnesHutSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void BarnesHutSystem::createBuffers()
+{
+	m_radixSort = std::make_unique<RadixSortSystem>(m_pgsDevice, m_maxParticleCount);
+
+	m_boundsBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												 sizeof(int32_t),
+												 4,
+												 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	// n - 1 internal nodes, at least one so the buffer is never empty
+	m_nodeBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+											   sizeof(BhNode),
+											   std::max(m_maxParticleCount, 2u) - 1,
+											   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+											   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_leafParentBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													 sizeof(uint32_t),
+													 m_maxParticleCount,
+													 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+													 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void BarnesHutSystem::createDescriptorSet()
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(1)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5)
+						   .build();
+
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+
+	// the Morton keys and sorted indices live in the radix sort's key/value buffers
+	auto boundsInfo = m_boundsBuffer->descriptorInfo();
+	auto keyInfo = m_radixSort->getKeyBuffer().descriptorInfo();
+	auto indexInfo = m_radixSort->getValueBuffer().descriptorInfo();
+	auto nodeInfo = m_nodeBuffer->descriptorInfo();
+	auto leafParentInfo = m_leafParentBuffer->descriptorInfo();
+	auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+					  .writeBuffer(0, &boundsInfo)
+					  .writeBuffer(1, &keyInfo)
+					  .writeBuffer(2, &indexInfo)
+					  .writeBuffer(3, &nodeInfo)
+					  .writeBuffer(4, &leafParentInfo)
+					  .build(m_descriptorSet);
+	assert(result && "Failed to build Barnes-Hut descriptor set!");
+}
+
+void BarnesHutSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(BarnesHutPushConstants);
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout,
+															m_setLayout->getDescriptorSetLayout()};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create Barnes-Hut pipeline layout!");
+	}
+}
+
+void BarnesHutSystem::createPipelines()
+{
+	// shaders that include gravity_common.glsl pick up the physics constants, the others ignore them
+	auto gravityConstants = PgsComputePipeline::gravityConstants();
+	m_boundsPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/bh_bounds.comp.spv",
+															m_pipelineLayout,
+															gravityConstants);
+	m_mortonPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/bh_morton.comp.spv",
+															m_pipelineLayout,
+															gravityConstants);
+	m_buildPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														   "shaders/bh_build.comp.spv",
+														   m_pipelineLayout,
+														   gravityConstants);
+	m_summarizePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															   "shaders/bh_summarize.comp.spv",
+															   m_pipelineLayout,
+															   gravityConstants);
+	m_traversePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															  "shaders/bh_traverse.comp.spv",
+															  m_pipelineLayout,
+															  gravityConstants);
+}
+
+void BarnesHutSystem::computeAccelerations(VkCommandBuffer commandBuffer,
+										   VkDescriptorSet globalDescriptorSet,
+										   uint32_t particleCount)
+{
+	assert(particleCount <= m_maxParticleCount && "Barnes-Hut buffers are too small");
+	assert(particleCount >= 2 && "Barnes-Hut needs at least two particles");
+
+	// reset the bounds to (INT_MAX, INT_MAX, INT_MIN, INT_MIN) for the atomic reduction
+	vkCmdFillBuffer(commandBuffer,
+					m_boundsBuffer->getBuffer(),
+					0,
+					2 * sizeof(int32_t),
+					0x7FFFFFFF);
+	vkCmdFillBuffer(commandBuffer,
+					m_boundsBuffer->getBuffer(),
+					2 * sizeof(int32_t),
+					2 * sizeof(int32_t),
+					0x80000000);
+
+	VkMemoryBarrier fillBarrier{};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &fillBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	BarnesHutPushConstants push{};
+	push.particleCount = particleCount;
+	push.openingAngle = m_openingAngle;
+
+	auto bindTreeState = [&]() {
+		std::vector<VkDescriptorSet> descriptorSets{globalDescriptorSet, m_descriptorSet};
+		vkCmdBindDescriptorSets(commandBuffer,
+								VK_PIPELINE_BIND_POINT_COMPUTE,
+								m_pipelineLayout,
+								0,
+								static_cast<uint32_t>(descriptorSets.size()),
+								descriptorSets.data(),
+								0,
+								nullptr);
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(BarnesHutPushConstants),
+						   &push);
+	};
+
+	// bounds and Morton keys
+	bindTreeState();
+	m_boundsPipeline->bind(commandBuffer);
+	m_boundsPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_mortonPipeline->bind(commandBuffer);
+	m_mortonPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	// the sort binds its own pipeline layout, so the tree state is bound again afterwards
+	m_radixSort->sort(commandBuffer, particleCount);
+
+	// tree build, bottom up summary and traversal
+	bindTreeState();
+	m_buildPipeline->bind(commandBuffer);
+	m_buildPipeline->compute(commandBuffer, particleCount - 1);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_summarizePipeline->bind(commandBuffer);
+	m_summarizePipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_traversePipeline->bind(commandBuffer);
+	m_traversePipeline->compute(commandBuffer, particleCount);
+}
+
+BarnesHutSystem::AccuracyReport BarnesHutSystem::measureAccuracy(
+	VkDescriptorSet globalDescriptorSet,
+	PgsBuffer &positionBuffer,
+	PgsBuffer &massBuffer,
+	PgsBuffer &accelerationBuffer,
+	uint32_t particleCount,
+	uint32_t sampleCount)
+{
+	VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+	computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+	m_pgsDevice.endSingleTimeCommands(commandBuffer);
+
+	VkDeviceSize positionBytes = sizeof(glm::vec2) * particleCount;
+	VkDeviceSize massBytes = sizeof(float) * particleCount;
+	VkDeviceSize accelerationBytes = sizeof(glm::vec2) * particleCount;
+	PgsBuffer positionStaging{m_pgsDevice,
+							  sizeof(glm::vec2),
+							  particleCount,
+							  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+							  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+								  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	PgsBuffer massStaging{m_pgsDevice,
+						  sizeof(float),
+						  particleCount,
+						  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+						  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	PgsBuffer accelerationStaging{m_pgsDevice,
+								  sizeof(glm::vec2),
+								  particleCount,
+								  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+								  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+									  VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	m_pgsDevice.copyBuffer(positionBuffer.getBuffer(), positionStaging.getBuffer(), positionBytes);
+	m_pgsDevice.copyBuffer(massBuffer.getBuffer(), massStaging.getBuffer(), massBytes);
+	m_pgsDevice.copyBuffer(accelerationBuffer.getBuffer(),
+						   accelerationStaging.getBuffer(),
+						   accelerationBytes);
+
+	std::vector<glm::vec2> positions(particleCount);
+	std::vector<float> masses(particleCount);
+	std::vector<glm::vec2> accelerations(particleCount);
+	positionStaging.map();
+	massStaging.map();
+	accelerationStaging.map();
+	memcpy(positions.data(), positionStaging.getMappedMemory(), positionBytes);
+	memcpy(masses.data(), massStaging.getMappedMemory(), massBytes);
+	memcpy(accelerations.data(), accelerationStaging.getMappedMemory(), accelerationBytes);
+
+	AccuracyReport report{0.0, 0.0, 0};
+	uint32_t stride = std::max(particleCount / std::max(sampleCount, 1u), 1u);
+	double squaredErrorSum = 0.0;
+	for (uint32_t i = 0; i < particleCount; i += stride)
+	{
+		// double precision direct sum as the reference
+		double referenceX = 0.0;
+		double referenceY = 0.0;
+		for (uint32_t j = 0; j < particleCount; j++)
+		{
+			double dx = positions[j].x - positions[i].x;
+			double dy = positions[j].y - positions[i].y;
+			double dampedDot = std::pow(dx * dx + dy * dy + PgsModel::DAMP, 1.5);
+			referenceX += masses[j] * dx / dampedDot;
+			referenceY += masses[j] * dy / dampedDot;
+		}
+		referenceX *= PgsModel::GRAV_CONSTANT;
+		referenceY *= PgsModel::GRAV_CONSTANT;
+
+		double errorX = accelerations[i].x - referenceX;
+		double errorY = accelerations[i].y - referenceY;
+		double referenceLength = std::sqrt(referenceX * referenceX + referenceY * referenceY);
+		double relativeError =
+			std::sqrt(errorX * errorX + errorY * errorY) / std::max(referenceLength, 1e-30);
+
+		squaredErrorSum += relativeError * relativeError;
+		report.maxRelativeError = std::max(report.maxRelativeError, relativeError);
+		report.sampleCount++;
+	}
+	report.rmsRelativeError = std::sqrt(squaredErrorSum / std::max(report.sampleCount, 1u));
+
+	return report;
+}
+
+} // namespace pgs
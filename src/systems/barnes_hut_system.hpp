@@ -0,0 +1,91 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+#include "radix_sort_system.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * GPU Barnes-Hut force solver. Every step computes the scene bounds, sorts the
+ * particles by Morton key, builds a binary radix tree over the sorted keys,
+ * summarizes the nodes bottom up and walks the tree per particle. The result is
+ * written to the acceleration buffer of the global descriptor set.
+ */
+class BarnesHutSystem
+{
+  public:
+	struct AccuracyReport
+	{
+		double rmsRelativeError;
+		double maxRelativeError;
+		uint32_t sampleCount;
+	};
+
+	// size of one tree node, the widest per-particle buffer of the solver
+	static constexpr VkDeviceSize NODE_SIZE = 48;
+
+	BarnesHutSystem(PgsDevice &device,
+					VkDescriptorSetLayout globalSetLayout,
+					uint32_t maxParticleCount);
+	~BarnesHutSystem();
+
+	BarnesHutSystem(const BarnesHutSystem &) = delete;
+	BarnesHutSystem &operator=(const BarnesHutSystem &) = delete;
+
+	void computeAccelerations(VkCommandBuffer commandBuffer,
+							  VkDescriptorSet globalDescriptorSet,
+							  uint32_t particleCount);
+
+	// Runs one tree pass and compares it on the CPU against the direct sum for
+	// sampleCount particles spread over the whole set, weighted by massBuffer
+	AccuracyReport measureAccuracy(VkDescriptorSet globalDescriptorSet,
+								   PgsBuffer &positionBuffer,
+								   PgsBuffer &massBuffer,
+								   PgsBuffer &accelerationBuffer,
+								   uint32_t particleCount,
+								   uint32_t sampleCount);
+
+	void setOpeningAngle(float openingAngle)
+	{
+		m_openingAngle = openingAngle;
+	}
+	float getOpeningAngle() const
+	{
+		return m_openingAngle;
+	}
+
+  private:
+	void createBuffers();
+	void createDescriptorSet();
+	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxParticleCount;
+	float m_openingAngle{0.5f};
+
+	std::unique_ptr<RadixSortSystem> m_radixSort;
+	std::unique_ptr<PgsBuffer> m_boundsBuffer;
+	std::unique_ptr<PgsBuffer> m_nodeBuffer;
+	std::unique_ptr<PgsBuffer> m_leafParentBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	VkDescriptorSet m_descriptorSet;
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_boundsPipeline;
+	std::unique_ptr<PgsComputePipeline> m_mortonPipeline;
+	std::unique_ptr<PgsComputePipeline> m_buildPipeline;
+	std::unique_ptr<PgsComputePipeline> m_summarizePipeline;
+	std::unique_ptr<PgsComputePipeline> m_traversePipeline;
+};
+
+} // namespace pgs
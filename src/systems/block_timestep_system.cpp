@@ -0,0 +1,227 @@
+#include "block_timestep_system.hpp"
+
+// std
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace pgs
+{
+
+// must match BlockPush in block_common.glsl
+struct BlockPushConstants
+{
+	float dt;
+	uint32_t particleCount;
+	uint32_t substep;
+	uint32_t maxLevel;
+	float accuracy;
+	float softening;
+	uint32_t forceLocalSizeX;
+};
+
+// storage buffers of one descriptor set, see block_common.glsl
+static constexpr uint32_t SET_STORAGE_BUFFERS = 9;
+
+BlockTimestepSystem::BlockTimestepSystem(PgsDevice &device) : m_pgsDevice{device}
+{
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	createPipelines();
+}
+
+BlockTimestepSystem::~BlockTimestepSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void BlockTimestepSystem::createDescriptorSetLayout()
+{
+	auto builder = PgsDescriptorSetLayout::Builder(m_pgsDevice);
+	for (uint32_t binding = 0; binding < SET_STORAGE_BUFFERS; binding++)
+	{
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	m_setLayout = builder.build();
+}
+
+void BlockTimestepSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(BlockPushConstants);
+
+	VkDescriptorSetLayout descriptorSetLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create block timestep pipeline layout!");
+	}
+}
+
+void BlockTimestepSystem::createPipelines()
+{
+	m_initPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/block_init.comp.spv",
+														  m_pipelineLayout);
+	m_driftPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														   "shaders/block_drift.comp.spv",
+														   m_pipelineLayout);
+	PgsComputePipeline::Specialization singleInvocation;
+	singleInvocation.setLocalSizeX(1);
+	m_dispatchPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															  "shaders/block_dispatch.comp.spv",
+															  m_pipelineLayout,
+															  singleInvocation);
+	m_kickPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/block_kick.comp.spv",
+														  m_pipelineLayout);
+}
+
+void BlockTimestepSystem::bindState(PgsModel &model,
+									PgsBuffer &accelerationBuffer,
+									PgsBuffer &activeListBuffer)
+{
+	uint32_t particleCount = model.getParticleCount();
+	assert(activeListBuffer.getBufferSize() >=
+			   (ACTIVE_LIST_HEADER_WORDS + particleCount) * sizeof(uint32_t) &&
+		   "Active list buffer is too small");
+
+	m_levelBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												sizeof(uint32_t),
+												particleCount,
+												VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+												VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_activeListBuffer = activeListBuffer.getBuffer();
+
+	// block_dispatch.comp resets the append counter after every use, it only starts out zeroed here
+	VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+	vkCmdFillBuffer(commandBuffer, m_activeListBuffer, 0, VK_WHOLE_SIZE, 0);
+	m_pgsDevice.endSingleTimeCommands(commandBuffer);
+
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(PgsModel::STATE_BUFFER_COUNT)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+										SET_STORAGE_BUFFERS * PgsModel::STATE_BUFFER_COUNT)
+						   .build();
+
+	auto accelerationInfo = accelerationBuffer.descriptorInfo();
+	auto levelInfo = m_levelBuffer->descriptorInfo();
+	auto activeListInfo = activeListBuffer.descriptorInfo();
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto &stateIn = model.getState(state);
+		auto &stateOut = model.getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = stateIn.positions->descriptorInfo();
+		auto velocityInfo = stateIn.velocities->descriptorInfo();
+		auto colorValueInfo = stateIn.colorValues->descriptorInfo();
+		auto positionNextInfo = stateOut.positions->descriptorInfo();
+		auto velocityNextInfo = stateOut.velocities->descriptorInfo();
+		auto colorValueNextInfo = stateOut.colorValues->descriptorInfo();
+		auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(1, &velocityInfo)
+						  .writeBuffer(2, &colorValueInfo)
+						  .writeBuffer(3, &positionNextInfo)
+						  .writeBuffer(4, &velocityNextInfo)
+						  .writeBuffer(5, &colorValueNextInfo)
+						  .writeBuffer(6, &accelerationInfo)
+						  .writeBuffer(7, &levelInfo)
+						  .writeBuffer(8, &activeListInfo)
+						  .build(m_descriptorSets[state]);
+		assert(result && "Failed to build block timestep descriptor set!");
+	}
+	m_initialized = false;
+}
+
+void BlockTimestepSystem::setParameters(uint32_t maxLevel, float accuracy)
+{
+	assert(maxLevel < 32 && "Level steps must fit a 32 bit substep counter");
+	m_maxLevel = maxLevel;
+	m_accuracy = accuracy;
+	m_substep = 0;
+	m_initialized = false;
+}
+
+void BlockTimestepSystem::bindPass(VkCommandBuffer commandBuffer,
+								   PgsComputePipeline &pipeline,
+								   uint32_t stateIndex,
+								   uint32_t particleCount,
+								   float dt,
+								   uint32_t substep,
+								   uint32_t forceLocalSizeX)
+{
+	assert(m_descriptorSets[stateIndex] != VK_NULL_HANDLE && "bindState was not called");
+
+	pipeline.bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							1,
+							&m_descriptorSets[stateIndex],
+							0,
+							nullptr);
+
+	BlockPushConstants push{};
+	push.dt = dt;
+	push.particleCount = particleCount;
+	push.substep = substep & ((1u << m_maxLevel) - 1u);
+	push.maxLevel = m_maxLevel;
+	push.accuracy = m_accuracy;
+	push.softening = std::sqrt(PgsModel::DAMP);
+	push.forceLocalSizeX = forceLocalSizeX;
+	vkCmdPushConstants(commandBuffer,
+					   m_pipelineLayout,
+					   VK_SHADER_STAGE_COMPUTE_BIT,
+					   0,
+					   sizeof(BlockPushConstants),
+					   &push);
+}
+
+void BlockTimestepSystem::recordInit(VkCommandBuffer commandBuffer,
+									 uint32_t stateIndex,
+									 uint32_t particleCount,
+									 float dt)
+{
+	bindPass(commandBuffer, *m_initPipeline, stateIndex, particleCount, dt, m_substep);
+	m_initPipeline->compute(commandBuffer, particleCount);
+	m_initialized = true;
+}
+
+void BlockTimestepSystem::recordDrift(VkCommandBuffer commandBuffer,
+									  uint32_t stateIndex,
+									  uint32_t particleCount,
+									  float dt,
+									  uint32_t forceLocalSizeX)
+{
+	bindPass(commandBuffer, *m_driftPipeline, stateIndex, particleCount, dt, m_substep + 1, forceLocalSizeX);
+	m_driftPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	m_dispatchPipeline->bind(commandBuffer);
+	m_dispatchPipeline->dispatch(commandBuffer, 1);
+	PgsComputePipeline::indirectBarrier(commandBuffer);
+}
+
+void BlockTimestepSystem::recordKick(VkCommandBuffer commandBuffer,
+									 uint32_t stateIndex,
+									 uint32_t particleCount,
+									 float dt)
+{
+	bindPass(commandBuffer, *m_kickPipeline, stateIndex, particleCount, dt, m_substep + 1);
+	m_kickPipeline->dispatchIndirect(commandBuffer, m_activeListBuffer, PASS_DISPATCH_OFFSET);
+	m_substep++;
+}
+
+} // namespace pgs
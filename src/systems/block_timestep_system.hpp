@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pgs_model.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Hierarchical block timesteps. Every particle steps with dt * 2^level, its level
+ * picked from its acceleration. A substep of dt drifts all particles, compacts
+ * the ones whose step ends into the active list, and after the caller evaluated
+ * forces for those, kicks them and picks their next level. Force evaluation and
+ * the kick are dispatched indirectly over the active list only, so quiet
+ * particles cost a drift per substep instead of a force evaluation.
+ */
+class BlockTimestepSystem
+{
+  public:
+	static constexpr uint32_t DEFAULT_MAX_LEVEL = 6;
+	static constexpr float DEFAULT_ACCURACY = 0.025f;
+	// byte offsets of the VkDispatchIndirectCommands in the active list buffer,
+	// followed by the active particle indices, see ActiveParticles in block_common.glsl
+	static constexpr VkDeviceSize FORCE_DISPATCH_OFFSET = 0;
+	static constexpr VkDeviceSize PASS_DISPATCH_OFFSET = 16;
+	static constexpr uint32_t ACTIVE_LIST_HEADER_WORDS = 8;
+
+	explicit BlockTimestepSystem(PgsDevice &device);
+	~BlockTimestepSystem();
+
+	BlockTimestepSystem(const BlockTimestepSystem &) = delete;
+	BlockTimestepSystem &operator=(const BlockTimestepSystem &) = delete;
+
+	// Creates the per-state descriptor sets. activeListBuffer needs room for
+	// ACTIVE_LIST_HEADER_WORDS + particle count 32 bit words and indirect usage.
+	void bindState(PgsModel &model, PgsBuffer &accelerationBuffer, PgsBuffer &activeListBuffer);
+
+	// Levels run from 0 (dt) to maxLevel (dt * 2^maxLevel), a particle gets the largest
+	// step with dt * 2^level <= sqrt(2 * accuracy * softening / |a|)
+	void setParameters(uint32_t maxLevel, float accuracy);
+	uint32_t getMaxLevel() const
+	{
+		return m_maxLevel;
+	}
+	float getAccuracy() const
+	{
+		return m_accuracy;
+	}
+
+	// Levels have to be picked again after the state or the forces changed outside of this system
+	bool isInitialized() const
+	{
+		return m_initialized;
+	}
+	void invalidate()
+	{
+		m_initialized = false;
+	}
+
+	// Picks the first levels from forces evaluated at the current state and opens every step
+	void recordInit(VkCommandBuffer commandBuffer, uint32_t stateIndex, uint32_t particleCount, float dt);
+	// Drifts all particles into the next state and builds the active list and its
+	// dispatch arguments, the force pass dispatches forceLocalSizeX wide groups
+	void recordDrift(VkCommandBuffer commandBuffer,
+					 uint32_t stateIndex,
+					 uint32_t particleCount,
+					 float dt,
+					 uint32_t forceLocalSizeX);
+	// Kicks the active particles with forces evaluated at the next state and ends the substep
+	void recordKick(VkCommandBuffer commandBuffer, uint32_t stateIndex, uint32_t particleCount, float dt);
+
+	VkBuffer getActiveListBuffer() const
+	{
+		return m_activeListBuffer;
+	}
+
+  private:
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	void createPipelines();
+	void bindPass(VkCommandBuffer commandBuffer,
+				  PgsComputePipeline &pipeline,
+				  uint32_t stateIndex,
+				  uint32_t particleCount,
+				  float dt,
+				  uint32_t substep,
+				  uint32_t forceLocalSizeX = 1);
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxLevel{DEFAULT_MAX_LEVEL};
+	float m_accuracy{DEFAULT_ACCURACY};
+	// substeps taken, modulo 2^m_maxLevel
+	uint32_t m_substep{0};
+	bool m_initialized{false};
+
+	std::unique_ptr<PgsBuffer> m_levelBuffer;
+	VkBuffer m_activeListBuffer{VK_NULL_HANDLE};
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	// indexed by the state a substep reads
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> m_descriptorSets{};
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_initPipeline;
+	std::unique_ptr<PgsComputePipeline> m_driftPipeline;
+	std::unique_ptr<PgsComputePipeline> m_dispatchPipeline;
+	std::unique_ptr<PgsComputePipeline> m_kickPipeline;
+};
+
+} // namespace pgs
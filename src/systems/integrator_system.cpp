@@ -0,0 +1,221 @@
+#include "integrator_system.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+#include <string>
+
+namespace pgs
+{
+
+// must match IntegratorPush in integrator_common.glsl
+struct IntegratorPushConstants
+{
+	float dt;
+	uint32_t particleCount;
+	uint32_t stage;
+};
+
+// storage buffers of one descriptor set, see integrator_common.glsl
+static constexpr uint32_t SET_STORAGE_BUFFERS = 11;
+
+IntegratorSystem::IntegratorSystem(PgsDevice &device) : m_pgsDevice{device}
+{
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	createPipelines();
+}
+
+IntegratorSystem::~IntegratorSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+uint32_t IntegratorSystem::stageCount(Scheme scheme)
+{
+	return scheme == Scheme::RK4 ? 4 : 2;
+}
+
+bool IntegratorSystem::startsFromSavedForces(Scheme scheme)
+{
+	return scheme != Scheme::RK4;
+}
+
+void IntegratorSystem::createDescriptorSetLayout()
+{
+	auto builder = PgsDescriptorSetLayout::Builder(m_pgsDevice);
+	for (uint32_t binding = 0; binding < SET_STORAGE_BUFFERS; binding++)
+	{
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	m_setLayout = builder.build();
+}
+
+void IntegratorSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(IntegratorPushConstants);
+
+	VkDescriptorSetLayout descriptorSetLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create integrator pipeline layout!");
+	}
+}
+
+void IntegratorSystem::createPipelines()
+{
+	// indexed by Scheme
+	const std::vector<std::string> shaderPaths{"shaders/integrate_leapfrog.comp.spv",
+											   "shaders/integrate_verlet.comp.spv",
+											   "shaders/integrate_rk4.comp.spv",
+											   "shaders/integrate_hermite.comp.spv"};
+	assert(shaderPaths.size() == static_cast<size_t>(Scheme::Count) && "Missing integrator shader");
+
+	for (const auto &shaderPath : shaderPaths)
+	{
+		m_stagePipelines.push_back(
+			std::make_unique<PgsComputePipeline>(m_pgsDevice, shaderPath, m_pipelineLayout));
+	}
+	m_savePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/integrate_save.comp.spv",
+														  m_pipelineLayout);
+}
+
+void IntegratorSystem::bindState(PgsModel &model,
+								 PgsBuffer &accelerationBuffer,
+								 PgsBuffer &jerkBuffer)
+{
+	uint32_t particleCount = model.getParticleCount();
+	m_savedAccelerationBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+															sizeof(glm::vec2),
+															particleCount,
+															VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+															VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_savedJerkBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													sizeof(glm::vec2),
+													particleCount,
+													VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+													VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_stageSumBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												   STAGE_SUM_SIZE,
+												   particleCount,
+												   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+												   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(PgsModel::STATE_BUFFER_COUNT)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+										SET_STORAGE_BUFFERS * PgsModel::STATE_BUFFER_COUNT)
+						   .build();
+
+	auto accelerationInfo = accelerationBuffer.descriptorInfo();
+	auto jerkInfo = jerkBuffer.descriptorInfo();
+	auto savedAccelerationInfo = m_savedAccelerationBuffer->descriptorInfo();
+	auto savedJerkInfo = m_savedJerkBuffer->descriptorInfo();
+	auto stageSumInfo = m_stageSumBuffer->descriptorInfo();
+	auto countInfo = model.getCountBuffer().descriptorInfo();
+	m_countBuffer = model.getCountBuffer().getBuffer();
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto &stateIn = model.getState(state);
+		auto &stateOut = model.getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = stateIn.positions->descriptorInfo();
+		auto velocityInfo = stateIn.velocities->descriptorInfo();
+		auto positionNextInfo = stateOut.positions->descriptorInfo();
+		auto velocityNextInfo = stateOut.velocities->descriptorInfo();
+		auto colorValueNextInfo = stateOut.colorValues->descriptorInfo();
+		auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+						  .writeBuffer(0, &positionInfo)
+						  .writeBuffer(1, &velocityInfo)
+						  .writeBuffer(2, &positionNextInfo)
+						  .writeBuffer(3, &velocityNextInfo)
+						  .writeBuffer(4, &colorValueNextInfo)
+						  .writeBuffer(5, &accelerationInfo)
+						  .writeBuffer(6, &jerkInfo)
+						  .writeBuffer(7, &savedAccelerationInfo)
+						  .writeBuffer(8, &savedJerkInfo)
+						  .writeBuffer(9, &stageSumInfo)
+						  .writeBuffer(10, &countInfo)
+						  .build(m_descriptorSets[state]);
+		assert(result && "Failed to build integrator descriptor set!");
+	}
+	m_hasSavedForces = false;
+}
+
+void IntegratorSystem::bindStage(VkCommandBuffer commandBuffer,
+								 PgsComputePipeline &pipeline,
+								 uint32_t stateIndex,
+								 uint32_t particleCount,
+								 float dt,
+								 uint32_t stage)
+{
+	assert(m_descriptorSets[stateIndex] != VK_NULL_HANDLE && "bindState was not called");
+
+	pipeline.bind(commandBuffer);
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							1,
+							&m_descriptorSets[stateIndex],
+							0,
+							nullptr);
+
+	IntegratorPushConstants push{};
+	push.dt = dt;
+	push.particleCount = particleCount;
+	push.stage = stage;
+	vkCmdPushConstants(commandBuffer,
+					   m_pipelineLayout,
+					   VK_SHADER_STAGE_COMPUTE_BIT,
+					   0,
+					   sizeof(IntegratorPushConstants),
+					   &push);
+}
+
+void IntegratorSystem::recordStage(VkCommandBuffer commandBuffer,
+								   Scheme scheme,
+								   uint32_t stage,
+								   uint32_t stateIndex,
+								   uint32_t particleCount,
+								   float dt)
+{
+	assert(stage < stageCount(scheme) && "Stage out of range");
+
+	auto &pipeline = *m_stagePipelines[static_cast<size_t>(scheme)];
+	bindStage(commandBuffer, pipeline, stateIndex, particleCount, dt, stage);
+	pipeline.dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::PASS_GROUPS_OFFSET);
+
+	// the last stage of every scheme but RK4 saves the forces it used
+	if (stage + 1 == stageCount(scheme) && startsFromSavedForces(scheme))
+	{
+		m_hasSavedForces = true;
+	}
+}
+
+void IntegratorSystem::recordSaveForces(VkCommandBuffer commandBuffer,
+										uint32_t stateIndex,
+										uint32_t particleCount)
+{
+	bindStage(commandBuffer, *m_savePipeline, stateIndex, particleCount, 0.0f, 0);
+	m_savePipeline->dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::PASS_GROUPS_OFFSET);
+	m_hasSavedForces = true;
+}
+
+} // namespace pgs
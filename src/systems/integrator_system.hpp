@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pgs_model.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace pgs
+{
+
+/*
+ * Integration passes of the higher order integrators. A step runs its stages in
+ * order with a force evaluation between each pair; stages leave the trial state
+ * in the next state buffers, so the forces at it are evaluated through the
+ * global descriptor set of the next state. The acceleration (and jerk) at the
+ * end of a step is kept for the next one, single evaluation schemes therefore
+ * only evaluate forces once per step. The stage order is driven by ParticleSystem.
+ */
+class IntegratorSystem
+{
+  public:
+	enum class Scheme : uint32_t
+	{
+		Leapfrog = 0,	// kick-drift-kick
+		VelocityVerlet,
+		RK4,
+		Hermite,		// fourth order predictor-corrector, needs jerks
+		Count
+	};
+
+	// size of one RK4 stage sum (velocity and acceleration sums), the widest
+	// per-particle buffer of the integrators
+	static constexpr VkDeviceSize STAGE_SUM_SIZE = 4 * sizeof(float);
+
+	explicit IntegratorSystem(PgsDevice &device);
+	~IntegratorSystem();
+
+	IntegratorSystem(const IntegratorSystem &) = delete;
+	IntegratorSystem &operator=(const IntegratorSystem &) = delete;
+
+	// Number of stages of one step, forces are evaluated before every stage after the first
+	static uint32_t stageCount(Scheme scheme);
+	// True if the first stage reads the saved forces instead of forces evaluated at the current state
+	static bool startsFromSavedForces(Scheme scheme);
+
+	// Creates the per-state descriptor sets over the model's state buffers and the
+	// acceleration and jerk buffers the force solvers write
+	void bindState(PgsModel &model, PgsBuffer &accelerationBuffer, PgsBuffer &jerkBuffer);
+
+	// Records one stage of the step reading state stateIndex
+	void recordStage(VkCommandBuffer commandBuffer,
+					 Scheme scheme,
+					 uint32_t stage,
+					 uint32_t stateIndex,
+					 uint32_t particleCount,
+					 float dt);
+	// Copies the last evaluated forces into the saved ones
+	void recordSaveForces(VkCommandBuffer commandBuffer, uint32_t stateIndex, uint32_t particleCount);
+
+	// The saved forces belong to the current state until the state or the scheme
+	// that keeps them up to date changes
+	bool hasSavedForces() const
+	{
+		return m_hasSavedForces;
+	}
+	void invalidateSavedForces()
+	{
+		m_hasSavedForces = false;
+	}
+
+  private:
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	void createPipelines();
+	void bindStage(VkCommandBuffer commandBuffer,
+				   PgsComputePipeline &pipeline,
+				   uint32_t stateIndex,
+				   uint32_t particleCount,
+				   float dt,
+				   uint32_t stage);
+
+	PgsDevice &m_pgsDevice;
+
+	std::unique_ptr<PgsBuffer> m_savedAccelerationBuffer;
+	std::unique_ptr<PgsBuffer> m_savedJerkBuffer;
+	std::unique_ptr<PgsBuffer> m_stageSumBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	// indexed by the state a step reads
+	std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> m_descriptorSets{};
+	// the bound model's CountArgs, stages are dispatched over its live count
+	VkBuffer m_countBuffer{VK_NULL_HANDLE};
+
+	VkPipelineLayout m_pipelineLayout;
+	// indexed by Scheme
+	std::vector<std::unique_ptr<PgsComputePipeline>> m_stagePipelines;
+	std::unique_ptr<PgsComputePipeline> m_savePipeline;
+	bool m_hasSavedForces{false};
+};
+
+} // namespace pgs
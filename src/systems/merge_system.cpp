@@ -0,0 +1,275 @@
+#include "merge_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+namespace pgs
+{
+
+// must match MergePush in merge_common.glsl
+struct MergePushConstants
+{
+	uint32_t particleCount;
+	uint32_t cellsPerAxis;
+	float domainHalfWidth;
+	float cellSize;
+	float mergeRadius;
+};
+
+// storage buffers of one descriptor set, see merge_common.glsl
+static constexpr uint32_t SET_STORAGE_BUFFERS = 17;
+
+MergeSystem::MergeSystem(PgsDevice &device, uint32_t maxParticleCount)
+	: m_pgsDevice{device}, m_maxParticleCount{maxParticleCount}
+{
+	createBuffers();
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	createPipelines();
+}
+
+MergeSystem::~MergeSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void MergeSystem::createBuffers()
+{
+	m_radixSort = std::make_unique<RadixSortSystem>(m_pgsDevice, m_maxParticleCount);
+
+	// sized for the finest grid, a merge only clears the cells its radius uses
+	uint32_t maxCellCount = MAX_CELLS_PER_AXIS * MAX_CELLS_PER_AXIS;
+	m_cellStartBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													sizeof(uint32_t),
+													maxCellCount,
+													VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+														VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+													VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_cellEndBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												  sizeof(uint32_t),
+												  maxCellCount,
+												  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_targetBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												 sizeof(uint32_t),
+												 m_maxParticleCount,
+												 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+												 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_massScratchBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													  sizeof(float),
+													  m_maxParticleCount,
+													  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+														  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+													  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_mergedCountBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													  sizeof(uint32_t),
+													  1,
+													  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+														  VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+														  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+													  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void MergeSystem::createDescriptorSetLayout()
+{
+	auto builder = PgsDescriptorSetLayout::Builder(m_pgsDevice);
+	for (uint32_t binding = 0; binding < SET_STORAGE_BUFFERS; binding++)
+	{
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	m_setLayout = builder.build();
+}
+
+void MergeSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(MergePushConstants);
+
+	VkDescriptorSetLayout descriptorSetLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create merge pipeline layout!");
+	}
+}
+
+void MergeSystem::createPipelines()
+{
+	m_cellKeysPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															  "shaders/merge_cell_keys.comp.spv",
+															  m_pipelineLayout);
+	m_cellRangesPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+																"shaders/merge_cell_ranges.comp.spv",
+																m_pipelineLayout);
+	m_targetsPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															 "shaders/merge_targets.comp.spv",
+															 m_pipelineLayout);
+	m_gatherPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/merge_gather.comp.spv",
+															m_pipelineLayout);
+}
+
+void MergeSystem::bindState(PgsModel &model)
+{
+	assert(model.getParticleCount() <= m_maxParticleCount && "Merge buffers are too small");
+
+	constexpr uint32_t setCount = PgsModel::STATE_BUFFER_COUNT * PgsModel::STATE_BUFFER_COUNT;
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(setCount)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SET_STORAGE_BUFFERS * setCount)
+						   .build();
+
+	auto massInfo = model.getMassBuffer().descriptorInfo();
+	auto massNextInfo = m_massScratchBuffer->descriptorInfo();
+	auto keyInfo = m_radixSort->getKeyBuffer().descriptorInfo();
+	auto indexInfo = m_radixSort->getValueBuffer().descriptorInfo();
+	auto cellStartInfo = m_cellStartBuffer->descriptorInfo();
+	auto cellEndInfo = m_cellEndBuffer->descriptorInfo();
+	auto targetInfo = m_targetBuffer->descriptorInfo();
+	auto countInfo = model.getCountBuffer().descriptorInfo();
+	auto mergedCountInfo = m_mergedCountBuffer->descriptorInfo();
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto &stateIn = model.getState(state);
+		auto &stateOut = model.getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = stateIn.positions->descriptorInfo();
+		auto velocityInfo = stateIn.velocities->descriptorInfo();
+		auto colorValueInfo = stateIn.colorValues->descriptorInfo();
+		auto positionNextInfo = stateOut.positions->descriptorInfo();
+		auto velocityNextInfo = stateOut.velocities->descriptorInfo();
+		auto colorValueNextInfo = stateOut.colorValues->descriptorInfo();
+		for (uint32_t ids = 0; ids < PgsModel::STATE_BUFFER_COUNT; ids++)
+		{
+			auto idInfo = model.getParticleIdBuffer(ids).descriptorInfo();
+			auto idNextInfo =
+				model.getParticleIdBuffer((ids + 1) % PgsModel::STATE_BUFFER_COUNT).descriptorInfo();
+			auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+							  .writeBuffer(0, &positionInfo)
+							  .writeBuffer(1, &velocityInfo)
+							  .writeBuffer(2, &colorValueInfo)
+							  .writeBuffer(3, &positionNextInfo)
+							  .writeBuffer(4, &velocityNextInfo)
+							  .writeBuffer(5, &colorValueNextInfo)
+							  .writeBuffer(6, &idInfo)
+							  .writeBuffer(7, &idNextInfo)
+							  .writeBuffer(8, &massInfo)
+							  .writeBuffer(9, &massNextInfo)
+							  .writeBuffer(10, &keyInfo)
+							  .writeBuffer(11, &indexInfo)
+							  .writeBuffer(12, &cellStartInfo)
+							  .writeBuffer(13, &cellEndInfo)
+							  .writeBuffer(14, &targetInfo)
+							  .writeBuffer(15, &countInfo)
+							  .writeBuffer(16, &mergedCountInfo)
+							  .build(m_descriptorSets[state][ids]);
+			assert(result && "Failed to build merge descriptor set!");
+		}
+	}
+}
+
+void MergeSystem::recordMerge(VkCommandBuffer commandBuffer, PgsModel &model, float mergeRadius)
+{
+	uint32_t particleCount = model.getParticleCount();
+	VkDescriptorSet descriptorSet =
+		m_descriptorSets[model.getStateIndex()][model.getParticleIdIndex()];
+	assert(descriptorSet != VK_NULL_HANDLE && "bindState was not called");
+	assert(mergeRadius > 0.0f && "Merge radius must be positive");
+
+	// cells at least one merge radius wide, so partners are in the 3x3 neighbourhood
+	float cellsPerAxis = std::floor(2.0f * DOMAIN_HALF_WIDTH / mergeRadius);
+	MergePushConstants push{};
+	push.particleCount = particleCount;
+	push.cellsPerAxis = static_cast<uint32_t>(
+		std::clamp(cellsPerAxis, 1.0f, static_cast<float>(MAX_CELLS_PER_AXIS)));
+	push.domainHalfWidth = DOMAIN_HALF_WIDTH;
+	push.cellSize = 2.0f * DOMAIN_HALF_WIDTH / static_cast<float>(push.cellsPerAxis);
+	push.mergeRadius = mergeRadius;
+
+	// the dead slot key is one past the last cell and has to fit the sorted bits
+	uint32_t cellCount = push.cellsPerAxis * push.cellsPerAxis;
+	uint32_t cellKeyBits = 1;
+	while ((1u << cellKeyBits) <= cellCount)
+	{
+		cellKeyBits++;
+	}
+
+	// empty cells keep the range [0, 0)
+	VkDeviceSize cellBytes = sizeof(uint32_t) * cellCount;
+	vkCmdFillBuffer(commandBuffer, m_cellStartBuffer->getBuffer(), 0, cellBytes, 0);
+	vkCmdFillBuffer(commandBuffer, m_cellEndBuffer->getBuffer(), 0, cellBytes, 0);
+	vkCmdFillBuffer(commandBuffer, m_mergedCountBuffer->getBuffer(), 0, sizeof(uint32_t), 0);
+	PgsComputePipeline::transferToComputeBarrier(commandBuffer);
+
+	auto bindMergeState = [&]() {
+		vkCmdBindDescriptorSets(commandBuffer,
+								VK_PIPELINE_BIND_POINT_COMPUTE,
+								m_pipelineLayout,
+								0,
+								1,
+								&descriptorSet,
+								0,
+								nullptr);
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(MergePushConstants),
+						   &push);
+	};
+
+	// cell list over the live slots, the dead ones sort behind every cell
+	bindMergeState();
+	m_cellKeysPipeline->bind(commandBuffer);
+	m_cellKeysPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	m_radixSort->sort(commandBuffer, particleCount, cellKeyBits);
+
+	bindMergeState();
+	m_cellRangesPipeline->bind(commandBuffer);
+	m_cellRangesPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	// targets, then merge and compact the survivors into the next state
+	m_targetsPipeline->bind(commandBuffer);
+	m_targetsPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_gatherPipeline->bind(commandBuffer);
+	m_gatherPipeline->compute(commandBuffer, particleCount);
+
+	// the mass buffer is bound to the global sets, so the merged masses are copied
+	// back, and the survivor count becomes the live count
+	PgsComputePipeline::computeToTransferBarrier(commandBuffer);
+	VkBufferCopy massCopy{0, 0, sizeof(float) * particleCount};
+	vkCmdCopyBuffer(commandBuffer,
+					m_massScratchBuffer->getBuffer(),
+					model.getMassBuffer().getBuffer(),
+					1,
+					&massCopy);
+	VkBufferCopy countCopy{0, offsetof(PgsModel::CountArgs, particleCount), sizeof(uint32_t)};
+	vkCmdCopyBuffer(commandBuffer,
+					m_mergedCountBuffer->getBuffer(),
+					model.getCountBuffer().getBuffer(),
+					1,
+					&countCopy);
+	PgsComputePipeline::transferToComputeBarrier(commandBuffer);
+
+	model.swapParticleIdBuffers();
+}
+
+} // namespace pgs
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pgs_model.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+#include "radix_sort_system.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Merges particles closer than a merge radius, conserving mass and momentum, and
+ * compacts the dead slots away so the live count shrinks as clumps form. Live
+ * particles are bucketed into a uniform cell list built with the radix sort, every
+ * particle targets the lowest slot within the radius and the particles that are
+ * their own target absorb the ones targeting them. A merge reads the model's
+ * current state and writes the survivors to the front of the other state buffer,
+ * the caller then swaps the state buffers like after a step.
+ */
+class MergeSystem
+{
+  public:
+	// the cell list spans [-DOMAIN_HALF_WIDTH, DOMAIN_HALF_WIDTH]², particles outside
+	// are clamped into the border cells
+	static constexpr float DOMAIN_HALF_WIDTH = 1.0f;
+	static constexpr uint32_t MAX_CELLS_PER_AXIS = 1024;
+
+	MergeSystem(PgsDevice &device, uint32_t maxParticleCount);
+	~MergeSystem();
+
+	MergeSystem(const MergeSystem &) = delete;
+	MergeSystem &operator=(const MergeSystem &) = delete;
+
+	// Creates the descriptor sets over the model's state, particle id and mass buffers
+	void bindState(PgsModel &model);
+
+	// Records one merge pass of the current state into the next one, swaps the
+	// model's particle id buffers and writes the surviving count to the model's count
+	// buffer. The caller swaps the state buffers and rewrites the indirect arguments
+	// with ParticleSystem::recordCountUpdate.
+	void recordMerge(VkCommandBuffer commandBuffer, PgsModel &model, float mergeRadius);
+
+  private:
+	void createBuffers();
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxParticleCount;
+
+	std::unique_ptr<RadixSortSystem> m_radixSort;
+	std::unique_ptr<PgsBuffer> m_cellStartBuffer;
+	std::unique_ptr<PgsBuffer> m_cellEndBuffer;
+	std::unique_ptr<PgsBuffer> m_targetBuffer;
+	// merged masses in compacted order before they are copied back to the model
+	std::unique_ptr<PgsBuffer> m_massScratchBuffer;
+	std::unique_ptr<PgsBuffer> m_mergedCountBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	// indexed by the state and the particle id buffer a merge reads
+	std::array<std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT>, PgsModel::STATE_BUFFER_COUNT>
+		m_descriptorSets{};
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_cellKeysPipeline;
+	std::unique_ptr<PgsComputePipeline> m_cellRangesPipeline;
+	std::unique_ptr<PgsComputePipeline> m_targetsPipeline;
+	std::unique_ptr<PgsComputePipeline> m_gatherPipeline;
+};
+
+} // namespace pgs
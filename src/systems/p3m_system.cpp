@@ -0,0 +1,225 @@
+#include "p3m_system.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace pgs
+{
+
+// must match P3MPush in p3m_common.glsl
+struct P3MPushConstants
+{
+	uint32_t particleCount;
+	uint32_t cellsPerAxis;
+	float domainHalfWidth;
+	float cellSize;
+	float splitRadius;
+	float cutoffRadius;
+};
+
+P3MSystem::P3MSystem(PgsDevice &device,
+					 VkDescriptorSetLayout globalSetLayout,
+					 uint32_t maxParticleCount,
+					 uint32_t gridSize,
+					 float splitRadius,
+					 float domainHalfWidth)
+	: m_pgsDevice{device}, m_maxParticleCount{maxParticleCount}
+{
+	if (splitRadius <= 0.0f)
+	{
+		splitRadius = DEFAULT_SPLIT_CELLS * 2.0f * domainHalfWidth / static_cast<float>(gridSize);
+	}
+	m_particleMeshSystem = std::make_unique<ParticleMeshSystem>(m_pgsDevice,
+																globalSetLayout,
+																gridSize,
+																domainHalfWidth,
+																splitRadius);
+
+	// cells at least one cutoff wide, so all neighbours lie in the 3x3 block around a particle
+	float cellsPerAxis = std::floor(2.0f * domainHalfWidth / (CUTOFF_FACTOR * splitRadius));
+	m_cellsPerAxis = static_cast<uint32_t>(
+		std::clamp(cellsPerAxis, 1.0f, static_cast<float>(MAX_CELLS_PER_AXIS)));
+	m_cellKeyBits = 1;
+	while ((1u << m_cellKeyBits) < m_cellsPerAxis * m_cellsPerAxis)
+	{
+		m_cellKeyBits++;
+	}
+
+	createBuffers();
+	createDescriptorSet();
+	createPipelineLayout(globalSetLayout);
+	createPipelines();
+}
+
+P3MSystem::~P3MSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void P3MSystem::createBuffers()
+{
+	m_radixSort = std::make_unique<RadixSortSystem>(m_pgsDevice, m_maxParticleCount);
+
+	uint32_t cellCount = m_cellsPerAxis * m_cellsPerAxis;
+	m_cellStartBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													sizeof(uint32_t),
+													cellCount,
+													VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+														VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+													VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_cellEndBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												  sizeof(uint32_t),
+												  cellCount,
+												  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void P3MSystem::createDescriptorSet()
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(1)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+						   .build();
+
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+
+	// the cell keys and particle indices live in the radix sort's key/value buffers
+	auto keyInfo = m_radixSort->getKeyBuffer().descriptorInfo();
+	auto indexInfo = m_radixSort->getValueBuffer().descriptorInfo();
+	auto cellStartInfo = m_cellStartBuffer->descriptorInfo();
+	auto cellEndInfo = m_cellEndBuffer->descriptorInfo();
+	auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+					  .writeBuffer(0, &keyInfo)
+					  .writeBuffer(1, &indexInfo)
+					  .writeBuffer(2, &cellStartInfo)
+					  .writeBuffer(3, &cellEndInfo)
+					  .build(m_descriptorSet);
+	assert(result && "Failed to build P3M descriptor set!");
+}
+
+void P3MSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(P3MPushConstants);
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout,
+															m_setLayout->getDescriptorSetLayout()};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create P3M pipeline layout!");
+	}
+}
+
+void P3MSystem::createPipelines()
+{
+	// shaders that include gravity_common.glsl pick up the physics constants, the others ignore them
+	auto gravityConstants = PgsComputePipeline::gravityConstants();
+	m_cellKeysPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															  "shaders/p3m_cell_keys.comp.spv",
+															  m_pipelineLayout,
+															  gravityConstants);
+	m_cellRangesPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+																"shaders/p3m_cell_ranges.comp.spv",
+																m_pipelineLayout,
+																gravityConstants);
+	m_shortRangePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+																"shaders/p3m_short_range.comp.spv",
+																m_pipelineLayout,
+																gravityConstants);
+}
+
+void P3MSystem::computeAccelerations(VkCommandBuffer commandBuffer,
+									 VkDescriptorSet globalDescriptorSet,
+									 uint32_t particleCount)
+{
+	assert(particleCount <= m_maxParticleCount && "P3M buffers are too small");
+
+	// long range part, written to the acceleration buffer
+	m_particleMeshSystem->computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+
+	// empty cells keep the range [0, 0)
+	vkCmdFillBuffer(commandBuffer, m_cellStartBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+	vkCmdFillBuffer(commandBuffer, m_cellEndBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+	VkMemoryBarrier fillBarrier{};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &fillBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	P3MPushConstants push{};
+	push.particleCount = particleCount;
+	push.cellsPerAxis = m_cellsPerAxis;
+	push.domainHalfWidth = m_particleMeshSystem->getDomainHalfWidth();
+	push.cellSize = 2.0f * push.domainHalfWidth / static_cast<float>(m_cellsPerAxis);
+	push.splitRadius = getSplitRadius();
+	push.cutoffRadius = getCutoffRadius();
+
+	auto bindCellState = [&]() {
+		std::vector<VkDescriptorSet> descriptorSets{globalDescriptorSet, m_descriptorSet};
+		vkCmdBindDescriptorSets(commandBuffer,
+								VK_PIPELINE_BIND_POINT_COMPUTE,
+								m_pipelineLayout,
+								0,
+								static_cast<uint32_t>(descriptorSets.size()),
+								descriptorSets.data(),
+								0,
+								nullptr);
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(P3MPushConstants),
+						   &push);
+	};
+
+	// cell list: key every particle by its cell, sort, then find each cell's range
+	bindCellState();
+	m_cellKeysPipeline->bind(commandBuffer);
+	m_cellKeysPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	m_radixSort->sort(commandBuffer, particleCount, m_cellKeyBits);
+
+	bindCellState();
+	m_cellRangesPipeline->bind(commandBuffer);
+	m_cellRangesPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	// short range correction, also waits on the mesh accelerations
+	m_shortRangePipeline->bind(commandBuffer);
+	m_shortRangePipeline->compute(commandBuffer, particleCount);
+}
+
+} // namespace pgs
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+#include "particle_mesh_system.hpp"
+#include "radix_sort_system.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Particle-particle particle-mesh (P3M) force solver. The softened potential is
+ * split with an erf kernel of width splitRadius: the smooth long range part is
+ * solved on the mesh by a ParticleMeshSystem, the short range remainder is summed
+ * directly over neighbours found through a GPU cell list. Close encounters stay
+ * resolved at the cost of one extra local pass over the PM solver.
+ */
+class P3MSystem
+{
+  public:
+	// short range pairs are summed out to CUTOFF_FACTOR * splitRadius, where the
+	// short range pull left is erfc(x) + 2x exp(-x^2) / sqrt(pi) of the full one with
+	// x = CUTOFF_FACTOR / 2, about 1.8%. A factor of 5.8 would bring it to 0.1% at
+	// about 1.7 times the neighbours.
+	static constexpr float CUTOFF_FACTOR = 4.5f;
+	// default splitRadius in mesh cells, small enough for the mesh to resolve
+	static constexpr float DEFAULT_SPLIT_CELLS = 1.25f;
+	static constexpr uint32_t MAX_CELLS_PER_AXIS = 1024;
+
+	// A splitRadius of zero picks DEFAULT_SPLIT_CELLS mesh cells
+	P3MSystem(PgsDevice &device,
+			  VkDescriptorSetLayout globalSetLayout,
+			  uint32_t maxParticleCount,
+			  uint32_t gridSize = ParticleMeshSystem::DEFAULT_GRID_SIZE,
+			  float splitRadius = 0.0f,
+			  float domainHalfWidth = 1.0f);
+	~P3MSystem();
+
+	P3MSystem(const P3MSystem &) = delete;
+	P3MSystem &operator=(const P3MSystem &) = delete;
+
+	void computeAccelerations(VkCommandBuffer commandBuffer,
+							  VkDescriptorSet globalDescriptorSet,
+							  uint32_t particleCount);
+
+	uint32_t getGridSize() const
+	{
+		return m_particleMeshSystem->getGridSize();
+	}
+	float getSplitRadius() const
+	{
+		return m_particleMeshSystem->getSplitRadius();
+	}
+	float getCutoffRadius() const
+	{
+		return CUTOFF_FACTOR * getSplitRadius();
+	}
+	uint32_t getCellsPerAxis() const
+	{
+		return m_cellsPerAxis;
+	}
+
+  private:
+	void createBuffers();
+	void createDescriptorSet();
+	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxParticleCount;
+	uint32_t m_cellsPerAxis;
+	uint32_t m_cellKeyBits;
+
+	std::unique_ptr<ParticleMeshSystem> m_particleMeshSystem;
+	std::unique_ptr<RadixSortSystem> m_radixSort;
+	std::unique_ptr<PgsBuffer> m_cellStartBuffer;
+	std::unique_ptr<PgsBuffer> m_cellEndBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	VkDescriptorSet m_descriptorSet;
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_cellKeysPipeline;
+	std::unique_ptr<PgsComputePipeline> m_cellRangesPipeline;
+	std::unique_ptr<PgsComputePipeline> m_shortRangePipeline;
+};
+
+} // namespace pgs
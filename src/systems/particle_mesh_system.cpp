@@ -0,0 +1,319 @@
+#include "particle_mesh_system.hpp"
+
+#include "../pgs_model.hpp"
+
+// std
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+namespace pgs
+{
+
+ParticleMeshSystem::ParticleMeshSystem(PgsDevice &device,
+									   VkDescriptorSetLayout globalSetLayout,
+									   uint32_t gridSize,
+									   float domainHalfWidth,
+									   float splitRadius)
+	: m_pgsDevice{device}, m_gridSize{gridSize}, m_fftSize{2 * gridSize},
+	  m_domainHalfWidth{domainHalfWidth}, m_splitRadius{splitRadius}
+{
+	if (gridSize < 2 || (gridSize & (gridSize - 1)) != 0)
+	{
+		throw std::runtime_error("particle mesh grid size must be a power of two!");
+	}
+
+	createBuffers();
+	createDescriptorSet();
+	createPipelineLayout(globalSetLayout);
+	createPipelines();
+	createGreensFunction();
+}
+
+ParticleMeshSystem::~ParticleMeshSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void ParticleMeshSystem::createBuffers()
+{
+	uint32_t fftCellCount = m_fftSize * m_fftSize;
+
+	m_densityBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												  sizeof(uint32_t),
+												  m_gridSize * m_gridSize,
+												  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_fftBufferA = std::make_unique<PgsBuffer>(m_pgsDevice,
+											   sizeof(glm::vec2),
+											   fftCellCount,
+											   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+												   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+												   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+											   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_fftBufferB = std::make_unique<PgsBuffer>(m_pgsDevice,
+											   sizeof(glm::vec2),
+											   fftCellCount,
+											   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+											   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_greensFunctionBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+														 sizeof(glm::vec2),
+														 fftCellCount,
+														 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+															 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+														 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void ParticleMeshSystem::createDescriptorSet()
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(1)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4)
+						   .build();
+
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+
+	auto densityInfo = m_densityBuffer->descriptorInfo();
+	auto fftAInfo = m_fftBufferA->descriptorInfo();
+	auto fftBInfo = m_fftBufferB->descriptorInfo();
+	auto greensFunctionInfo = m_greensFunctionBuffer->descriptorInfo();
+	auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+					  .writeBuffer(0, &densityInfo)
+					  .writeBuffer(1, &fftAInfo)
+					  .writeBuffer(2, &fftBInfo)
+					  .writeBuffer(3, &greensFunctionInfo)
+					  .build(m_descriptorSet);
+	assert(result && "Failed to build particle mesh descriptor set!");
+}
+
+void ParticleMeshSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(PushConstants);
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout,
+															m_setLayout->getDescriptorSetLayout()};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create particle mesh pipeline layout!");
+	}
+}
+
+void ParticleMeshSystem::createPipelines()
+{
+	// shaders that include gravity_common.glsl pick up the physics constants, the others ignore them
+	auto gravityConstants = PgsComputePipeline::gravityConstants();
+	m_depositPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															 "shaders/pm_deposit.comp.spv",
+															 m_pipelineLayout,
+															 gravityConstants);
+	m_packPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/pm_pack.comp.spv",
+														  m_pipelineLayout,
+														  gravityConstants);
+	m_fftPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														 "shaders/pm_fft.comp.spv",
+														 m_pipelineLayout,
+														 gravityConstants);
+	m_convolvePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															  "shaders/pm_convolve.comp.spv",
+															  m_pipelineLayout,
+															  gravityConstants);
+	m_interpolatePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+																 "shaders/pm_interpolate.comp.spv",
+																 m_pipelineLayout,
+																 gravityConstants);
+}
+
+void ParticleMeshSystem::createGreensFunction()
+{
+	// Real space potential of a unit mass for every cell offset, wrapped around so
+	// negative offsets land in the upper half of the padded grid
+	uint32_t fftCellCount = m_fftSize * m_fftSize;
+	float h = getCellSize();
+	std::vector<glm::vec2> kernel(fftCellCount);
+	for (uint32_t y = 0; y < m_fftSize; y++)
+	{
+		for (uint32_t x = 0; x < m_fftSize; x++)
+		{
+			float dx = static_cast<float>(x < m_fftSize / 2 ? static_cast<int>(x)
+															: static_cast<int>(x) - static_cast<int>(m_fftSize));
+			float dy = static_cast<float>(y < m_fftSize / 2 ? static_cast<int>(y)
+															: static_cast<int>(y) - static_cast<int>(m_fftSize));
+			float softenedDistance = std::sqrt((dx * dx + dy * dy) * h * h + PgsModel::DAMP);
+			float potential = -PgsModel::GRAV_CONSTANT / softenedDistance;
+			if (m_splitRadius > 0.0f)
+			{
+				potential *= std::erf(softenedDistance / (2.0f * m_splitRadius));
+			}
+			kernel[y * m_fftSize + x] = glm::vec2(potential, 0.0f);
+		}
+	}
+
+	PgsBuffer stagingBuffer{m_pgsDevice,
+							sizeof(glm::vec2),
+							fftCellCount,
+							VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+							VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+								VK_MEMORY_PROPERTY_HOST_COHERENT_BIT};
+	stagingBuffer.map();
+	stagingBuffer.writeToBuffer(kernel.data());
+	m_pgsDevice.copyBuffer(stagingBuffer.getBuffer(),
+						   m_fftBufferA->getBuffer(),
+						   stagingBuffer.getBufferSize());
+
+	// transform it once on the GPU and keep the result
+	VkCommandBuffer commandBuffer = m_pgsDevice.beginSingleTimeCommands();
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							1,
+							1,
+							&m_descriptorSet,
+							0,
+							nullptr);
+
+	PushConstants push{};
+	push.gridSize = m_gridSize;
+	push.fftSize = m_fftSize;
+	push.domainHalfWidth = m_domainHalfWidth;
+	recordFft(commandBuffer, push, -1.0f);
+
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 0,
+						 1,
+						 &barrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.size = m_fftBufferA->getBufferSize();
+	vkCmdCopyBuffer(commandBuffer,
+					m_fftBufferA->getBuffer(),
+					m_greensFunctionBuffer->getBuffer(),
+					1,
+					&copyRegion);
+	m_pgsDevice.endSingleTimeCommands(commandBuffer);
+}
+
+void ParticleMeshSystem::pushConstants(VkCommandBuffer commandBuffer, const PushConstants &push)
+{
+	vkCmdPushConstants(commandBuffer,
+					   m_pipelineLayout,
+					   VK_SHADER_STAGE_COMPUTE_BIT,
+					   0,
+					   sizeof(PushConstants),
+					   &push);
+}
+
+void ParticleMeshSystem::recordFft(VkCommandBuffer commandBuffer, PushConstants push, float sign)
+{
+	m_fftPipeline->bind(commandBuffer);
+	push.fftSign = sign;
+	push.flip = 0;
+
+	// rows then columns, 2 * log2(fftSize) passes in total so the result is back in A
+	for (uint32_t direction = 0; direction < 2; direction++)
+	{
+		push.fftDirection = direction;
+		for (uint32_t stage = 1; stage < m_fftSize; stage <<= 1)
+		{
+			push.fftStage = stage;
+			pushConstants(commandBuffer, push);
+			m_fftPipeline->compute(commandBuffer, m_fftSize * m_fftSize / 2);
+			PgsComputePipeline::computeBarrier(commandBuffer);
+			push.flip ^= 1;
+		}
+	}
+}
+
+void ParticleMeshSystem::computeAccelerations(VkCommandBuffer commandBuffer,
+											  VkDescriptorSet globalDescriptorSet,
+											  uint32_t particleCount)
+{
+	vkCmdFillBuffer(commandBuffer, m_densityBuffer->getBuffer(), 0, VK_WHOLE_SIZE, 0);
+
+	VkMemoryBarrier fillBarrier{};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &fillBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	std::vector<VkDescriptorSet> descriptorSets{globalDescriptorSet, m_descriptorSet};
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							static_cast<uint32_t>(descriptorSets.size()),
+							descriptorSets.data(),
+							0,
+							nullptr);
+
+	PushConstants push{};
+	push.particleCount = particleCount;
+	push.gridSize = m_gridSize;
+	push.fftSize = m_fftSize;
+	push.domainHalfWidth = m_domainHalfWidth;
+	pushConstants(commandBuffer, push);
+
+	uint32_t fftCellCount = m_fftSize * m_fftSize;
+
+	// mass assignment
+	m_depositPipeline->bind(commandBuffer);
+	m_depositPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_packPipeline->bind(commandBuffer);
+	m_packPipeline->compute(commandBuffer, fftCellCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	// Poisson solve as a convolution in frequency space
+	recordFft(commandBuffer, push, -1.0f);
+	pushConstants(commandBuffer, push);
+	m_convolvePipeline->bind(commandBuffer);
+	m_convolvePipeline->compute(commandBuffer, fftCellCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	recordFft(commandBuffer, push, 1.0f);
+
+	// force interpolation
+	pushConstants(commandBuffer, push);
+	m_interpolatePipeline->bind(commandBuffer);
+	m_interpolatePipeline->compute(commandBuffer, particleCount);
+}
+
+} // namespace pgs
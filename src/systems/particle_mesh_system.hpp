@@ -0,0 +1,105 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Particle-mesh (PM) force solver. Mass is deposited on a grid with
+ * cloud-in-cell weights, the potential is found by convolving it with the
+ * softened Green's function through a compute shader FFT, and the potential
+ * gradient is interpolated back to the particles. Cost is O(N + G^2 log G).
+ */
+class ParticleMeshSystem
+{
+  public:
+	static constexpr uint32_t DEFAULT_GRID_SIZE = 512;
+
+	// gridSize must be a power of two, the grid covers [-domainHalfWidth, domainHalfWidth]^2.
+	// A splitRadius above zero keeps only the long range erf part of the potential,
+	// the short range remainder is left to the caller (see P3MSystem).
+	ParticleMeshSystem(PgsDevice &device,
+					   VkDescriptorSetLayout globalSetLayout,
+					   uint32_t gridSize = DEFAULT_GRID_SIZE,
+					   float domainHalfWidth = 1.0f,
+					   float splitRadius = 0.0f);
+	~ParticleMeshSystem();
+
+	ParticleMeshSystem(const ParticleMeshSystem &) = delete;
+	ParticleMeshSystem &operator=(const ParticleMeshSystem &) = delete;
+
+	void computeAccelerations(VkCommandBuffer commandBuffer,
+							  VkDescriptorSet globalDescriptorSet,
+							  uint32_t particleCount);
+
+	uint32_t getGridSize() const
+	{
+		return m_gridSize;
+	}
+	float getCellSize() const
+	{
+		return 2.0f * m_domainHalfWidth / static_cast<float>(m_gridSize);
+	}
+	float getDomainHalfWidth() const
+	{
+		return m_domainHalfWidth;
+	}
+	float getSplitRadius() const
+	{
+		return m_splitRadius;
+	}
+
+  private:
+	struct PushConstants
+	{
+		uint32_t particleCount;
+		uint32_t gridSize;
+		uint32_t fftSize;
+		uint32_t fftStage;
+		uint32_t fftDirection;
+		float fftSign;
+		uint32_t flip;
+		float domainHalfWidth;
+	};
+
+	void createBuffers();
+	void createDescriptorSet();
+	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+	void createPipelines();
+	void createGreensFunction();
+
+	// Records a full 2D FFT of buffer A, the result ends up in buffer A again
+	void recordFft(VkCommandBuffer commandBuffer, PushConstants push, float sign);
+	void pushConstants(VkCommandBuffer commandBuffer, const PushConstants &push);
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_gridSize;
+	uint32_t m_fftSize;
+	float m_domainHalfWidth;
+	float m_splitRadius;
+
+	std::unique_ptr<PgsBuffer> m_densityBuffer;
+	std::unique_ptr<PgsBuffer> m_fftBufferA;
+	std::unique_ptr<PgsBuffer> m_fftBufferB;
+	std::unique_ptr<PgsBuffer> m_greensFunctionBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	VkDescriptorSet m_descriptorSet;
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_depositPipeline;
+	std::unique_ptr<PgsComputePipeline> m_packPipeline;
+	std::unique_ptr<PgsComputePipeline> m_fftPipeline;
+	std::unique_ptr<PgsComputePipeline> m_convolvePipeline;
+	std::unique_ptr<PgsComputePipeline> m_interpolatePipeline;
+};
+
+} // namespace pgs
@@ -7,18 +7,63 @@
 #include <glm/gtc/constants.hpp>
 
 // std
+#include <algorithm>
 #include <stdexcept>
 #include <cassert>
 #include <iostream>
+#include <string>
 
 namespace pgs
 {
-    ParticleSystem::ParticleSystem(PgsDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : m_pgsDevice{device}
+    // must match StepPush in step_common.glsl
+    struct StepPushConstants {
+        float frameTime;
+        uint32_t particleCount;
+        uint32_t sourceBegin;
+        uint32_t sourceEnd;
+    };
+
+    // must match CountPush in particle_count.comp
+    struct CountPushConstants {
+        uint32_t forceLocalSizeX;
+        uint32_t passLocalSizeX;
+    };
+
+    // must match the KERNEL_MODE values in gravity_common.glsl
+    static constexpr uint32_t KERNEL_MODE_INTEGRATE = 0;
+    static constexpr uint32_t KERNEL_MODE_ACCELERATIONS = 1;
+    static constexpr uint32_t KERNEL_MODE_JERKS = 2;
+    static constexpr uint32_t KERNEL_MODE_ACTIVE = 3;
+    static constexpr uint32_t KERNEL_MODE_ACCUMULATE = 4;
+
+    // must match RenderPush in particle.vert
+    struct RenderPushConstants {
+        uint32_t colormap;
+        uint32_t colorSource;
+        float colorScale;
+    };
+
+    ParticleSystem::ParticleSystem(PgsDevice &device,
+                                   VkRenderPass renderPass,
+                                   VkDescriptorSetLayout globalSetLayout,
+                                   uint32_t maxParticleCount) : m_pgsDevice{device}, m_globalSetLayout{globalSetLayout}, m_maxParticleCount{maxParticleCount}
     {
         createGraphicsPipelineLayout();
         createGraphicsPipeline(renderPass);
         createComputePipelineLayout(globalSetLayout);
-        createComputePipeline();
+        createComputePipelines();
+    }
+
+    uint32_t ParticleSystem::maxParticleCount(PgsDevice &device, ForceSolver solver, Integrator integrator)
+    {
+        VkDeviceSize elementSize = sizeof(glm::vec2);
+        if (solver == ForceSolver::BarnesHut) {
+            elementSize = std::max(elementSize, BarnesHutSystem::NODE_SIZE);
+        }
+        if (integrator == Integrator::RK4) {
+            elementSize = std::max(elementSize, IntegratorSystem::STAGE_SUM_SIZE);
+        }
+        return PgsModel::maxParticleCount(device, elementSize);
     }
 
     ParticleSystem::~ParticleSystem()
@@ -29,12 +74,25 @@ namespace pgs
 
     void ParticleSystem::createGraphicsPipelineLayout()
     {
+        // particle.vert pulls positions, velocities and color values from the state buffers
+        m_renderSetLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+            .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+            .build();
+        std::vector<VkDescriptorSetLayout> descriptorSetLayouts{m_renderSetLayout->getDescriptorSetLayout()};
+
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(RenderPushConstants);
+
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 0;
-        pipelineLayoutInfo.pSetLayouts = nullptr;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-        pipelineLayoutInfo.pPushConstantRanges = nullptr;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
         if (vkCreatePipelineLayout(m_pgsDevice.device(), &pipelineLayoutInfo, nullptr, &m_graphicsPipelineLayout) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create graphics pipeline layout!");
@@ -60,51 +118,891 @@ namespace pgs
     {
         std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout};
 
+        // per-step values are pushed, so a step never waits on a uniform buffer update
+        VkPushConstantRange pushConstantRange{};
+        pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushConstantRange.offset = 0;
+        pushConstantRange.size = sizeof(StepPushConstants);
+
         VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
         pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
         pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
         pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
         if (vkCreatePipelineLayout(m_pgsDevice.device(), &pipelineLayoutInfo, nullptr, &m_computePipelineLayout) !=
             VK_SUCCESS) {
             throw std::runtime_error("failed to create compute pipeline layout!");
         }
     }
 
-    void ParticleSystem::createComputePipeline() 
+    const char *ParticleSystem::forceKernelName(ForceKernel kernel)
+    {
+        switch (kernel) {
+            case ForceKernel::Direct:
+                return "direct";
+            case ForceKernel::Tiled:
+                return "tiled";
+            case ForceKernel::Subgroup:
+                return "subgroup";
+            case ForceKernel::Symmetric:
+                return "symmetric";
+            default:
+                return "unknown";
+        }
+    }
+
+    const char *ParticleSystem::forceSolverName(ForceSolver solver)
+    {
+        switch (solver) {
+            case ForceSolver::Direct:
+                return "direct";
+            case ForceSolver::BarnesHut:
+                return "barnes-hut";
+            case ForceSolver::ParticleMesh:
+                return "particle-mesh";
+            case ForceSolver::P3M:
+                return "p3m";
+            case ForceSolver::Restricted:
+                return "restricted";
+            default:
+                return "unknown";
+        }
+    }
+
+    bool ParticleSystem::isForceKernelSupported(ForceKernel kernel) const
+    {
+        if (kernel == ForceKernel::Subgroup) {
+            return m_pgsDevice.subgroupSupport.computeShuffle;
+        }
+        return true;
+    }
+
+    const char *ParticleSystem::integratorName(Integrator integrator)
+    {
+        switch (integrator) {
+            case Integrator::Euler:
+                return "euler";
+            case Integrator::Leapfrog:
+                return "leapfrog";
+            case Integrator::VelocityVerlet:
+                return "velocity-verlet";
+            case Integrator::RK4:
+                return "rk4";
+            case Integrator::Hermite:
+                return "hermite";
+            case Integrator::BlockTimesteps:
+                return "block-timesteps";
+            default:
+                return "unknown";
+        }
+    }
+
+    bool ParticleSystem::isSupported(ForceSolver solver, Integrator integrator)
+    {
+        return integrator != Integrator::Hermite || solver == ForceSolver::Direct ||
+               solver == ForceSolver::Restricted;
+    }
+
+    void ParticleSystem::setForceKernel(ForceKernel kernel)
+    {
+        m_forceKernel = kernel;
+        createSelectedSystems();
+    }
+
+    void ParticleSystem::setForceSolver(ForceSolver solver)
+    {
+        if (!isSupported(solver, m_integrator)) {
+            throw std::invalid_argument(std::string("force solver ") + forceSolverName(solver) +
+                                        " has no jerks for the " + integratorName(m_integrator) +
+                                        " integrator");
+        }
+        m_forceSolver = solver;
+        if (m_integratorSystem) {
+            m_integratorSystem->invalidateSavedForces();
+        }
+        createSelectedSystems();
+    }
+
+    void ParticleSystem::setIntegrator(Integrator integrator)
+    {
+        if (!isSupported(m_forceSolver, integrator)) {
+            throw std::invalid_argument(std::string("integrator ") + integratorName(integrator) +
+                                        " needs jerks, which the " + forceSolverName(m_forceSolver) +
+                                        " force solver does not sum");
+        }
+        m_integrator = integrator;
+        invalidateState();
+        createSelectedSystems();
+    }
+
+    void ParticleSystem::setSpatialSortInterval(uint32_t interval)
+    {
+        m_spatialSortInterval = interval;
+        m_stepsSinceSpatialSort = 0;
+        createSelectedSystems();
+    }
+
+    void ParticleSystem::setMergeParameters(float radius, uint32_t interval)
+    {
+        m_mergeRadius = radius;
+        m_mergeInterval = interval;
+        m_stepsSinceMerge = 0;
+        createSelectedSystems();
+    }
+
+    void ParticleSystem::createSelectedSystems()
+    {
+        switch (m_forceSolver) {
+            case ForceSolver::BarnesHut:
+                getBarnesHutSystem();
+                break;
+            case ForceSolver::ParticleMesh:
+                getParticleMeshSystem();
+                break;
+            case ForceSolver::P3M:
+                getP3MSystem();
+                break;
+            case ForceSolver::Direct:
+                if (m_forceKernel == ForceKernel::Symmetric) {
+                    getSymmetricForceSystem();
+                }
+                break;
+            default:
+                break;
+        }
+
+        // the rest allocate per slot of the model, they are created once one is bound
+        if (m_model == nullptr) {
+            return;
+        }
+        if (m_integrator == Integrator::BlockTimesteps) {
+            getBlockTimestepSystem();
+        } else if (m_integrator != Integrator::Euler) {
+            getIntegratorSystem();
+        }
+        // same conditions as recordSpatialSortIfDue and recordMergeIfDue
+        if (m_spatialSortInterval != 0 && m_integrator != Integrator::BlockTimesteps &&
+            m_forceSolver != ForceSolver::Restricted) {
+            getSpatialSortSystem();
+        }
+        if (m_mergeInterval != 0 && m_mergeRadius > 0.0f && m_forceSolver == ForceSolver::Direct &&
+            m_integrator != Integrator::BlockTimesteps) {
+            getMergeSystem();
+        }
+    }
+
+    BarnesHutSystem &ParticleSystem::getBarnesHutSystem()
+    {
+        if (!m_barnesHutSystem) {
+            m_barnesHutSystem = std::make_unique<BarnesHutSystem>(m_pgsDevice, m_globalSetLayout, m_maxParticleCount);
+        }
+        return *m_barnesHutSystem;
+    }
+
+    ParticleMeshSystem &ParticleSystem::getParticleMeshSystem()
+    {
+        if (!m_particleMeshSystem) {
+            m_particleMeshSystem =
+                std::make_unique<ParticleMeshSystem>(m_pgsDevice, m_globalSetLayout, m_particleMeshGridSize);
+        }
+        return *m_particleMeshSystem;
+    }
+
+    P3MSystem &ParticleSystem::getP3MSystem()
+    {
+        if (!m_p3mSystem) {
+            m_p3mSystem = std::make_unique<P3MSystem>(
+                m_pgsDevice,
+                m_globalSetLayout,
+                m_maxParticleCount,
+                m_p3mGridSize,
+                m_p3mSplitRadius);
+        }
+        return *m_p3mSystem;
+    }
+
+    SymmetricForceSystem &ParticleSystem::getSymmetricForceSystem()
+    {
+        if (!m_symmetricForceSystem) {
+            m_symmetricForceSystem =
+                std::make_unique<SymmetricForceSystem>(m_pgsDevice, m_globalSetLayout, m_maxParticleCount);
+        }
+        return *m_symmetricForceSystem;
+    }
+
+    BlockTimestepSystem &ParticleSystem::getBlockTimestepSystem()
+    {
+        if (!m_blockTimestepSystem) {
+            m_blockTimestepSystem = std::make_unique<BlockTimestepSystem>(m_pgsDevice);
+            if (m_model != nullptr) {
+                m_blockTimestepSystem->bindState(*m_model, *m_accelerationBuffer, *m_activeListBuffer);
+            }
+        }
+        return *m_blockTimestepSystem;
+    }
+
+    IntegratorSystem &ParticleSystem::getIntegratorSystem()
+    {
+        if (!m_integratorSystem) {
+            assert(m_model != nullptr && "bindModel was not called");
+            m_integratorSystem = std::make_unique<IntegratorSystem>(m_pgsDevice);
+            m_integratorSystem->bindState(*m_model, *m_accelerationBuffer, *m_jerkBuffer);
+        }
+        return *m_integratorSystem;
+    }
+
+    SpatialSortSystem &ParticleSystem::getSpatialSortSystem()
+    {
+        if (!m_spatialSortSystem) {
+            assert(m_model != nullptr && "bindModel was not called");
+            m_spatialSortSystem = std::make_unique<SpatialSortSystem>(m_pgsDevice, m_maxParticleCount);
+            m_spatialSortSystem->bindState(*m_model);
+        }
+        return *m_spatialSortSystem;
+    }
+
+    MergeSystem &ParticleSystem::getMergeSystem()
+    {
+        if (!m_mergeSystem) {
+            assert(m_model != nullptr && "bindModel was not called");
+            m_mergeSystem = std::make_unique<MergeSystem>(m_pgsDevice, m_maxParticleCount);
+            m_mergeSystem->bindState(*m_model);
+        }
+        return *m_mergeSystem;
+    }
+
+    void ParticleSystem::createComputePipelines() 
     {
         assert(m_computePipelineLayout != nullptr && "Cannot create compute pipeline before compute pipeline layout");
 
-        m_computePipeline = std::make_unique<PgsComputePipeline>(
-            m_pgsDevice,
+        // indexed by ForceKernel. The symmetric kernel runs in SymmetricForceSystem, its
+        // slot only serves the active, chunked and fused Euler paths with the tiled kernel.
+        const std::vector<std::string> shaderPaths{
             "shaders/particle.comp.spv",
+            "shaders/particle_tiled.comp.spv",
+            isForceKernelSupported(ForceKernel::Subgroup) ? "shaders/particle_subgroup.comp.spv"
+                                                          : "shaders/particle_tiled.comp.spv",
+            "shaders/particle_tiled.comp.spv"};
+        assert(shaderPaths.size() == static_cast<size_t>(ForceKernel::Count) && "Missing force kernel shader");
+
+        auto kernelSpecialization = PgsComputePipeline::gravityConstants();
+        kernelSpecialization.setLocalSizeX(m_kernelLocalSizeX)
+            .setUint(PgsComputePipeline::UNROLL_CONSTANT_ID, m_kernelUnroll);
+
+        auto forceSpecialization = kernelSpecialization;
+        auto activeForceSpecialization = kernelSpecialization;
+        auto chunkSpecialization = kernelSpecialization;
+        kernelSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, KERNEL_MODE_INTEGRATE);
+        forceSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, KERNEL_MODE_ACCELERATIONS);
+        activeForceSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, KERNEL_MODE_ACTIVE);
+        chunkSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, KERNEL_MODE_ACCUMULATE);
+
+        m_computePipelines.clear();
+        m_forcePipelines.clear();
+        m_activeForcePipelines.clear();
+        m_chunkForcePipelines.clear();
+        // the subgroup kernel shares most positions with the widest subgroups, pin
+        // those where the device can and the work group holds whole subgroups
+        const auto &subgroupSupport = m_pgsDevice.subgroupSupport;
+        uint32_t subgroupSize = 0;
+        if (isForceKernelSupported(ForceKernel::Subgroup) && subgroupSupport.sizeControl &&
+            m_kernelLocalSizeX % subgroupSupport.maxSubgroupSize == 0) {
+            subgroupSize = subgroupSupport.maxSubgroupSize;
+        }
+
+        for (size_t k = 0; k < shaderPaths.size(); k++) {
+            uint32_t requiredSubgroupSize =
+                k == static_cast<size_t>(ForceKernel::Subgroup) ? subgroupSize : 0;
+            m_computePipelines.push_back(std::make_unique<PgsComputePipeline>(
+                m_pgsDevice,
+                shaderPaths[k],
+                m_computePipelineLayout,
+                kernelSpecialization,
+                requiredSubgroupSize));
+            m_forcePipelines.push_back(std::make_unique<PgsComputePipeline>(
+                m_pgsDevice,
+                shaderPaths[k],
+                m_computePipelineLayout,
+                forceSpecialization,
+                requiredSubgroupSize));
+            m_activeForcePipelines.push_back(std::make_unique<PgsComputePipeline>(
+                m_pgsDevice,
+                shaderPaths[k],
+                m_computePipelineLayout,
+                activeForceSpecialization,
+                requiredSubgroupSize));
+            m_chunkForcePipelines.push_back(std::make_unique<PgsComputePipeline>(
+                m_pgsDevice,
+                shaderPaths[k],
+                m_computePipelineLayout,
+                chunkSpecialization,
+                requiredSubgroupSize));
+        }
+
+        // only particle.comp sums jerks
+        forceSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, KERNEL_MODE_JERKS);
+        m_jerkPipeline = std::make_unique<PgsComputePipeline>(
+            m_pgsDevice,
+            shaderPaths[static_cast<size_t>(ForceKernel::Direct)],
+            m_computePipelineLayout,
+            forceSpecialization);
+
+        // the restricted solver has one pipeline per mode it runs in, sized like the
+        // all-pairs kernels so it shares their indirect dispatch arguments
+        auto restrictedSpecialization = PgsComputePipeline::gravityConstants();
+        restrictedSpecialization.setLocalSizeX(m_kernelLocalSizeX);
+        m_restrictedPipelines.clear();
+        for (uint32_t mode = KERNEL_MODE_INTEGRATE; mode <= KERNEL_MODE_ACTIVE; mode++) {
+            restrictedSpecialization.setUint(PgsComputePipeline::KERNEL_MODE_CONSTANT_ID, mode);
+            m_restrictedPipelines.push_back(std::make_unique<PgsComputePipeline>(
+                m_pgsDevice,
+                "shaders/particle_restricted.comp.spv",
+                m_computePipelineLayout,
+                restrictedSpecialization));
+        }
+
+        m_integratePipeline = std::make_unique<PgsComputePipeline>(
+            m_pgsDevice,
+            "shaders/integrate.comp.spv",
+            m_computePipelineLayout,
+            PgsComputePipeline::gravityConstants());
+
+        m_countPipeline = std::make_unique<PgsComputePipeline>(
+            m_pgsDevice,
+            "shaders/particle_count.comp.spv",
             m_computePipelineLayout);
     }
 
-    void ParticleSystem::computeParticles(FrameInfo& frameInfo) 
+    void ParticleSystem::bindModel(PgsModel &model,
+                                   PgsBuffer &accelerationBuffer,
+                                   PgsBuffer &jerkBuffer,
+                                   PgsBuffer &activeListBuffer)
     {
+        m_model = &model;
+        m_accelerationBuffer = &accelerationBuffer;
+        m_jerkBuffer = &jerkBuffer;
+        m_activeListBuffer = &activeListBuffer;
+        if (m_integratorSystem) {
+            m_integratorSystem->bindState(model, accelerationBuffer, jerkBuffer);
+        }
+        if (m_blockTimestepSystem) {
+            m_blockTimestepSystem->bindState(model, accelerationBuffer, activeListBuffer);
+        }
+        if (m_spatialSortSystem) {
+            m_spatialSortSystem->bindState(model);
+        }
+        if (m_mergeSystem) {
+            m_mergeSystem->bindState(model);
+        }
+        createSelectedSystems();
+        m_countBuffer = model.getCountBuffer().getBuffer();
+        m_countArgsStale = true;
+        m_massiveCount = model.getMassiveCount();
+    }
+
+    void ParticleSystem::invalidateState()
+    {
+        if (m_integratorSystem) {
+            m_integratorSystem->invalidateSavedForces();
+        }
+        if (m_blockTimestepSystem) {
+            m_blockTimestepSystem->invalidate();
+        }
+        m_countArgsStale = true;
+    }
+
+    void ParticleSystem::recordCountUpdate(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet)
+    {
+        m_countPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_computePipelineLayout,
+            0,
+            1,
+            &globalDescriptorSet,
+            0,
+            nullptr);
+
+        CountPushConstants push{};
+        push.forceLocalSizeX = m_kernelLocalSizeX;
+        push.passLocalSizeX = PgsComputePipeline::LOCAL_SIZE_X;
+        vkCmdPushConstants(
+            commandBuffer,
+            m_computePipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(CountPushConstants),
+            &push);
+
+        m_countPipeline->dispatch(commandBuffer, 1);
+        PgsComputePipeline::indirectBarrier(commandBuffer);
+    }
+
+    void ParticleSystem::computeParticles(
+        FrameInfo& frameInfo,
+        uint32_t substeps,
+        const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets)
+    {
+        // the force kernel work group size changed since the arguments were written
+        if (m_countArgsStale) {
+            PgsComputePipeline::stepBeginBarrier(frameInfo.commandBuffer);
+            recordCountUpdate(frameInfo.commandBuffer, globalDescriptorSets[frameInfo.model->getStateIndex()]);
+            m_countArgsStale = false;
+        }
+
+        // every substep reads the state the previous one wrote, the begin barrier of
+        // each step orders it after the last
+        for (uint32_t substep = 0; substep < substeps; substep++) {
+            recordMergeIfDue(frameInfo, globalDescriptorSets);
+            recordSpatialSortIfDue(frameInfo);
+            frameInfo.globalDescriptorSet = globalDescriptorSets[frameInfo.model->getStateIndex()];
+            recordStep(frameInfo, globalDescriptorSets);
+            frameInfo.model->swapStateBuffers();
+        }
+
+        PgsComputePipeline::computeToVertexBarrier(frameInfo.commandBuffer);
+    }
+
+    void ParticleSystem::recordSpatialSortIfDue(FrameInfo& frameInfo)
+    {
+        // the restricted solver's sources are the leading slots, which must stay put
+        if (m_spatialSortInterval == 0 || m_integrator == Integrator::BlockTimesteps ||
+            m_forceSolver == ForceSolver::Restricted) {
+            return;
+        }
+        if (++m_stepsSinceSpatialSort < m_spatialSortInterval) {
+            return;
+        }
+        m_stepsSinceSpatialSort = 0;
+
+        // the sort reads the last step's state and writes the other buffer like a step
+        PgsComputePipeline::stepBeginBarrier(frameInfo.commandBuffer);
+        getSpatialSortSystem().recordSort(frameInfo.commandBuffer, *frameInfo.model);
+        frameInfo.model->swapStateBuffers();
+        // saved accelerations are indexed by slot and no longer match the particles
+        if (m_integratorSystem) {
+            m_integratorSystem->invalidateSavedForces();
+        }
+    }
+
+    void ParticleSystem::recordMergeIfDue(
+        FrameInfo& frameInfo,
+        const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets)
+    {
+        if (m_mergeInterval == 0 || m_mergeRadius <= 0.0f || m_forceSolver != ForceSolver::Direct ||
+            m_integrator == Integrator::BlockTimesteps) {
+            return;
+        }
+        if (++m_stepsSinceMerge < m_mergeInterval) {
+            return;
+        }
+        m_stepsSinceMerge = 0;
+
+        // the merge reads the last step's state and writes the other buffer like a step
+        PgsComputePipeline::stepBeginBarrier(frameInfo.commandBuffer);
+        getMergeSystem().recordMerge(frameInfo.commandBuffer, *frameInfo.model, m_mergeRadius);
+        frameInfo.model->swapStateBuffers();
+        // saved accelerations are indexed by slot and no longer match the particles
+        if (m_integratorSystem) {
+            m_integratorSystem->invalidateSavedForces();
+        }
+        recordCountUpdate(frameInfo.commandBuffer, globalDescriptorSets[frameInfo.model->getStateIndex()]);
+    }
+
+    void ParticleSystem::recordStep(
+        FrameInfo& frameInfo,
+        const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets)
+    {
+        VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+        uint32_t particleCount = frameInfo.model->getParticleCount();
+        uint32_t stateIndex = frameInfo.model->getStateIndex();
+
+        PgsComputePipeline::stepBeginBarrier(commandBuffer);
+
+        if (m_integrator == Integrator::Euler) {
+            if (m_forceSolver == ForceSolver::Restricted) {
+                recordRestrictedForces(commandBuffer,
+                                       frameInfo.globalDescriptorSet,
+                                       KERNEL_MODE_INTEGRATE,
+                                       particleCount,
+                                       frameInfo.frameTime);
+                return;
+            }
+            // the all-pairs kernels integrate in the same pass, unless the sum is chunked
+            if (m_forceSolver == ForceSolver::Direct && !isForceChunked(particleCount)) {
+                recordForceKernel(commandBuffer,
+                                  frameInfo.globalDescriptorSet,
+                                  m_forceKernel,
+                                  particleCount,
+                                  frameInfo.frameTime,
+                                  m_countBuffer);
+                return;
+            }
+            recordForces(commandBuffer, frameInfo.globalDescriptorSet, particleCount, false);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+            recordIntegrate(commandBuffer, frameInfo.globalDescriptorSet, particleCount, frameInfo.frameTime, m_countBuffer);
+            return;
+        }
+
+        // stages leave their trial state in the next state buffers, which the next
+        // state's global set reads
+        VkDescriptorSet trialDescriptorSet =
+            globalDescriptorSets[(stateIndex + 1) % PgsModel::STATE_BUFFER_COUNT];
+
+        if (m_integrator == Integrator::BlockTimesteps) {
+            auto &blockTimestepSystem = getBlockTimestepSystem();
+            if (!blockTimestepSystem.isInitialized()) {
+                recordForces(commandBuffer, frameInfo.globalDescriptorSet, particleCount, false);
+                PgsComputePipeline::computeBarrier(commandBuffer);
+                blockTimestepSystem.recordInit(commandBuffer, stateIndex, particleCount, frameInfo.frameTime);
+                PgsComputePipeline::computeBarrier(commandBuffer);
+            }
+            blockTimestepSystem.recordDrift(
+                commandBuffer, stateIndex, particleCount, frameInfo.frameTime, m_kernelLocalSizeX);
+            recordActiveForces(commandBuffer, trialDescriptorSet, particleCount);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+            blockTimestepSystem.recordKick(commandBuffer, stateIndex, particleCount, frameInfo.frameTime);
+            return;
+        }
+
+        auto &integratorSystem = getIntegratorSystem();
+
+        auto scheme = static_cast<IntegratorSystem::Scheme>(static_cast<uint32_t>(m_integrator) - 1);
+        bool withJerks = m_integrator == Integrator::Hermite;
+
+        if (!IntegratorSystem::startsFromSavedForces(scheme)) {
+            recordForces(commandBuffer, frameInfo.globalDescriptorSet, particleCount, withJerks);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+        } else if (!integratorSystem.hasSavedForces()) {
+            recordForces(commandBuffer, frameInfo.globalDescriptorSet, particleCount, withJerks);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+            integratorSystem.recordSaveForces(commandBuffer, stateIndex, particleCount);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+        }
+
+        uint32_t stageCount = IntegratorSystem::stageCount(scheme);
+        for (uint32_t stage = 0; stage < stageCount; stage++) {
+            if (stage > 0) {
+                PgsComputePipeline::computeBarrier(commandBuffer);
+                recordForces(commandBuffer, trialDescriptorSet, particleCount, withJerks);
+                PgsComputePipeline::computeBarrier(commandBuffer);
+            }
+            integratorSystem.recordStage(commandBuffer, scheme, stage, stateIndex, particleCount, frameInfo.frameTime);
+        }
+    }
+
+    void ParticleSystem::recordForces(VkCommandBuffer commandBuffer,
+                                      VkDescriptorSet globalDescriptorSet,
+                                      uint32_t particleCount,
+                                      bool withJerks)
+    {
+        if (m_forceSolver == ForceSolver::Restricted) {
+            recordRestrictedForces(commandBuffer,
+                                   globalDescriptorSet,
+                                   withJerks ? KERNEL_MODE_JERKS : KERNEL_MODE_ACCELERATIONS,
+                                   particleCount,
+                                   0.0f);
+            return;
+        }
+        if (!withJerks && m_forceSolver == ForceSolver::Direct && isForceChunked(particleCount)) {
+            recordChunkedForces(commandBuffer, globalDescriptorSet, particleCount);
+            return;
+        }
+        if (!withJerks && m_forceSolver == ForceSolver::Direct && m_forceKernel == ForceKernel::Symmetric) {
+            getSymmetricForceSystem().computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+            return;
+        }
+        assert((!withJerks || m_forceSolver == ForceSolver::Direct) && "Only the all-pairs kernel sums jerks");
+        if (m_forceSolver == ForceSolver::Direct) {
+            auto &forcePipeline = withJerks ? m_jerkPipeline : m_forcePipelines[static_cast<size_t>(m_forceKernel)];
+            forcePipeline->bind(commandBuffer);
+            vkCmdBindDescriptorSets(
+                commandBuffer,
+                VK_PIPELINE_BIND_POINT_COMPUTE,
+                m_computePipelineLayout,
+                0,
+                1,
+                &globalDescriptorSet,
+                0,
+                nullptr);
+            // forces only, the time step is unused
+            pushStepConstants(commandBuffer, particleCount, 0.0f);
+            if (m_countBuffer != VK_NULL_HANDLE) {
+                forcePipeline->dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::FORCE_GROUPS_OFFSET);
+            } else {
+                forcePipeline->compute(commandBuffer, particleCount);
+            }
+            return;
+        }
+
+        switch (m_forceSolver) {
+            case ForceSolver::BarnesHut:
+                getBarnesHutSystem().computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+                break;
+            case ForceSolver::ParticleMesh:
+                getParticleMeshSystem().computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+                break;
+            case ForceSolver::P3M:
+            default:
+                getP3MSystem().computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+                break;
+        }
+    }
+
+    void ParticleSystem::recordChunkedForces(VkCommandBuffer commandBuffer,
+                                             VkDescriptorSet globalDescriptorSet,
+                                             uint32_t particleCount)
+    {
+        auto &chunkPipeline = m_chunkForcePipelines[static_cast<size_t>(m_forceKernel)];
+        chunkPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_computePipelineLayout,
+            0,
+            1,
+            &globalDescriptorSet,
+            0,
+            nullptr);
+
+        // every chunk reads the sums of the one before, the barriers also give the
+        // device a dispatch boundary to preempt at
+        for (uint32_t sourceBegin = 0; sourceBegin < particleCount; sourceBegin += m_forceChunkSize) {
+            if (sourceBegin > 0) {
+                PgsComputePipeline::computeBarrier(commandBuffer);
+            }
+            uint32_t sourceEnd = sourceBegin + std::min(m_forceChunkSize, particleCount - sourceBegin);
+            pushStepConstants(commandBuffer, particleCount, 0.0f, sourceBegin, sourceEnd);
+            if (m_countBuffer != VK_NULL_HANDLE) {
+                chunkPipeline->dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::FORCE_GROUPS_OFFSET);
+            } else {
+                chunkPipeline->compute(commandBuffer, particleCount);
+            }
+        }
+    }
+
+    void ParticleSystem::recordActiveForces(VkCommandBuffer commandBuffer,
+                                            VkDescriptorSet globalDescriptorSet,
+                                            uint32_t particleCount)
+    {
+        if (m_forceSolver == ForceSolver::Restricted) {
+            recordRestrictedForces(commandBuffer, globalDescriptorSet, KERNEL_MODE_ACTIVE, particleCount, 0.0f);
+            return;
+        }
+        // the other solvers build their structures from all particles anyway, only the
+        // kick is limited to the active ones
+        if (m_forceSolver != ForceSolver::Direct) {
+            recordForces(commandBuffer, globalDescriptorSet, particleCount, false);
+            return;
+        }
+
+        auto &forcePipeline = m_activeForcePipelines[static_cast<size_t>(m_forceKernel)];
+        forcePipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_computePipelineLayout,
+            0,
+            1,
+            &globalDescriptorSet,
+            0,
+            nullptr);
+        pushStepConstants(commandBuffer, particleCount, 0.0f);
+        forcePipeline->dispatchIndirect(
+            commandBuffer,
+            getBlockTimestepSystem().getActiveListBuffer(),
+            BlockTimestepSystem::FORCE_DISPATCH_OFFSET);
+    }
+
+    void ParticleSystem::recordRestrictedForces(VkCommandBuffer commandBuffer,
+                                                VkDescriptorSet globalDescriptorSet,
+                                                uint32_t kernelMode,
+                                                uint32_t particleCount,
+                                                float frameTime)
+    {
+        auto &restrictedPipeline = m_restrictedPipelines[kernelMode];
+        restrictedPipeline->bind(commandBuffer);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_computePipelineLayout,
+            0,
+            1,
+            &globalDescriptorSet,
+            0,
+            nullptr);
+        // the massive bodies are the only sources
+        pushStepConstants(commandBuffer, particleCount, frameTime, 0, m_massiveCount);
+
+        if (kernelMode == KERNEL_MODE_ACTIVE) {
+            restrictedPipeline->dispatchIndirect(
+                commandBuffer,
+                getBlockTimestepSystem().getActiveListBuffer(),
+                BlockTimestepSystem::FORCE_DISPATCH_OFFSET);
+        } else if (m_countBuffer != VK_NULL_HANDLE) {
+            restrictedPipeline->dispatchIndirect(commandBuffer, m_countBuffer, PgsModel::FORCE_GROUPS_OFFSET);
+        } else {
+            restrictedPipeline->compute(commandBuffer, particleCount);
+        }
+    }
+
+    void ParticleSystem::recordForceKernel(VkCommandBuffer commandBuffer,
+                                           VkDescriptorSet globalDescriptorSet,
+                                           ForceKernel kernel,
+                                           uint32_t particleCount,
+                                           float frameTime,
+                                           VkBuffer countBuffer)
+    {
+        // the symmetric sum needs its reduction pass before anything can integrate
+        if (kernel == ForceKernel::Symmetric) {
+            getSymmetricForceSystem().computeAccelerations(commandBuffer, globalDescriptorSet, particleCount);
+            PgsComputePipeline::computeBarrier(commandBuffer);
+            recordIntegrate(commandBuffer, globalDescriptorSet, particleCount, frameTime, countBuffer);
+            return;
+        }
+
+        auto &computePipeline = m_computePipelines[static_cast<size_t>(kernel)];
+
         // bind compute pipeline
-        m_computePipeline->bind(frameInfo.commandBuffer);
+        computePipeline->bind(commandBuffer);
 
         // bind descriptor sets
         vkCmdBindDescriptorSets(
-            frameInfo.commandBuffer,
+            commandBuffer,
             VK_PIPELINE_BIND_POINT_COMPUTE,
             m_computePipelineLayout,
             0,
             1,
-            &frameInfo.globalDescriptorSet,
+            &globalDescriptorSet,
             0,
             nullptr);
 
+        pushStepConstants(commandBuffer, particleCount, frameTime);
+
         // dispatch compute job
-        m_computePipeline->compute(frameInfo.commandBuffer);
+        if (countBuffer != VK_NULL_HANDLE) {
+            computePipeline->dispatchIndirect(commandBuffer, countBuffer, PgsModel::FORCE_GROUPS_OFFSET);
+        } else {
+            computePipeline->compute(commandBuffer, particleCount);
+        }
+    }
+
+    void ParticleSystem::setParticleMeshGridSize(uint32_t gridSize)
+    {
+        if (gridSize == m_particleMeshGridSize) {
+            return;
+        }
+        m_particleMeshGridSize = gridSize;
+        if (!m_particleMeshSystem) {
+            return;
+        }
+        // the old grid may still be referenced by frames in flight
+        vkDeviceWaitIdle(m_pgsDevice.device());
+        m_particleMeshSystem.reset();
+        getParticleMeshSystem();
+    }
+
+    void ParticleSystem::configureForceKernels(uint32_t localSizeX, uint32_t unroll)
+    {
+        if (localSizeX == m_kernelLocalSizeX && unroll == m_kernelUnroll) {
+            return;
+        }
+        // the old pipelines may still be referenced by frames in flight
+        vkDeviceWaitIdle(m_pgsDevice.device());
+        m_kernelLocalSizeX = localSizeX;
+        m_kernelUnroll = unroll;
+        createComputePipelines();
+        m_countArgsStale = true;
+    }
+
+    void ParticleSystem::setP3MParameters(uint32_t gridSize, float splitRadius)
+    {
+        m_p3mGridSize = gridSize;
+        m_p3mSplitRadius = splitRadius;
+        if (!m_p3mSystem) {
+            return;
+        }
+        // the old grid and cell list may still be referenced by frames in flight
+        vkDeviceWaitIdle(m_pgsDevice.device());
+        m_p3mSystem.reset();
+        getP3MSystem();
+    }
+
+    void ParticleSystem::recordIntegrate(VkCommandBuffer commandBuffer,
+                                         VkDescriptorSet globalDescriptorSet,
+                                         uint32_t particleCount,
+                                         float frameTime,
+                                         VkBuffer countBuffer)
+    {
+        m_integratePipeline->bind(commandBuffer);
+
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_computePipelineLayout,
+            0,
+            1,
+            &globalDescriptorSet,
+            0,
+            nullptr);
+
+        pushStepConstants(commandBuffer, particleCount, frameTime);
+
+        if (countBuffer != VK_NULL_HANDLE) {
+            m_integratePipeline->dispatchIndirect(commandBuffer, countBuffer, PgsModel::PASS_GROUPS_OFFSET);
+        } else {
+            m_integratePipeline->compute(commandBuffer, particleCount);
+        }
+    }
+
+    void ParticleSystem::pushStepConstants(VkCommandBuffer commandBuffer,
+                                           uint32_t particleCount,
+                                           float frameTime,
+                                           uint32_t sourceBegin,
+                                           uint32_t sourceEnd)
+    {
+        StepPushConstants push{};
+        push.frameTime = frameTime;
+        push.particleCount = particleCount;
+        push.sourceBegin = sourceBegin;
+        push.sourceEnd = sourceEnd;
+        vkCmdPushConstants(
+            commandBuffer,
+            m_computePipelineLayout,
+            VK_SHADER_STAGE_COMPUTE_BIT,
+            0,
+            sizeof(StepPushConstants),
+            &push);
     }
 
     void ParticleSystem::renderParticles(FrameInfo& frameInfo) 
     {
         // dispatch graphics jobs
         m_graphicsPipeline->bind(frameInfo.commandBuffer);
-        frameInfo.model->bind(frameInfo.commandBuffer);
+        vkCmdBindDescriptorSets(
+            frameInfo.commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_graphicsPipelineLayout,
+            0,
+            1,
+            &frameInfo.renderDescriptorSet,
+            0,
+            nullptr);
+
+        RenderPushConstants push{};
+        push.colormap = static_cast<uint32_t>(m_colormap);
+        push.colorSource = static_cast<uint32_t>(m_colorSource);
+        push.colorScale = m_colorScale;
+        vkCmdPushConstants(
+            frameInfo.commandBuffer,
+            m_graphicsPipelineLayout,
+            VK_SHADER_STAGE_VERTEX_BIT,
+            0,
+            sizeof(RenderPushConstants),
+            &push);
+
         frameInfo.model->draw(frameInfo.commandBuffer);
     }
 
@@ -4,10 +4,21 @@
 #include "../pgs_frame_info.hpp"
 #include "../pipelines/pgs_graphicsPipeline.hpp"
 #include "../pipelines/pgs_computePipeline.hpp"
+#include "../pgs_descriptors.hpp"
+#include "barnes_hut_system.hpp"
+#include "block_timestep_system.hpp"
+#include "integrator_system.hpp"
+#include "merge_system.hpp"
+#include "p3m_system.hpp"
+#include "particle_mesh_system.hpp"
+#include "spatial_sort_system.hpp"
+#include "symmetric_force_system.hpp"
 //#include "pgs_computePipeline.hpp"
 #include "pgs_buffer.hpp"
 
 // std
+#include <array>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -15,26 +26,279 @@ namespace pgs {
 class ParticleSystem {
 
  public:
-  ParticleSystem(PgsDevice &device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+  // Selectable all-pairs gravity kernels
+  enum class ForceKernel : uint32_t {
+    Direct = 0,  // every invocation streams all positions from the SSBO
+    Tiled,       // positions are staged through workgroup shared memory
+    Subgroup,    // positions are passed between subgroup lanes with shuffles
+    Symmetric,   // every pair is evaluated once, see SymmetricForceSystem
+    Count
+  };
+
+  // Selectable force engines
+  enum class ForceSolver : uint32_t {
+    Direct = 0,  // all-pairs, using the selected ForceKernel
+    BarnesHut,   // GPU tree code, see BarnesHutSystem
+    ParticleMesh,  // grid based FFT Poisson solver, see ParticleMeshSystem
+    P3M,         // particle-mesh long range plus cell list short range, see P3MSystem
+    Restricted,  // only the model's massive bodies pull, O(N M), see particle_restricted.comp
+    Count
+  };
+
+  // Selectable time integrators, all but Euler run through IntegratorSystem
+  enum class Integrator : uint32_t {
+    Euler = 0,       // semi-implicit, one force evaluation fused into the step
+    Leapfrog,        // kick-drift-kick, one force evaluation per step
+    VelocityVerlet,  // one force evaluation per step
+    RK4,             // four force evaluations per step
+    Hermite,         // fourth order with jerks, one all-pairs evaluation per step
+    BlockTimesteps,  // kick-drift-kick with per-particle power of two steps, see BlockTimestepSystem
+    Count
+  };
+
+  // Colormaps applied in particle.vert, indices must match COLORMAP_STOPS
+  enum class Colormap : uint32_t {
+    Classic = 0,  // light blue to white
+    Viridis,
+    Inferno,
+    Grayscale,
+    Count
+  };
+
+  // Per-particle scalar mapped through the colormap
+  enum class ColorSource : uint32_t {
+    Acceleration = 0,  // magnitude of the last step's acceleration
+    Speed,             // magnitude of the velocity
+    Count
+  };
+
+  static const char *forceKernelName(ForceKernel kernel);
+  static const char *forceSolverName(ForceSolver solver);
+  static const char *integratorName(Integrator integrator);
+  // False if the kernel needs device features PgsDevice did not find, selecting it
+  // then runs the kernel it falls back to
+  bool isForceKernelSupported(ForceKernel kernel) const;
+
+  // Most particles every per-particle buffer of this solver and integrator still fits
+  // on the device: the model's vec2 state, BarnesHutSystem's tree nodes and RK4's
+  // stage sums. Below PgsModel::maxParticleCount for the wider ones.
+  static uint32_t maxParticleCount(PgsDevice &device, ForceSolver solver, Integrator integrator);
+
+  ParticleSystem(PgsDevice &device,
+                 VkRenderPass renderPass,
+                 VkDescriptorSetLayout globalSetLayout,
+                 uint32_t maxParticleCount);
   ~ParticleSystem();
 
   ParticleSystem(const ParticleSystem &) = delete;
   ParticleSystem &operator=(const ParticleSystem &) = delete;
 
   void renderParticles(FrameInfo &frameInfo);
-  void computeParticles(FrameInfo &frameInfo);
+  // Records substeps steps of frameInfo.frameTime into one command buffer, each
+  // reading the model's current state buffer, writing the other and swapping them.
+  // globalDescriptorSets is indexed by the state buffer a step reads.
+  void computeParticles(FrameInfo &frameInfo,
+                        uint32_t substeps,
+                        const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets);
+
+  // Points the integrator passes at the model's state buffers and at the buffers the
+  // force solvers write, must be called before stepping with any integrator but Euler.
+  // activeListBuffer is bound to the global sets as well, see BlockTimestepSystem.
+  // Steps after this dispatch over the model's live count, see PgsModel::CountArgs.
+  void bindModel(PgsModel &model,
+                 PgsBuffer &accelerationBuffer,
+                 PgsBuffer &jerkBuffer,
+                 PgsBuffer &activeListBuffer);
+
+  // Call after the bound model's particles were replaced from the host, see
+  // PgsModel::writeParticles. Saved forces, block timestep levels and the indirect
+  // arguments are rebuilt from the new state before the next step.
+  void invalidateState();
+
+  // Records one semi-implicit Euler step using the given kernel. Dispatches over
+  // particleCount particles, or indirectly over the live count when countBuffer is
+  // the model's count buffer; the kernels stop at the live count either way.
+  void recordForceKernel(VkCommandBuffer commandBuffer,
+                         VkDescriptorSet globalDescriptorSet,
+                         ForceKernel kernel,
+                         uint32_t particleCount,
+                         float frameTime,
+                         VkBuffer countBuffer = VK_NULL_HANDLE);
+
+  // Integrates every particle with the acceleration buffer written by a solver pass,
+  // dispatched like recordForceKernel
+  void recordIntegrate(VkCommandBuffer commandBuffer,
+                       VkDescriptorSet globalDescriptorSet,
+                       uint32_t particleCount,
+                       float frameTime,
+                       VkBuffer countBuffer = VK_NULL_HANDLE);
+
+  // Rewrites the model's indirect draw and dispatch arguments from the live count on
+  // the GPU, record after any pass that changes the count
+  void recordCountUpdate(VkCommandBuffer commandBuffer, VkDescriptorSet globalDescriptorSet);
+
+  void setForceKernel(ForceKernel kernel);
+  ForceKernel getForceKernel() const { return m_forceKernel; }
+  // Hermite needs jerks, which only the all-pairs and restricted kernels sum, so both
+  // setters throw std::invalid_argument for Hermite with a tree or mesh solver
+  static bool isSupported(ForceSolver solver, Integrator integrator);
+  void setForceSolver(ForceSolver solver);
+  ForceSolver getForceSolver() const { return m_forceSolver; }
+  void setIntegrator(Integrator integrator);
+  Integrator getIntegrator() const { return m_integrator; }
+  // Splits the all-pairs sum of the direct solver into dispatches over this many
+  // sources each, accumulated into the acceleration buffer and integrated by a
+  // separate pass. Zero sums all sources in one dispatch. See
+  // PgsKernelTuner::chooseForceChunkSize for picking it from a time budget. The
+  // symmetric kernel already splits its sum into bands and ignores it.
+  void setForceChunkSize(uint32_t sourcesPerChunk) { m_forceChunkSize = sourcesPerChunk; }
+  uint32_t getForceChunkSize() const { return m_forceChunkSize; }
+  // The solver and integrator systems are created on first use, the setters above
+  // create the ones the selected configuration steps with
+  BarnesHutSystem &getBarnesHutSystem();
+  ParticleMeshSystem &getParticleMeshSystem();
+  P3MSystem &getP3MSystem();
+  BlockTimestepSystem &getBlockTimestepSystem();
+  // Morton-sorts the particle state every interval steps, zero disables sorting.
+  // Skipped while stepping with block timesteps, whose levels are tied to slots.
+  void setSpatialSortInterval(uint32_t interval);
+  uint32_t getSpatialSortInterval() const { return m_spatialSortInterval; }
+  // Merges particles closer than radius every interval steps and compacts the dead
+  // slots away, see MergeSystem. Zero for either disables merging. Only runs with the
+  // direct solver, the others still work over every slot, and not with block
+  // timesteps or the restricted solver, which tie state to slots.
+  void setMergeParameters(float radius, uint32_t interval);
+  float getMergeRadius() const { return m_mergeRadius; }
+  uint32_t getMergeInterval() const { return m_mergeInterval; }
+  void setColormap(Colormap colormap) { m_colormap = colormap; }
+  Colormap getColormap() const { return m_colormap; }
+  void setColorSource(ColorSource source) { m_colorSource = source; }
+  ColorSource getColorSource() const { return m_colorSource; }
+  void setColorScale(float scale) { m_colorScale = scale; }
+  float getColorScale() const { return m_colorScale; }
+
+  // Layout of FrameInfo::renderDescriptorSet: positions, velocities and color values of one particle state
+  PgsDescriptorSetLayout &getRenderSetLayout() { return *m_renderSetLayout; }
+
+  // Recreates the all-pairs kernel pipelines with the given work group size (also the
+  // tile size of the tiled kernel) and inner loop unroll factor, see PgsKernelTuner
+  void configureForceKernels(uint32_t localSizeX, uint32_t unroll);
+  uint32_t getKernelLocalSizeX() const { return m_kernelLocalSizeX; }
+  uint32_t getKernelUnroll() const { return m_kernelUnroll; }
+
+  // Recreates the particle-mesh grid, gridSize must be a power of two
+  void setParticleMeshGridSize(uint32_t gridSize);
+  // Recreates the P3M solver, a splitRadius of zero picks the P3MSystem default
+  void setP3MParameters(uint32_t gridSize, float splitRadius);
 
  private:
   void createGraphicsPipelineLayout();
   void createGraphicsPipeline(VkRenderPass renderPass);
   void createComputePipelineLayout(VkDescriptorSetLayout globalSetLayout);
-  void createComputePipeline();
+  void createComputePipelines();
+  // creates the systems the selected solver, kernel and integrator step with
+  void createSelectedSystems();
+  SymmetricForceSystem &getSymmetricForceSystem();
+  IntegratorSystem &getIntegratorSystem();
+  SpatialSortSystem &getSpatialSortSystem();
+  MergeSystem &getMergeSystem();
+  // Records one step reading the model's current state, without swapping the state
+  void recordStep(FrameInfo &frameInfo,
+                  const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets);
+  // Records the selected solver's accelerations at the positions globalDescriptorSet
+  // reads, withJerks uses the all-pairs kernel to also write jerks
+  void recordForces(VkCommandBuffer commandBuffer,
+                    VkDescriptorSet globalDescriptorSet,
+                    uint32_t particleCount,
+                    bool withJerks);
+  // Records accelerations for the particles in the block timestep active list, the
+  // all-pairs kernels are dispatched over that list only
+  void recordActiveForces(VkCommandBuffer commandBuffer,
+                          VkDescriptorSet globalDescriptorSet,
+                          uint32_t particleCount);
+  // Records the restricted solver's pipeline for the given kernel mode, summing the
+  // pulls of the bound model's massive bodies. The active mode dispatches over the
+  // block timestep active list.
+  void recordRestrictedForces(VkCommandBuffer commandBuffer,
+                              VkDescriptorSet globalDescriptorSet,
+                              uint32_t kernelMode,
+                              uint32_t particleCount,
+                              float frameTime);
+  // Records a spatial sort of the current state if one is due, swapping the state
+  void recordSpatialSortIfDue(FrameInfo &frameInfo);
+  // Records a merge of the current state if one is due, swapping the state and
+  // rewriting the indirect arguments from the new live count
+  void recordMergeIfDue(FrameInfo &frameInfo,
+                        const std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT> &globalDescriptorSets);
+  // Records the all-pairs accelerations as one dispatch per chunk of sources
+  void recordChunkedForces(VkCommandBuffer commandBuffer,
+                           VkDescriptorSet globalDescriptorSet,
+                           uint32_t particleCount);
+  bool isForceChunked(uint32_t particleCount) const {
+    return m_forceKernel != ForceKernel::Symmetric && m_forceChunkSize != 0 &&
+           m_forceChunkSize < particleCount;
+  }
+  // sources default to all particles
+  void pushStepConstants(VkCommandBuffer commandBuffer,
+                         uint32_t particleCount,
+                         float frameTime,
+                         uint32_t sourceBegin = 0,
+                         uint32_t sourceEnd = UINT32_MAX);
 
   PgsDevice &m_pgsDevice;
 
+  std::unique_ptr<PgsDescriptorSetLayout> m_renderSetLayout;
   std::unique_ptr<PgsGraphicsPipeline> m_graphicsPipeline;
   VkPipelineLayout m_graphicsPipelineLayout;
-  std::unique_ptr<PgsComputePipeline> m_computePipeline;
+  // indexed by ForceKernel, the first integrate, the others only write accelerations
+  // of all particles, of the active ones or accumulate one chunk of sources
+  std::vector<std::unique_ptr<PgsComputePipeline>> m_computePipelines;
+  std::vector<std::unique_ptr<PgsComputePipeline>> m_forcePipelines;
+  std::vector<std::unique_ptr<PgsComputePipeline>> m_activeForcePipelines;
+  std::vector<std::unique_ptr<PgsComputePipeline>> m_chunkForcePipelines;
+  std::unique_ptr<PgsComputePipeline> m_jerkPipeline;
+  // particle_restricted.comp indexed by kernel mode, up to the active mode
+  std::vector<std::unique_ptr<PgsComputePipeline>> m_restrictedPipelines;
   VkPipelineLayout m_computePipelineLayout;
+  std::unique_ptr<PgsComputePipeline> m_integratePipeline;
+  std::unique_ptr<PgsComputePipeline> m_countPipeline;
+  // the bound model's count buffer, its arguments are rewritten before the next step when stale
+  VkBuffer m_countBuffer{VK_NULL_HANDLE};
+  bool m_countArgsStale{true};
+  // the bound model's massive bodies, the sources of the restricted solver
+  uint32_t m_massiveCount{0};
+  ForceKernel m_forceKernel{ForceKernel::Direct};
+  uint32_t m_kernelLocalSizeX{PgsComputePipeline::LOCAL_SIZE_X};
+  uint32_t m_kernelUnroll{1};
+  uint32_t m_forceChunkSize{0};
+  ForceSolver m_forceSolver{ForceSolver::Direct};
+  Integrator m_integrator{Integrator::Euler};
+  Colormap m_colormap{Colormap::Classic};
+  ColorSource m_colorSource{ColorSource::Acceleration};
+  float m_colorScale{1.0f};
+
+  VkDescriptorSetLayout m_globalSetLayout;
+  uint32_t m_maxParticleCount;
+  // the bound model and the buffers passed to bindModel, systems created later bind to them
+  PgsModel *m_model{nullptr};
+  PgsBuffer *m_accelerationBuffer{nullptr};
+  PgsBuffer *m_jerkBuffer{nullptr};
+  PgsBuffer *m_activeListBuffer{nullptr};
+  std::unique_ptr<BarnesHutSystem> m_barnesHutSystem;
+  std::unique_ptr<ParticleMeshSystem> m_particleMeshSystem;
+  uint32_t m_particleMeshGridSize{ParticleMeshSystem::DEFAULT_GRID_SIZE};
+  std::unique_ptr<P3MSystem> m_p3mSystem;
+  uint32_t m_p3mGridSize{ParticleMeshSystem::DEFAULT_GRID_SIZE};
+  float m_p3mSplitRadius{0.0f};
+  std::unique_ptr<SymmetricForceSystem> m_symmetricForceSystem;
+  std::unique_ptr<IntegratorSystem> m_integratorSystem;
+  std::unique_ptr<BlockTimestepSystem> m_blockTimestepSystem;
+  std::unique_ptr<SpatialSortSystem> m_spatialSortSystem;
+  uint32_t m_spatialSortInterval{0};
+  uint32_t m_stepsSinceSpatialSort{0};
+  std::unique_ptr<MergeSystem> m_mergeSystem;
+  float m_mergeRadius{0.0f};
+  uint32_t m_mergeInterval{0};
+  uint32_t m_stepsSinceMerge{0};
 };
 }  // namespace pgs
@@ -0,0 +1,174 @@
+#include "radix_sort_system.hpp"
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace pgs
+{
+
+// must match radix_sort_common.glsl
+static constexpr uint32_t RADIX_BITS = 4;
+static constexpr uint32_t RADIX_SIZE = 1 << RADIX_BITS;
+static constexpr uint32_t RADIX_BLOCK_SIZE = 256;
+
+struct RadixSortPushConstants
+{
+	uint32_t count;
+	uint32_t shift;
+	uint32_t groupCount;
+	uint32_t flip;
+};
+
+RadixSortSystem::RadixSortSystem(PgsDevice &device, uint32_t maxCount)
+	: m_pgsDevice{device}, m_maxCount{maxCount}
+{
+	createBuffers();
+	createDescriptorSet();
+	createPipelineLayout();
+	createPipelines();
+}
+
+RadixSortSystem::~RadixSortSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void RadixSortSystem::createBuffers()
+{
+	auto createStorageBuffer = [this](uint32_t count) {
+		return std::make_unique<PgsBuffer>(m_pgsDevice,
+										   sizeof(uint32_t),
+										   count,
+										   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+											   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+											   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+										   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	};
+
+	uint32_t maxGroupCount = (m_maxCount + RADIX_BLOCK_SIZE - 1) / RADIX_BLOCK_SIZE;
+	m_keyBuffer = createStorageBuffer(m_maxCount);
+	m_valueBuffer = createStorageBuffer(m_maxCount);
+	m_keyAltBuffer = createStorageBuffer(m_maxCount);
+	m_valueAltBuffer = createStorageBuffer(m_maxCount);
+	m_histogramBuffer = createStorageBuffer(RADIX_SIZE * maxGroupCount);
+}
+
+void RadixSortSystem::createDescriptorSet()
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(1)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5)
+						   .build();
+
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+
+	auto keyInfo = m_keyBuffer->descriptorInfo();
+	auto valueInfo = m_valueBuffer->descriptorInfo();
+	auto keyAltInfo = m_keyAltBuffer->descriptorInfo();
+	auto valueAltInfo = m_valueAltBuffer->descriptorInfo();
+	auto histogramInfo = m_histogramBuffer->descriptorInfo();
+	auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+					  .writeBuffer(0, &keyInfo)
+					  .writeBuffer(1, &valueInfo)
+					  .writeBuffer(2, &keyAltInfo)
+					  .writeBuffer(3, &valueAltInfo)
+					  .writeBuffer(4, &histogramInfo)
+					  .build(m_descriptorSet);
+	assert(result && "Failed to build radix sort descriptor set!");
+}
+
+void RadixSortSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(RadixSortPushConstants);
+
+	VkDescriptorSetLayout setLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &setLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create radix sort pipeline layout!");
+	}
+}
+
+void RadixSortSystem::createPipelines()
+{
+	m_histogramPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															   "shaders/radix_sort_histogram.comp.spv",
+															   m_pipelineLayout);
+	m_scanPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/radix_sort_scan.comp.spv",
+														  m_pipelineLayout);
+	m_scatterPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															 "shaders/radix_sort_scatter.comp.spv",
+															 m_pipelineLayout);
+}
+
+void RadixSortSystem::sort(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits)
+{
+	assert(count <= m_maxCount && "Radix sort count exceeds buffer size");
+	if (count < 2)
+	{
+		return;
+	}
+
+	// an even pass count leaves the sorted pairs in the primary buffers
+	uint32_t passCount = (keyBits + RADIX_BITS - 1) / RADIX_BITS;
+	passCount += passCount % 2;
+
+	RadixSortPushConstants push{};
+	push.count = count;
+	push.groupCount = (count + RADIX_BLOCK_SIZE - 1) / RADIX_BLOCK_SIZE;
+
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							1,
+							&m_descriptorSet,
+							0,
+							nullptr);
+
+	for (uint32_t pass = 0; pass < passCount; pass++)
+	{
+		push.shift = pass * RADIX_BITS;
+		push.flip = pass % 2;
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(RadixSortPushConstants),
+						   &push);
+
+		m_histogramPipeline->bind(commandBuffer);
+		m_histogramPipeline->dispatchLinear(commandBuffer, push.groupCount);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+
+		m_scanPipeline->bind(commandBuffer);
+		m_scanPipeline->dispatch(commandBuffer, 1);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+
+		m_scatterPipeline->bind(commandBuffer);
+		m_scatterPipeline->dispatchLinear(commandBuffer, push.groupCount);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+	}
+}
+
+} // namespace pgs
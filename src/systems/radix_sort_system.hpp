@@ -0,0 +1,69 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Stable GPU radix sort of 32 bit keys with 32 bit values, 4 bits per pass.
+ * Callers fill the key and value buffers from their own shaders, record sort()
+ * and read the sorted pairs back from the same buffers.
+ */
+class RadixSortSystem
+{
+  public:
+	RadixSortSystem(PgsDevice &device, uint32_t maxCount);
+	~RadixSortSystem();
+
+	RadixSortSystem(const RadixSortSystem &) = delete;
+	RadixSortSystem &operator=(const RadixSortSystem &) = delete;
+
+	// Sorts the first count pairs by the low keyBits bits of their keys
+	void sort(VkCommandBuffer commandBuffer, uint32_t count, uint32_t keyBits = 32);
+
+	PgsBuffer &getKeyBuffer()
+	{
+		return *m_keyBuffer;
+	}
+	PgsBuffer &getValueBuffer()
+	{
+		return *m_valueBuffer;
+	}
+	uint32_t getMaxCount() const
+	{
+		return m_maxCount;
+	}
+
+  private:
+	void createBuffers();
+	void createDescriptorSet();
+	void createPipelineLayout();
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxCount;
+
+	std::unique_ptr<PgsBuffer> m_keyBuffer;
+	std::unique_ptr<PgsBuffer> m_valueBuffer;
+	std::unique_ptr<PgsBuffer> m_keyAltBuffer;
+	std::unique_ptr<PgsBuffer> m_valueAltBuffer;
+	std::unique_ptr<PgsBuffer> m_histogramBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	VkDescriptorSet m_descriptorSet;
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_histogramPipeline;
+	std::unique_ptr<PgsComputePipeline> m_scanPipeline;
+	std::unique_ptr<PgsComputePipeline> m_scatterPipeline;
+};
+
+} // namespace pgs
@@ -0,0 +1,229 @@
+#include "spatial_sort_system.hpp"
+
+// libs
+#include <glm/glm.hpp>
+
+// std
+#include <cassert>
+#include <stdexcept>
+
+namespace pgs
+{
+
+// must match SpatialSortPush in spatial_sort_common.glsl
+struct SpatialSortPushConstants
+{
+	uint32_t particleCount;
+};
+
+// storage buffers of one descriptor set, see spatial_sort_common.glsl
+static constexpr uint32_t SET_STORAGE_BUFFERS = 14;
+
+SpatialSortSystem::SpatialSortSystem(PgsDevice &device, uint32_t maxParticleCount)
+	: m_pgsDevice{device}, m_maxParticleCount{maxParticleCount}
+{
+	createBuffers();
+	createDescriptorSetLayout();
+	createPipelineLayout();
+	createPipelines();
+}
+
+SpatialSortSystem::~SpatialSortSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void SpatialSortSystem::createBuffers()
+{
+	m_radixSort = std::make_unique<RadixSortSystem>(m_pgsDevice, m_maxParticleCount);
+	m_boundsBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												 sizeof(glm::ivec4),
+												 1,
+												 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+													 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+												 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	m_massScratchBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+													  sizeof(float),
+													  m_maxParticleCount,
+													  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+														  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+													  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void SpatialSortSystem::createDescriptorSetLayout()
+{
+	auto builder = PgsDescriptorSetLayout::Builder(m_pgsDevice);
+	for (uint32_t binding = 0; binding < SET_STORAGE_BUFFERS; binding++)
+	{
+		builder.addBinding(binding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT);
+	}
+	m_setLayout = builder.build();
+}
+
+void SpatialSortSystem::createPipelineLayout()
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(SpatialSortPushConstants);
+
+	VkDescriptorSetLayout descriptorSetLayout = m_setLayout->getDescriptorSetLayout();
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create spatial sort pipeline layout!");
+	}
+}
+
+void SpatialSortSystem::createPipelines()
+{
+	m_boundsPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/spatial_sort_bounds.comp.spv",
+															m_pipelineLayout);
+	m_keysPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/spatial_sort_keys.comp.spv",
+														  m_pipelineLayout);
+	m_gatherPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/spatial_sort_gather.comp.spv",
+															m_pipelineLayout);
+}
+
+void SpatialSortSystem::bindState(PgsModel &model)
+{
+	assert(model.getParticleCount() <= m_maxParticleCount && "Spatial sort buffers are too small");
+
+	constexpr uint32_t setCount = PgsModel::STATE_BUFFER_COUNT * PgsModel::STATE_BUFFER_COUNT;
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(setCount)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, SET_STORAGE_BUFFERS * setCount)
+						   .build();
+
+	auto boundsInfo = m_boundsBuffer->descriptorInfo();
+	auto keyInfo = m_radixSort->getKeyBuffer().descriptorInfo();
+	auto indexInfo = m_radixSort->getValueBuffer().descriptorInfo();
+	auto massInfo = model.getMassBuffer().descriptorInfo();
+	auto massNextInfo = m_massScratchBuffer->descriptorInfo();
+	auto countInfo = model.getCountBuffer().descriptorInfo();
+	for (uint32_t state = 0; state < PgsModel::STATE_BUFFER_COUNT; state++)
+	{
+		auto &stateIn = model.getState(state);
+		auto &stateOut = model.getState((state + 1) % PgsModel::STATE_BUFFER_COUNT);
+		auto positionInfo = stateIn.positions->descriptorInfo();
+		auto velocityInfo = stateIn.velocities->descriptorInfo();
+		auto colorValueInfo = stateIn.colorValues->descriptorInfo();
+		auto positionNextInfo = stateOut.positions->descriptorInfo();
+		auto velocityNextInfo = stateOut.velocities->descriptorInfo();
+		auto colorValueNextInfo = stateOut.colorValues->descriptorInfo();
+		for (uint32_t ids = 0; ids < PgsModel::STATE_BUFFER_COUNT; ids++)
+		{
+			auto idInfo = model.getParticleIdBuffer(ids).descriptorInfo();
+			auto idNextInfo =
+				model.getParticleIdBuffer((ids + 1) % PgsModel::STATE_BUFFER_COUNT).descriptorInfo();
+			auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+							  .writeBuffer(0, &positionInfo)
+							  .writeBuffer(1, &velocityInfo)
+							  .writeBuffer(2, &colorValueInfo)
+							  .writeBuffer(3, &positionNextInfo)
+							  .writeBuffer(4, &velocityNextInfo)
+							  .writeBuffer(5, &colorValueNextInfo)
+							  .writeBuffer(6, &idInfo)
+							  .writeBuffer(7, &idNextInfo)
+							  .writeBuffer(8, &boundsInfo)
+							  .writeBuffer(9, &keyInfo)
+							  .writeBuffer(10, &indexInfo)
+							  .writeBuffer(11, &massInfo)
+							  .writeBuffer(12, &massNextInfo)
+							  .writeBuffer(13, &countInfo)
+							  .build(m_descriptorSets[state][ids]);
+			assert(result && "Failed to build spatial sort descriptor set!");
+		}
+	}
+}
+
+void SpatialSortSystem::recordSort(VkCommandBuffer commandBuffer, PgsModel &model)
+{
+	uint32_t particleCount = model.getParticleCount();
+	VkDescriptorSet descriptorSet =
+		m_descriptorSets[model.getStateIndex()][model.getParticleIdIndex()];
+	assert(descriptorSet != VK_NULL_HANDLE && "bindState was not called");
+
+	// reset the bounds to (INT_MAX, INT_MAX, INT_MIN, INT_MIN) for the atomic reduction
+	vkCmdFillBuffer(commandBuffer, m_boundsBuffer->getBuffer(), 0, 2 * sizeof(int32_t), 0x7FFFFFFF);
+	vkCmdFillBuffer(commandBuffer,
+					m_boundsBuffer->getBuffer(),
+					2 * sizeof(int32_t),
+					2 * sizeof(int32_t),
+					0x80000000);
+
+	VkMemoryBarrier fillBarrier{};
+	fillBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	fillBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	fillBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(commandBuffer,
+						 VK_PIPELINE_STAGE_TRANSFER_BIT,
+						 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+						 0,
+						 1,
+						 &fillBarrier,
+						 0,
+						 nullptr,
+						 0,
+						 nullptr);
+
+	SpatialSortPushConstants push{};
+	push.particleCount = particleCount;
+
+	auto bindSortState = [&]() {
+		vkCmdBindDescriptorSets(commandBuffer,
+								VK_PIPELINE_BIND_POINT_COMPUTE,
+								m_pipelineLayout,
+								0,
+								1,
+								&descriptorSet,
+								0,
+								nullptr);
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(SpatialSortPushConstants),
+						   &push);
+	};
+
+	bindSortState();
+	m_boundsPipeline->bind(commandBuffer);
+	m_boundsPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+	m_keysPipeline->bind(commandBuffer);
+	m_keysPipeline->compute(commandBuffer, particleCount);
+	PgsComputePipeline::computeBarrier(commandBuffer);
+
+	m_radixSort->sort(commandBuffer, particleCount);
+
+	bindSortState();
+	m_gatherPipeline->bind(commandBuffer);
+	m_gatherPipeline->compute(commandBuffer, particleCount);
+
+	// the mass buffer is bound to the global sets, so the gathered masses are copied back
+	PgsComputePipeline::computeToTransferBarrier(commandBuffer);
+	VkBufferCopy massCopy{0, 0, sizeof(float) * particleCount};
+	vkCmdCopyBuffer(commandBuffer,
+					m_massScratchBuffer->getBuffer(),
+					model.getMassBuffer().getBuffer(),
+					1,
+					&massCopy);
+	PgsComputePipeline::transferToComputeBarrier(commandBuffer);
+
+	model.swapParticleIdBuffers();
+}
+
+} // namespace pgs
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pgs_model.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+#include "radix_sort_system.hpp"
+
+// std
+#include <array>
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * Reorders particle state along a Morton curve, so particles that are close in
+ * space are close in memory and neighbouring invocations of the tree, mesh and
+ * cell list passes touch neighbouring cache lines. A sort reads the model's
+ * current state, gathers it sorted into the other state buffer and moves the
+ * particle ids and masses along, the caller then swaps the state buffers like
+ * after a step. Slots past the live count stay behind the live particles.
+ */
+class SpatialSortSystem
+{
+  public:
+	SpatialSortSystem(PgsDevice &device, uint32_t maxParticleCount);
+	~SpatialSortSystem();
+
+	SpatialSortSystem(const SpatialSortSystem &) = delete;
+	SpatialSortSystem &operator=(const SpatialSortSystem &) = delete;
+
+	// Creates the descriptor sets over the model's state and particle id buffers
+	void bindState(PgsModel &model);
+
+	// Records the sort of the current state into the next one and swaps the model's
+	// particle id buffers, the state buffers are left for the caller to swap
+	void recordSort(VkCommandBuffer commandBuffer, PgsModel &model);
+
+  private:
+	void createBuffers();
+	void createDescriptorSetLayout();
+	void createPipelineLayout();
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxParticleCount;
+
+	std::unique_ptr<RadixSortSystem> m_radixSort;
+	std::unique_ptr<PgsBuffer> m_boundsBuffer;
+	// masses gathered in sorted order before they are copied back to the model
+	std::unique_ptr<PgsBuffer> m_massScratchBuffer;
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	// indexed by the state and the particle id buffer a sort reads
+	std::array<std::array<VkDescriptorSet, PgsModel::STATE_BUFFER_COUNT>, PgsModel::STATE_BUFFER_COUNT>
+		m_descriptorSets{};
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_boundsPipeline;
+	std::unique_ptr<PgsComputePipeline> m_keysPipeline;
+	std::unique_ptr<PgsComputePipeline> m_gatherPipeline;
+};
+
+} // namespace pgs
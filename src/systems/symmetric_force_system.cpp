@@ -0,0 +1,161 @@
+#include "symmetric_force_system.hpp"
+
+#include "../pgs_model.hpp"
+
+// std
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace pgs
+{
+
+struct SymmetricPushConstants
+{
+	uint32_t blockCount;
+	uint32_t bandBegin;
+	uint32_t bandEnd;
+};
+
+SymmetricForceSystem::SymmetricForceSystem(PgsDevice &device,
+										   VkDescriptorSetLayout globalSetLayout,
+										   uint32_t maxParticleCount)
+	: m_pgsDevice{device}, m_maxParticleCount{maxParticleCount}
+{
+	createBuffers();
+	createDescriptorSet();
+	createPipelineLayout(globalSetLayout);
+	createPipelines();
+}
+
+SymmetricForceSystem::~SymmetricForceSystem()
+{
+	vkDestroyPipelineLayout(m_pgsDevice.device(), m_pipelineLayout, nullptr);
+}
+
+void SymmetricForceSystem::createBuffers()
+{
+	// a band covers at least one column tile, which takes one reaction tile per row tile
+	uint64_t blockCount = (std::max(m_maxParticleCount, 1u) + TILE_SIZE - 1) / TILE_SIZE;
+	uint64_t budgetTiles = REACTION_BUDGET_BYTES / (TILE_SIZE * sizeof(glm::vec2));
+	m_reactionTileCapacity = std::max(budgetTiles, blockCount);
+
+	m_reactionBuffer = std::make_unique<PgsBuffer>(m_pgsDevice,
+												   sizeof(glm::vec2),
+												   m_reactionTileCapacity * TILE_SIZE,
+												   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+												   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+}
+
+void SymmetricForceSystem::createDescriptorSet()
+{
+	m_descriptorPool = PgsDescriptorPool::Builder(m_pgsDevice)
+						   .setMaxSets(1)
+						   .addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1)
+						   .build();
+
+	m_setLayout = PgsDescriptorSetLayout::Builder(m_pgsDevice)
+					  .addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+					  .build();
+
+	auto reactionInfo = m_reactionBuffer->descriptorInfo();
+	auto result = PgsDescriptorWriter(*m_setLayout, *m_descriptorPool)
+					  .writeBuffer(0, &reactionInfo)
+					  .build(m_descriptorSet);
+	assert(result && "Failed to build symmetric force descriptor set!");
+}
+
+void SymmetricForceSystem::createPipelineLayout(VkDescriptorSetLayout globalSetLayout)
+{
+	VkPushConstantRange pushConstantRange{};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(SymmetricPushConstants);
+
+	std::vector<VkDescriptorSetLayout> descriptorSetLayouts{globalSetLayout,
+															m_setLayout->getDescriptorSetLayout()};
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(descriptorSetLayouts.size());
+	pipelineLayoutInfo.pSetLayouts = descriptorSetLayouts.data();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+	if (vkCreatePipelineLayout(m_pgsDevice.device(),
+							   &pipelineLayoutInfo,
+							   nullptr,
+							   &m_pipelineLayout) != VK_SUCCESS)
+	{
+		throw std::runtime_error("failed to create symmetric force pipeline layout!");
+	}
+}
+
+void SymmetricForceSystem::createPipelines()
+{
+	auto gravityConstants = PgsComputePipeline::gravityConstants();
+	m_pairPipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+														  "shaders/particle_symmetric.comp.spv",
+														  m_pipelineLayout,
+														  gravityConstants);
+	m_reducePipeline = std::make_unique<PgsComputePipeline>(m_pgsDevice,
+															"shaders/particle_symmetric_reduce.comp.spv",
+															m_pipelineLayout,
+															gravityConstants);
+}
+
+void SymmetricForceSystem::computeAccelerations(VkCommandBuffer commandBuffer,
+												VkDescriptorSet globalDescriptorSet,
+												uint32_t particleCount)
+{
+	if (particleCount == 0)
+	{
+		return;
+	}
+
+	uint32_t blockCount = (particleCount + TILE_SIZE - 1) / TILE_SIZE;
+	// the budget covers counts past m_maxParticleCount as well, the buffer only has to
+	// hold a band of one column tile
+	assert(blockCount <= m_reactionTileCapacity && "Symmetric force reaction buffer is too small");
+	// column tiles per band, each needs one reaction tile per row tile
+	uint32_t bandBlocks = static_cast<uint32_t>(
+		std::min<uint64_t>(blockCount, m_reactionTileCapacity / blockCount));
+
+	std::vector<VkDescriptorSet> descriptorSets{globalDescriptorSet, m_descriptorSet};
+	vkCmdBindDescriptorSets(commandBuffer,
+							VK_PIPELINE_BIND_POINT_COMPUTE,
+							m_pipelineLayout,
+							0,
+							static_cast<uint32_t>(descriptorSets.size()),
+							descriptorSets.data(),
+							0,
+							nullptr);
+
+	SymmetricPushConstants push{};
+	push.blockCount = blockCount;
+	for (uint32_t bandBegin = 0; bandBegin < blockCount; bandBegin += bandBlocks)
+	{
+		push.bandBegin = bandBegin;
+		push.bandEnd = std::min(bandBegin + bandBlocks, blockCount);
+		vkCmdPushConstants(commandBuffer,
+						   m_pipelineLayout,
+						   VK_SHADER_STAGE_COMPUTE_BIT,
+						   0,
+						   sizeof(SymmetricPushConstants),
+						   &push);
+
+		// the first band writes every row's acceleration, later ones only reach rows
+		// below the band
+		if (bandBegin != 0)
+		{
+			PgsComputePipeline::computeBarrier(commandBuffer);
+		}
+		m_pairPipeline->bind(commandBuffer);
+		m_pairPipeline->dispatchLinear(commandBuffer, bandBegin == 0 ? blockCount : push.bandEnd);
+		PgsComputePipeline::computeBarrier(commandBuffer);
+		m_reducePipeline->bind(commandBuffer);
+		m_reducePipeline->dispatchLinear(commandBuffer, push.bandEnd - bandBegin);
+	}
+}
+
+} // namespace pgs
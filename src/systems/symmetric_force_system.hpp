@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../pgs_buffer.hpp"
+#include "../pgs_descriptors.hpp"
+#include "../pgs_device.hpp"
+#include "../pipelines/pgs_computePipeline.hpp"
+
+// std
+#include <memory>
+
+namespace pgs
+{
+
+/*
+ * All-pairs gravity that evaluates every pair once and applies it to both
+ * particles. Particles are split into tiles; the work group of row tile I sums
+ * the pulls from column tiles J >= I and stores the opposite pulls on the column
+ * particles in a reaction buffer, which a second pass adds to their accelerations.
+ * The result is written to the acceleration buffer of the global descriptor set.
+ */
+class SymmetricForceSystem
+{
+  public:
+	// must match SYMMETRIC_TILE_SIZE in symmetric_common.glsl
+	static constexpr uint32_t TILE_SIZE = 256;
+	// Memory for stored reactions, larger counts process the column tiles in more bands
+	static constexpr VkDeviceSize REACTION_BUDGET_BYTES = 64 * 1024 * 1024;
+
+	SymmetricForceSystem(PgsDevice &device,
+						 VkDescriptorSetLayout globalSetLayout,
+						 uint32_t maxParticleCount);
+	~SymmetricForceSystem();
+
+	SymmetricForceSystem(const SymmetricForceSystem &) = delete;
+	SymmetricForceSystem &operator=(const SymmetricForceSystem &) = delete;
+
+	// Covers particleCount particles, the passes stop at the live count
+	void computeAccelerations(VkCommandBuffer commandBuffer,
+							  VkDescriptorSet globalDescriptorSet,
+							  uint32_t particleCount);
+
+  private:
+	void createBuffers();
+	void createDescriptorSet();
+	void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
+	void createPipelines();
+
+	PgsDevice &m_pgsDevice;
+	uint32_t m_maxParticleCount;
+
+	std::unique_ptr<PgsBuffer> m_reactionBuffer;
+	// tiles of TILE_SIZE reactions m_reactionBuffer holds
+	uint64_t m_reactionTileCapacity{0};
+
+	std::unique_ptr<PgsDescriptorPool> m_descriptorPool;
+	std::unique_ptr<PgsDescriptorSetLayout> m_setLayout;
+	VkDescriptorSet m_descriptorSet;
+
+	VkPipelineLayout m_pipelineLayout;
+	std::unique_ptr<PgsComputePipeline> m_pairPipeline;
+	std::unique_ptr<PgsComputePipeline> m_reducePipeline;
+};
+
+} // namespace pgs